@@ -0,0 +1,251 @@
+/**
+ *  Copyright (C) 2011
+ *  University of Rochester Department of Computer Science
+ *    and
+ *  Lehigh University Department of Computer Science and Engineering
+ *
+ * License: Modified BSD
+ *          Please see the file LICENSE.RSTM for licensing information
+ */
+
+#ifdef PERSISTENT_TM
+
+#include <stm/PersistentLog.hpp>
+#include <algs/algs.hpp>
+#include <common/locks.hpp>
+#include <algorithm>
+#include <vector>
+
+using namespace stm;
+
+namespace
+{
+  const uint64_t PLOG_MASK = PLOG_SIZE - 1;
+
+  /*** a committed block found by the recovery */
+  struct plog_block_t
+  {
+      uintptr_t  ts;
+      PLogEntry* ring;
+      uint64_t   pos;
+      uintptr_t  nb;
+
+      bool operator<(const plog_block_t& rhs) const { return ts < rhs.ts; }
+  };
+
+  /**
+   *  Every ts below the watermark is durable in the heap.  A committer
+   *  publishes its lower bound before it takes the lock, then reading the
+   *  timestamp first cannot miss a commit.
+   */
+  uintptr_t watermark()
+  {
+      uintptr_t w = timestamp.val;
+      CFENCE;
+      for (uint32_t i = 0, e = threadcount.val; i < e && i < PLOG_NB_RINGS; ++i)
+      {
+          uintptr_t f = plogs[i].inflight;
+          if (f <= w)
+              w = f - 1;
+      }
+      return w;
+  }
+
+  /**
+   *  Checks the block at pos: its ts must follow the previous block of the
+   *  ring and the trailer must match the content
+   */
+  bool valid_block(PLogEntry* ring, uint64_t pos, uintptr_t after,
+                   uintptr_t* nb, uintptr_t* ts)
+  {
+      PLogEntry head = ring[pos & PLOG_MASK];
+      uintptr_t sum = 0;
+
+      if (head.addr > PLOG_SIZE - 2 || head.val <= after)
+          return false;
+
+      for (uintptr_t i = 1; i <= head.addr; ++i) {
+          PLogEntry& entry = ring[(pos + i) & PLOG_MASK];
+          sum = plog_mix(plog_mix(sum, entry.addr), entry.val);
+      }
+
+      PLogEntry& tail = ring[(pos + head.addr + 1) & PLOG_MASK];
+      if (tail.val != head.val ||
+          tail.addr != plog_mix(plog_mix(sum, head.addr), head.val))
+          return false;
+
+      *nb = head.addr;
+      *ts = head.val;
+      return true;
+  }
+
+  /**
+   *  The heap of a previous run is only there if the targets are in a pool
+   *  reattached at the same address, a malloc heap is not
+   */
+  bool replayable(PLogEntry* ring, uint64_t pos, uintptr_t nb)
+  {
+      for (uintptr_t i = 1; i <= nb; ++i)
+          if (!MN_in_reattached_pool((void*)ring[(pos + i) & PLOG_MASK].addr))
+              return false;
+      return true;
+  }
+
+  /*** persist the ring header after start/truncated changed */
+  void persist_header(PLogHeader* header, uint64_t start, uintptr_t truncated)
+  {
+      header->start = start;
+      if (truncated > header->truncated)
+          header->truncated = truncated;
+      MN_flush(header, sizeof(PLogHeader), 1);
+      MN_drain();
+  }
+}
+
+namespace stm
+{
+  PersistentLog plogs[PLOG_NB_RINGS];
+  PLogExternal plog_external = { NULL, NULL, NULL, NULL };
+
+  void PersistentLog::truncate(uint64_t needed)
+  {
+      if (needed > PLOG_SIZE)
+          UNRECOVERABLE("The write set does not fit in the persistent log.");
+
+      while (tail + needed - start > PLOG_SIZE) {
+          uintptr_t w = watermark();
+          uint64_t pos = start;
+
+          // drop every block already durable in the heap
+          while (pos != tail && ring[pos & PLOG_MASK].val <= w)
+              pos += ring[pos & PLOG_MASK].addr + 2;
+
+          if (pos == start) {
+              // an older commit is still flushing its writeback
+              spin64();
+              continue;
+          }
+
+          persist_header(header, pos, w);
+          start = pos;
+      }
+  }
+
+  void plog_init()
+  {
+      const size_t ring_bytes = sizeof(PLogHeader)
+          + PLOG_SIZE * sizeof(PLogEntry);
+      char* pool = (char*)MN_alloc(PLOG_FILE, PLOG_NB_RINGS * ring_bytes);
+      int reattached;
+
+      if (pool == NULL)
+          UNRECOVERABLE("Cannot allocate the persistent log.");
+      reattached = MN_is_reattached(pool);
+
+      for (int i = 0; i < PLOG_NB_RINGS; ++i) {
+          PersistentLog& log = plogs[i];
+
+          log.header = (PLogHeader*)(pool + i * ring_bytes);
+          log.ring = (PLogEntry*)(log.header + 1);
+          log.inflight = ~(uintptr_t)0;
+
+          if (!reattached || log.header->magic != PLOG_MAGIC) {
+              // a zero ts is never a valid block
+              log.ring[0].addr = 0;
+              log.ring[0].val = 0;
+              MN_flush(log.ring, sizeof(PLogEntry), 1);
+              log.header->magic = PLOG_MAGIC;
+              log.header->truncated = 0;
+              persist_header(log.header, 0, 0);
+          }
+          log.start = log.tail = log.header->start;
+      }
+
+      if (reattached) {
+          size_t nb = plog_recover();
+          if (nb > 0)
+              printf("Persistent log: replayed %lu transactions\n",
+                     (unsigned long)nb);
+          // the next commits must be above the persisted watermark
+          uintptr_t truncated = plogs[0].header->truncated;
+          timestamp.val = (truncated + 1) & ~(uintptr_t)1;
+      }
+  }
+
+  void plog_set_external(void (*begin)(), void (*write)(void*, void*),
+                         void (*commit)(), void (*abort)())
+  {
+      plog_external.begin = begin;
+      plog_external.write = write;
+      plog_external.commit = commit;
+      plog_external.abort = abort;
+  }
+
+  void plog_shutdown()
+  {
+      if (plog_external.commit != NULL)
+          return;
+      // every commit flushed its writeback before end_commit
+      for (int i = 0; i < PLOG_NB_RINGS; ++i) {
+          plogs[i].start = plogs[i].tail;
+          persist_header(plogs[i].header, plogs[i].tail, timestamp.val);
+      }
+  }
+
+  size_t plog_recover()
+  {
+      std::vector<plog_block_t> blocks;
+      uintptr_t truncated = 0, last_ts = 0;
+      size_t rejected = 0;
+
+      for (int i = 0; i < PLOG_NB_RINGS; ++i)
+          truncated = std::max(truncated, (uintptr_t)plogs[i].header->truncated);
+
+      // the blocks of a ring are contiguous from start, in ts order
+      for (int i = 0; i < PLOG_NB_RINGS; ++i) {
+          PersistentLog& log = plogs[i];
+          uint64_t pos = log.header->start;
+          uintptr_t nb, ts, after = 0;
+
+          while (valid_block(log.ring, pos, after, &nb, &ts) &&
+                 pos + nb + 2 - log.header->start <= PLOG_SIZE)
+          {
+              if (ts > truncated) {
+                  plog_block_t block = { ts, log.ring, pos, nb };
+                  blocks.push_back(block);
+              }
+              after = ts;
+              pos += nb + 2;
+          }
+          log.start = log.tail = pos;
+      }
+
+      std::sort(blocks.begin(), blocks.end());
+      for (size_t b = 0; b < blocks.size(); ++b) {
+          plog_block_t& block = blocks[b];
+          last_ts = block.ts;
+          if (!replayable(block.ring, block.pos, block.nb)) {
+              ++rejected;
+              continue;
+          }
+          for (uintptr_t i = 1; i <= block.nb; ++i) {
+              PLogEntry& entry = block.ring[(block.pos + i) & PLOG_MASK];
+              *(uintptr_t*)entry.addr = entry.val;
+              MN_flush((void*)entry.addr, sizeof(uintptr_t), 1);
+          }
+      }
+      MN_drain();
+      if (rejected > 0)
+          printf("Persistent log: dropped %lu transactions outside the "
+                 "reattached pools\n", (unsigned long)rejected);
+
+      // the heap is up to date, empty the rings
+      truncated = std::max(truncated, last_ts);
+      for (int i = 0; i < PLOG_NB_RINGS; ++i)
+          persist_header(plogs[i].header, plogs[i].start, truncated);
+
+      return blocks.size() - rejected;
+  }
+}
+
+#endif // PERSISTENT_TM
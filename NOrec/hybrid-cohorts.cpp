@@ -221,6 +221,7 @@ namespace {
 			// }
 			// Interrupt remaining HTx
 			atomicWrite(ser_kill, TRUE);
+			htm_quiesce();
      	// notify the allocator
 			TxThread* tx = (TxThread*)stm::Self;
      	tx->allocator.onTxBegin();
@@ -177,7 +177,7 @@ namespace {
   bool
   irrevoc(STM_IRREVOC_SIG(tx,upper_stack_bound))
   {
-      while (!bcasptr(&timestamp.val, tx->start_time, tx->start_time + 1))
+      while (!htm_exclusive(bcasptr(&timestamp.val, tx->start_time, tx->start_time + 1)))
           if ((tx->start_time = validate(tx)) == VALIDATION_FAILED)
               return false;
 
@@ -264,7 +264,7 @@ namespace {
       }
 
       // get the lock and validate (use RingSTM obstruction-free technique)
-      while (!bcasptr(&timestamp.val, tx->start_time, tx->start_time + 1))
+      while (!htm_exclusive(bcasptr(&timestamp.val, tx->start_time, tx->start_time + 1)))
           if ((tx->start_time = validate(tx)) == VALIDATION_FAILED)
               tx->tmabort(tx);
 			
@@ -318,7 +318,7 @@ namespace {
       // writeback and increments the seqlock again
 
       // get the lock and validate (use RingSTM obstruction-free technique)
-      while (!bcasptr(&timestamp.val, tx->start_time, tx->start_time + 1))
+      while (!htm_exclusive(bcasptr(&timestamp.val, tx->start_time, tx->start_time + 1)))
           if ((tx->start_time = validate(tx)) == VALIDATION_FAILED)
               tx->tmabort(tx);
 			
@@ -207,6 +207,12 @@ namespace stm
   /***  Report the algorithm name that was used to initialize libstm */
   const char* get_algname();
 
+  /**
+   *  The commit seqlock (NOrec timestamp), for hybrid runtimes whose HW
+   *  transactions subscribe to it
+   */
+  volatile uintptr_t* get_seqlock();
+
   /**
    *  Try to become irrevocable.  Call this from within a transaction.
    */
@@ -0,0 +1,301 @@
+/**
+ *  Copyright (C) 2011
+ *  University of Rochester Department of Computer Science
+ *    and
+ *  Lehigh University Department of Computer Science and Engineering
+ *
+ * License: Modified BSD
+ *          Please see the file LICENSE.RSTM for licensing information
+ */
+
+/**
+ *  Persistent redo log for the software path (PERSISTENT_TM).
+ *
+ *  Each thread owns a ring in NVM.  A writing transaction serializes its
+ *  WriteSet into the ring as one contiguous block while it holds the commit
+ *  lock:
+ *
+ *    [ nb_entries | ts ] [ addr | val ] ... [ addr | val ] [ checksum | ts ]
+ *
+ *  The trailer is the commit marker: the block is flushed with a single
+ *  fence, a torn block fails the checksum and is ignored by the recovery.
+ *  The writeback to the heap is flushed after the commit lock is released.
+ *
+ *  A block can be reused when its writes are durable in the heap.  Each
+ *  thread publishes the lowest timestamp it may be flushing, the minimum
+ *  over all threads (the watermark) bounds the blocks that can be dropped.
+ *  The watermark is persisted in the ring header before the space is
+ *  reused, the recovery replays the blocks above the highest watermark in
+ *  timestamp order.  sys_shutdown persists the last timestamp, a clean run
+ *  leaves nothing to replay.  The recovery runs in sys_init: it only
+ *  replays the blocks whose targets are in pools already reattached at
+ *  their address (MN_alloc, before sys_init), it drops the others.
+ *
+ *  A runtime with its own durable log (phTM on NV-HTM) can take the blocks
+ *  instead, see plog_set_external.  The rings are then not used and the
+ *  writeback is not flushed, that log checkpoints the heap.
+ *
+ *  RH-NOrec writes in place, there is no write set to append: it calls the
+ *  external log directly, begin once it holds the commit lock, write per
+ *  store and commit after its writes are visible.  It needs the external
+ *  log, the heap of the rings would see the writes before the block.
+ */
+
+#ifndef PERSISTENTLOG_HPP__
+#define PERSISTENTLOG_HPP__
+
+#ifdef PERSISTENT_TM
+
+#include <stm/config.h>
+#include <stm/metadata.hpp>
+#include <stm/WriteSet.hpp>
+#include <min_nvm.h>
+
+#if !defined(STM_WS_WORDLOG)
+#error "The persistent log requires STM_WS_WORDLOG."
+#endif
+
+/*** entries (16 bytes) in each ring, must be a power of 2 */
+#ifndef PLOG_SIZE
+#define PLOG_SIZE (1 << 15)
+#endif
+
+/*** number of rings in the pool, one per thread */
+#ifndef PLOG_NB_RINGS
+#define PLOG_NB_RINGS 64
+#endif
+
+#define PLOG_FILE  "./norec.plog"
+#define PLOG_MAGIC 0x4e4f5265634c6f67ull
+
+namespace stm
+{
+  /**
+   *  An entry of the ring.  Block headers keep the number of entries in
+   *  addr, trailers keep the checksum.
+   */
+  struct PLogEntry
+  {
+      uintptr_t addr;
+      uintptr_t val;
+  };
+
+  /**
+   *  First cache line of each ring, only written on truncation
+   */
+  struct PLogHeader
+  {
+      uint64_t magic;
+      uint64_t start;     // position of the oldest block
+      uint64_t truncated; // every ts up to this one is durable in the heap
+      char pad[CACHELINE_BYTES - 3 * sizeof(uint64_t)];
+  };
+
+  /**
+   *  The checksum of a block, folds the header and the entries
+   */
+  inline uintptr_t plog_mix(uintptr_t h, uintptr_t w)
+  {
+      h ^= w;
+      return h * 0x100000001b3ull;
+  }
+
+  /**
+   *  The callbacks of an external log: one call to begin, one to write per
+   *  entry and one to commit, all while holding the commit lock (RH-NOrec
+   *  commits after the release).  The commit is ordered at begin.  abort
+   *  drops what was written since begin.
+   */
+  struct PLogExternal
+  {
+      void (*begin)();
+      void (*write)(void* addr, void* val);
+      void (*commit)();
+      void (*abort)();
+  };
+
+  extern PLogExternal plog_external;
+
+  /**
+   *  Volatile state of a ring.  Positions never wrap, the entry is at
+   *  (position & (PLOG_SIZE - 1)).
+   */
+  struct PersistentLog
+  {
+      PLogHeader*        header;
+      PLogEntry*         ring;
+      uint64_t           start;
+      uint64_t           tail;
+      volatile uintptr_t inflight; // lowest ts not durable yet, ~0 if none
+      char pad[CACHELINE_BYTES - 2 * sizeof(void*) - 2 * sizeof(uint64_t)
+               - sizeof(uintptr_t)];
+
+      /**
+       *  Make room for a block of nb_writes, before the commit lock is
+       *  acquired.  Blocks while other threads flush older commits.
+       */
+      void reserve(size_t nb_writes)
+      {
+          if (plog_external.commit != NULL)
+              return;
+          if (__builtin_expect(tail + nb_writes + 2 - start > PLOG_SIZE, false))
+              truncate(nb_writes + 2);
+      }
+
+      /**
+       *  The commit will have a ts of at least lower_bound, other threads
+       *  must not drop blocks from that ts on.  Call before the lock CAS.
+       */
+      void begin_commit(uintptr_t lower_bound) { inflight = lower_bound; }
+
+      /*** the commit aborted or its writes are durable */
+      void end_commit()
+      {
+          CFENCE;
+          inflight = ~(uintptr_t)0;
+      }
+
+      /**
+       *  Serialize the writes as a block and persist it, this is the
+       *  durability point of the transaction.  Must hold the commit lock.
+       *  Stack writes are not logged (they are not written back).
+       */
+#if !defined(STM_PROTECT_STACK)
+      TM_INLINE void append(WriteSet& writes, uintptr_t ts)
+#else
+      TM_INLINE void append(WriteSet& writes, uintptr_t ts,
+                            void** upper_stack_bound)
+#endif
+      {
+          const uint64_t mask = PLOG_SIZE - 1;
+          uint64_t pos = tail + 1;
+          uintptr_t nb = 0, sum = 0;
+
+          if (plog_external.commit != NULL) {
+              plog_external.begin();
+              for (WriteSet::iterator i = writes.begin(), e = writes.end();
+                   i != e; ++i)
+              {
+#ifdef STM_PROTECT_STACK
+                  void* top_of_stack;
+                  if (i->filter(&top_of_stack, upper_stack_bound))
+                      continue;
+#endif
+                  plog_external.write(i->addr, i->val);
+              }
+              plog_external.commit();
+              return;
+          }
+
+          for (WriteSet::iterator i = writes.begin(), e = writes.end();
+               i != e; ++i)
+          {
+#ifdef STM_PROTECT_STACK
+              void* top_of_stack;
+              if (i->filter(&top_of_stack, upper_stack_bound))
+                  continue;
+#endif
+              PLogEntry& entry = ring[pos++ & mask];
+              entry.addr = (uintptr_t)i->addr;
+              entry.val  = (uintptr_t)i->val;
+              sum = plog_mix(plog_mix(sum, entry.addr), entry.val);
+              ++nb;
+          }
+
+          ring[tail & mask].addr = nb;
+          ring[tail & mask].val  = ts;
+          ring[pos & mask].addr  = plog_mix(plog_mix(sum, nb), ts);
+          ring[pos & mask].val   = ts;
+          ++pos;
+
+          flush(tail, pos);
+          MN_drain();
+          MN_count_writes += nb + 2;
+          tail = pos;
+      }
+
+      /**
+       *  Flush the writeback of the last commit, after the commit lock is
+       *  released.  The caller must then call end_commit.
+       */
+#if !defined(STM_PROTECT_STACK)
+      TM_INLINE void persist(WriteSet& writes)
+#else
+      TM_INLINE void persist(WriteSet& writes, void** upper_stack_bound)
+#endif
+      {
+          if (plog_external.commit != NULL)
+              return;
+          for (WriteSet::iterator i = writes.begin(), e = writes.end();
+               i != e; ++i)
+          {
+#ifdef STM_PROTECT_STACK
+              void* top_of_stack;
+              if (i->filter(&top_of_stack, upper_stack_bound))
+                  continue;
+#endif
+              MN_flush(i->addr, sizeof(void*), 1);
+          }
+          MN_drain();
+      }
+
+      /*** write back the ring lines of the entries [from, to) */
+      void flush(uint64_t from, uint64_t to)
+      {
+          const uint64_t mask = PLOG_SIZE - 1;
+          uint64_t first = from & mask, last = (to - 1) & mask;
+
+          if (first <= last) {
+              MN_flush(&ring[first], (last - first + 1) * sizeof(PLogEntry), 1);
+          }
+          else {
+              MN_flush(&ring[first], (PLOG_SIZE - first) * sizeof(PLogEntry), 1);
+              MN_flush(&ring[0], (last + 1) * sizeof(PLogEntry), 1);
+          }
+      }
+
+      void truncate(uint64_t needed);
+  } __attribute__((aligned(CACHELINE_BYTES)));
+
+  extern PersistentLog plogs[PLOG_NB_RINGS];
+
+  /**
+   *  Hide the stack bound, as STM_ROLLBACK does for the WriteSet
+   */
+#if !defined(STM_PROTECT_STACK)
+#   define PLOG_APPEND(log, writes, ts, stack) (log).append(writes, ts)
+#   define PLOG_PERSIST(log, writes, stack)    (log).persist(writes)
+#else
+#   define PLOG_APPEND(log, writes, ts, stack) (log).append(writes, ts, stack)
+#   define PLOG_PERSIST(log, writes, stack)    (log).persist(writes, stack)
+#endif
+
+  /**
+   *  Map the rings (sys_init), replays the committed blocks if the pool
+   *  existed.
+   */
+  void plog_init();
+
+  /**
+   *  Apply the blocks that may not be durable in the heap, in timestamp
+   *  order, then empty the rings.  Returns the number of replayed blocks,
+   *  the ones that write outside the reattached pools are dropped.
+   */
+  size_t plog_recover();
+
+  /**
+   *  Empty the rings and persist the last timestamp as durable, once the
+   *  threads are done (sys_shutdown)
+   */
+  void plog_shutdown();
+
+  /**
+   *  Send the commits to an external log, before the threads start
+   */
+  void plog_set_external(void (*begin)(), void (*write)(void*, void*),
+                         void (*commit)(), void (*abort)());
+}
+
+#endif // PERSISTENT_TM
+
+#endif // PERSISTENTLOG_HPP__
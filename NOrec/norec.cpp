@@ -20,9 +20,11 @@
 #include <cm.hpp>
 #include <algs/algs.hpp>
 #include <RedoRAWUtils.hpp>
+#include <htm.h> // the seqlock is subscribed by phasedTM (PER_BLOCK_MODE)
 
 #ifdef PERSISTENT_TM
 #include <min_nvm.h>
+#include <stm/PersistentLog.hpp>
 #endif
 
 // Don't just import everything from stm. This helps us find bugs.
@@ -143,16 +145,32 @@ namespace {
   bool
   irrevoc(STM_IRREVOC_SIG(tx,upper_stack_bound))
   {
-      while (!bcasptr(&timestamp.val, tx->start_time, tx->start_time + 1))
-          if ((tx->start_time = validate(tx)) == VALIDATION_FAILED)
+#ifdef PERSISTENT_TM
+      stm::PersistentLog& log = stm::plogs[tx->id - 1];
+      log.reserve(tx->writes.size());
+      log.begin_commit(tx->start_time + 2);
+#endif
+      while (!htm_exclusive(bcasptr(&timestamp.val, tx->start_time, tx->start_time + 1)))
+          if ((tx->start_time = validate(tx)) == VALIDATION_FAILED) {
+#ifdef PERSISTENT_TM
+              log.end_commit();
+#endif
               return false;
+          }
 
+#ifdef PERSISTENT_TM
+      PLOG_APPEND(log, tx->writes, tx->start_time + 2, upper_stack_bound);
+#endif
       // redo writes
       tx->writes.writeback(STM_WHEN_PROTECT_STACK(upper_stack_bound));
 
       // Release the sequence lock, then clean up
       CFENCE;
       timestamp.val = tx->start_time + 2;
+#ifdef PERSISTENT_TM
+      PLOG_PERSIST(log, tx->writes, upper_stack_bound);
+      log.end_commit();
+#endif
       tx->vlist.reset();
       tx->writes.reset();
       return true;
@@ -225,7 +243,7 @@ namespace {
       }
 
       // get the lock and validate (use RingSTM obstruction-free technique)
-      while (!bcasptr(&timestamp.val, tx->start_time, tx->start_time + 1))
+      while (!htm_exclusive(bcasptr(&timestamp.val, tx->start_time, tx->start_time + 1)))
           if ((tx->start_time = validate(tx)) == VALIDATION_FAILED) {
               tx->tmabort(tx);
           }
@@ -288,19 +306,25 @@ namespace {
       // writeback and increments the seqlock again
 
 #ifdef PERSISTENT_TM
-      int nb_flushes = tx->writes.size();
+      // room in the log is made before the lock, truncation may wait
+      stm::PersistentLog& log = stm::plogs[tx->id - 1];
+      log.reserve(tx->writes.size());
+      log.begin_commit(tx->start_time + 2);
 #endif
       // get the lock and validate (use RingSTM obstruction-free technique)
-      while (!bcasptr(&timestamp.val, tx->start_time, tx->start_time + 1))
+      while (!htm_exclusive(bcasptr(&timestamp.val, tx->start_time, tx->start_time + 1)))
           if ((tx->start_time = validate(tx)) == VALIDATION_FAILED) {
 #ifdef PERSISTENT_TM
-              // flush abort marker to persistent log
-              MN_count_writes += 2;   // not necessary?
-              SPIN_PER_WRITE(1);
+              // nothing was logged, a redo log needs no abort marker
+              log.end_commit();
 #endif
               tx->tmabort(tx);
           }
 
+#ifdef PERSISTENT_TM
+      // one block, one fence: the transaction is durable from here
+      PLOG_APPEND(log, tx->writes, tx->start_time + 2, upper_stack_bound);
+#endif
       tx->writes.writeback(STM_WHEN_PROTECT_STACK(upper_stack_bound));
 
       // Release the sequence lock, then clean up
@@ -308,7 +332,9 @@ namespace {
       timestamp.val = tx->start_time + 2;
 
 #ifdef PERSISTENT_TM
-      SPIN_PER_WRITE(nb_flushes + /* commit marker */ 2);
+      // the heap lines are flushed outside the commit window
+      PLOG_PERSIST(log, tx->writes, upper_stack_bound);
+      log.end_commit();
 #endif
 
       // notify CM
@@ -21,6 +21,10 @@
 
 #include <setjmp.h>
 
+#ifdef PERSISTENT_TM
+#include <stm/PersistentLog.hpp>
+#endif
+
 // Don't just import everything from stm. This helps us find bugs.
 using stm::TxThread;
 using stm::timestamp;
@@ -327,7 +331,7 @@ retry_htm_posfix:
 		// set lock bit (LSB)
 		uint64_t new_clock = tx->tx_version | SET_LOCK_BIT_MASK;
 		uint64_t expected_clock = tx->tx_version;
-		if ( boolCAS(global_clock, expected_clock, new_clock)) {
+		if ( htm_exclusive(boolCAS(global_clock, expected_clock, new_clock)) ) {
 			tx->tx_version = new_clock;
 			tx->clock_lock_is_mine = true;
 			return;
@@ -340,11 +344,21 @@ retry_htm_posfix:
 	void MIXED_SLOW_PATH_WRITE_RO(STM_WRITE_SIG(tx,addr,value,mask)){
 		if (tx->is_rh_prefix_active) COMMIT_RH_HTM_PREFIX(tx);
 		ACQUIRE_CLOCK_LOCK(tx);
+#ifdef PERSISTENT_TM
+		// the writes are in place: the external log takes each one, the
+		// commit is ordered here, while no other writer can commit
+		if (stm::plog_external.commit == NULL)
+			stm::UNRECOVERABLE("RH-NOrec needs an external persistent log.");
+		stm::plog_external.begin();
+#endif
 		if (!START_RH_HTM_POSFIX(tx)){
 			lock(global_htm_lock);
 			tx->is_htm_lock_mine = true;
 			//if(isLocked(serial_lock)) stm::restart();
 		}
+#ifdef PERSISTENT_TM
+		stm::plog_external.write(addr, value);
+#endif
 		(*addr) = value;
 		// switch to read-write "mode"
 		tx->tmread   = MIXED_SLOW_PATH_READ;
@@ -353,6 +367,9 @@ retry_htm_posfix:
 	}
 	
 	void MIXED_SLOW_PATH_WRITE_RW(STM_WRITE_SIG(tx,addr,value,mask)){
+#ifdef PERSISTENT_TM
+		stm::plog_external.write(addr, value);
+#endif
 		(*addr) = value;
 	}
 	
@@ -410,6 +427,12 @@ retry_htm_posfix:
 		}
 		CFENCE;
 
+#ifdef PERSISTENT_TM
+		// after the release: the HW transactions that started before the
+		// first write may need the clock to commit, the marker waits for them
+		stm::plog_external.commit();
+#endif
+
 		if (tx->on_fallback) {
 			atomicDec(num_of_fallbacks);
 			tx->on_fallback = false;
@@ -442,6 +465,10 @@ retry_htm_posfix:
 	stm::scope_t* rollback(STM_ROLLBACK_SIG(tx, upper_stack_bound, except, len)){
 		
 		if (tx->clock_lock_is_mine) {
+#ifdef PERSISTENT_TM
+			// nothing was written in place yet
+			stm::plog_external.abort();
+#endif
 			uint64_t new_clock = (tx->tx_version & RESET_LOCK_BIT_MASK) + 1;
 			atomicWrite(global_clock, new_clock);
 			tx->clock_lock_is_mine = false;
@@ -17,6 +17,9 @@
 #include <algs/tml_inline.hpp>
 #include <algs/algs.hpp>
 #include <inst.hpp>
+#ifdef PERSISTENT_TM
+#include <stm/PersistentLog.hpp>
+#endif
 
 using namespace stm;
 
@@ -144,6 +147,10 @@ namespace stm
 
       // predict the new value of threadcount.val
       id = threadcount.val + 1;
+#ifdef PERSISTENT_TM
+      if (id > PLOG_NB_RINGS)
+          UNRECOVERABLE("Too many threads for the persistent log.");
+#endif
 
       // update the allocator
       allocator.setID(id-1);
@@ -261,6 +268,11 @@ namespace stm
 
       std::cout << "Total nontxn work:\t" << nontxn_count << std::endl;
 
+#ifdef PERSISTENT_TM
+      // the next run has nothing to replay
+      plog_shutdown();
+#endif
+
       // if we ever switched to ProfileApp, then we should print out the
       // ProfileApp custom output.
       if (app_profiles) {
@@ -413,6 +425,11 @@ namespace stm
           // now initialize the the adaptive policies
           pol_init(cfg);
 
+#ifdef PERSISTENT_TM
+          // map the redo logs and replay them after a crash
+          plog_init();
+#endif
+
           // this is (for now) how we make sure we have a buffer to hold
           // profiles.  This also specifies how many profiles we do at a time.
           char* spc = getenv("STM_NUMPROFILES");
@@ -450,4 +467,12 @@ namespace stm
       return init_lib_name;
   }
 
+  /**
+   *  Return the address of the commit seqlock
+   */
+  volatile uintptr_t* get_seqlock()
+  {
+      return &timestamp.val;
+  }
+
 } // namespace stm
@@ -0,0 +1,320 @@
+#ifndef _RTM_INCLUDE
+#define _RTM_INCLUDE
+
+/*
+ * Best-effort HTM emulated in software (HTM_EMULATION), for machines
+ * without TSX. Same interface and status bits as haswell/rtm.h.
+ *
+ * - Conflicts: the transactions run concurrently, the lines passed to
+ *   htm_read/htm_write are acquired in a table of HTM_EMU_ORECS ownership
+ *   records (a writer and a count of readers, line % HTM_EMU_ORECS). A
+ *   transaction that reads a line written by another, or writes a line
+ *   read or written by another, aborts with ABORT_TX_CONFLICT |
+ *   ABORT_RETRY (the requester loses). The records are released on commit
+ *   and abort. Two lines HTM_EMU_ORECS lines apart share a record.
+ *   Uninstrumented accesses are not tracked.
+ * - Fallbacks: a lock taken with lock() (locks.h) waits for the running
+ *   transactions (htm_quiesce), like the abort of the subscribers in
+ *   hardware, the next ones see it taken. The writers of a subscribed word
+ *   (the modes of phasedTM, the seqlocks and clocks of the hybrid NOrecs)
+ *   use htm_exclusive: the transactions that begin wait for them and the
+ *   running ones commit before the write.
+ * - Capacity: the lines passed to htm_read/htm_write go to an L1 of
+ *   HTM_EMU_SETS x HTM_EMU_WAYS lines (see microbench/apps/capacity). A
+ *   line that does not fit in its set aborts with ABORT_CAPACITY.
+ * - Aborts: htm_write saves the old word in an undo log, the abort restores
+ *   it and the HTM_EMU_STACK bytes of stack above htm_begin, then jumps
+ *   back to htm_begin (which may have returned, as in TX_START) with the
+ *   status. Uninstrumented writes are not undone. The writes are in place:
+ *   code outside the transactions (not ordered by a fallback lock) may see
+ *   them before the commit.
+ *
+ * The transactions are flat-nested, htm_abort is ABORT_EXPLICIT with the
+ * code 0xab in bits 31:24.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <ucontext.h>
+
+#ifndef HTM_EMU_SETS
+#define HTM_EMU_SETS 64
+#endif
+#ifndef HTM_EMU_WAYS
+#define HTM_EMU_WAYS 8
+#endif
+#ifndef HTM_EMU_LINE
+#define HTM_EMU_LINE 64
+#endif
+#ifndef HTM_EMU_STACK
+#define HTM_EMU_STACK 8192 // bytes of stack restored on abort
+#endif
+#ifndef HTM_EMU_ORECS
+#define HTM_EMU_ORECS (1 << 20)
+#endif
+#ifndef HTM_EMU_MAX_THREADS
+#define HTM_EMU_MAX_THREADS 1024
+#endif
+
+#define HTM_EMU_STARTED    (~0u)
+#define HTM_EMU_UNDO       (HTM_EMU_SETS * HTM_EMU_WAYS * (HTM_EMU_LINE / 8))
+#define HTM_EMU_ALT_STACK  (64 * 1024)
+#define HTM_EMU_READ       1
+#define HTM_EMU_WRITE      2
+#define HTM_EMU_READERS    0xffffffffull // writer id in the high half
+
+#define ABORT_EXPLICIT	  (1 << 0)
+#define ABORT_RETRY	      (1 << 1)
+#define ABORT_TX_CONFLICT	(1 << 2)
+#define ABORT_CAPACITY	  (1 << 3)
+#define ABORT_ILLEGAL		  (1 << 4)
+#define ABORT_NESTED		  (1 << 5)
+
+typedef struct htm_emu_tx_ {
+	void *env[5]; // __builtin_setjmp
+	uint64_t id;
+	volatile long seq; // odd while a transaction runs
+	long depth;
+	uint32_t status;
+	char *stack, *stack_end;
+	long stack_size;
+	long nb_undo;
+	uintptr_t undo[HTM_EMU_UNDO][2]; // address, old word
+	uintptr_t lines[HTM_EMU_SETS][HTM_EMU_WAYS];
+	unsigned char modes[HTM_EMU_SETS][HTM_EMU_WAYS]; // HTM_EMU_READ/WRITE
+	unsigned char nb_lines[HTM_EMU_SETS];
+	char stack_copy[HTM_EMU_STACK];
+	ucontext_t restore;
+	char *alt_stack;
+} htm_emu_tx_t;
+
+// one definition for all the objects that include this
+__attribute__((weak)) volatile uint64_t htm_emu_orecs[HTM_EMU_ORECS];
+__attribute__((weak)) htm_emu_tx_t *volatile htm_emu_txs[HTM_EMU_MAX_THREADS];
+__attribute__((weak)) volatile long htm_emu_nb_txs;
+__attribute__((weak)) volatile long htm_emu_excl; // see htm_exclusive
+__attribute__((weak)) __thread htm_emu_tx_t *htm_emu_self;
+
+static inline htm_emu_tx_t *htm_emu_get(){
+	pthread_attr_t attr;
+	void *addr;
+	size_t size;
+	htm_emu_tx_t *tx = htm_emu_self;
+
+	if (tx != NULL) return tx;
+
+	tx = (htm_emu_tx_t*) calloc(1, sizeof(htm_emu_tx_t));
+	tx->alt_stack = (char*) malloc(HTM_EMU_ALT_STACK);
+	if (tx->alt_stack == NULL) abort();
+	pthread_getattr_np(pthread_self(), &attr);
+	pthread_attr_getstack(&attr, &addr, &size);
+	pthread_attr_destroy(&attr);
+	tx->stack_end = (char*) addr + size;
+	tx->id = __atomic_fetch_add(&htm_emu_nb_txs, 1, __ATOMIC_SEQ_CST) + 1;
+	if (tx->id > HTM_EMU_MAX_THREADS) abort();
+	__atomic_store_n(&htm_emu_txs[tx->id - 1], tx, __ATOMIC_SEQ_CST);
+	htm_emu_self = tx;
+
+	return tx;
+}
+
+// waits for the transactions running in other threads
+static inline void htm_emu_quiesce(){
+	long i, n = __atomic_load_n(&htm_emu_nb_txs, __ATOMIC_SEQ_CST);
+
+	for (i = 0; i < n; ++i) {
+		htm_emu_tx_t *tx = __atomic_load_n(&htm_emu_txs[i], __ATOMIC_SEQ_CST);
+		long seq;
+
+		if (tx == NULL || tx == htm_emu_self) continue;
+		seq = __atomic_load_n(&tx->seq, __ATOMIC_SEQ_CST);
+		if (!(seq & 1)) continue;
+		while (__atomic_load_n(&tx->seq, __ATOMIC_ACQUIRE) == seq) sched_yield();
+	}
+}
+
+static inline void htm_emu_release(htm_emu_tx_t *tx){
+	int set, i;
+
+	for (set = 0; set < HTM_EMU_SETS; ++set) {
+		for (i = 0; i < tx->nb_lines[set]; ++i) {
+			volatile uint64_t *orec =
+				&htm_emu_orecs[tx->lines[set][i] % HTM_EMU_ORECS];
+
+			if (tx->modes[set][i] & HTM_EMU_WRITE) {
+				__atomic_fetch_and(orec, HTM_EMU_READERS, __ATOMIC_RELEASE);
+			}
+			if (tx->modes[set][i] & HTM_EMU_READ) {
+				__atomic_fetch_sub(orec, 1, __ATOMIC_RELEASE);
+			}
+		}
+	}
+}
+
+// the copy is taken in this frame, below the one of htm_begin
+static __attribute__((noinline, unused)) uint32_t htm_emu_start(){
+	htm_emu_tx_t *tx = htm_emu_self;
+	char here;
+
+	// running, unless a htm_exclusive is writing (then it waits for it)
+	while (1) {
+		__atomic_add_fetch(&tx->seq, 1, __ATOMIC_SEQ_CST);
+		if (!__atomic_load_n(&htm_emu_excl, __ATOMIC_SEQ_CST)) break;
+		__atomic_add_fetch(&tx->seq, 1, __ATOMIC_SEQ_CST);
+		while (__atomic_load_n(&htm_emu_excl, __ATOMIC_ACQUIRE)) sched_yield();
+	}
+
+	tx->depth = 1;
+	tx->nb_undo = 0;
+	memset(tx->nb_lines, 0, sizeof(tx->nb_lines));
+	tx->stack = &here;
+	tx->stack_size = tx->stack_end - &here < HTM_EMU_STACK
+		? tx->stack_end - &here : HTM_EMU_STACK;
+	memcpy(tx->stack_copy, tx->stack, tx->stack_size);
+
+	return HTM_EMU_STARTED;
+}
+
+// runs in the alternate stack, the one of the transaction is overwritten
+static inline void htm_emu_restore(){
+	htm_emu_tx_t *tx = htm_emu_self;
+
+	memcpy(tx->stack, tx->stack_copy, tx->stack_size);
+	__builtin_longjmp(tx->env, 1);
+}
+
+static inline __attribute__((noreturn)) void htm_emu_abort(uint32_t status){
+	htm_emu_tx_t *tx = htm_emu_self;
+	long i;
+
+	for (i = tx->nb_undo - 1; i >= 0; --i) {
+		*((uintptr_t*) tx->undo[i][0]) = tx->undo[i][1];
+	}
+	htm_emu_release(tx);
+	tx->depth = 0;
+	tx->status = status;
+	__atomic_add_fetch(&tx->seq, 1, __ATOMIC_RELEASE);
+
+	getcontext(&tx->restore);
+	tx->restore.uc_stack.ss_sp = tx->alt_stack;
+	tx->restore.uc_stack.ss_size = HTM_EMU_ALT_STACK;
+	tx->restore.uc_link = NULL;
+	makecontext(&tx->restore, htm_emu_restore, 0);
+	setcontext(&tx->restore);
+	abort(); // not reached
+}
+
+// takes the record of the line for the mode (it may hold it for the other)
+static inline void htm_emu_acquire(htm_emu_tx_t *tx, uintptr_t line,
+		int mode, int held){
+	volatile uint64_t *orec = &htm_emu_orecs[line % HTM_EMU_ORECS];
+	uint64_t old = __atomic_load_n(orec, __ATOMIC_ACQUIRE), val;
+
+	do {
+		uint64_t writer = old >> 32, readers = old & HTM_EMU_READERS;
+
+		if (writer != 0 && writer != tx->id) {
+			htm_emu_abort(ABORT_TX_CONFLICT | ABORT_RETRY);
+		}
+		if (mode == HTM_EMU_WRITE) {
+			if (readers > ((held & HTM_EMU_READ) ? 1 : 0)) {
+				htm_emu_abort(ABORT_TX_CONFLICT | ABORT_RETRY);
+			}
+			val = (tx->id << 32) | readers;
+		} else {
+			val = old + 1;
+		}
+	} while (!__atomic_compare_exchange_n(orec, &old, val, 0,
+		__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+}
+
+static inline void htm_emu_access(void *addr, int mode){
+	htm_emu_tx_t *tx = htm_emu_self;
+	uintptr_t line = (uintptr_t) addr / HTM_EMU_LINE;
+	uintptr_t *lines = tx->lines[line % HTM_EMU_SETS];
+	unsigned char *modes = tx->modes[line % HTM_EMU_SETS];
+	unsigned char *nb_lines = &tx->nb_lines[line % HTM_EMU_SETS];
+	int i;
+
+	for (i = 0; i < *nb_lines; ++i) {
+		if (lines[i] == line) {
+			if (modes[i] >= mode) return; // a write covers the reads
+			htm_emu_acquire(tx, line, mode, modes[i]);
+			modes[i] |= mode;
+			return;
+		}
+	}
+	if (*nb_lines == HTM_EMU_WAYS) htm_emu_abort(ABORT_CAPACITY);
+	htm_emu_acquire(tx, line, mode, 0);
+	lines[*nb_lines] = line;
+	modes[(*nb_lines)++] = mode;
+}
+
+static inline void htm_emu_write(void *addr){
+	htm_emu_tx_t *tx = htm_emu_self;
+	uintptr_t word = (uintptr_t) addr & ~((uintptr_t) 7);
+
+	htm_emu_access(addr, HTM_EMU_WRITE);
+	if (tx->nb_undo == HTM_EMU_UNDO) htm_emu_abort(ABORT_CAPACITY);
+	tx->undo[tx->nb_undo][0] = word;
+	tx->undo[tx->nb_undo][1] = *((uintptr_t*) word);
+	tx->nb_undo++;
+}
+
+static inline void htm_emu_end(){
+	htm_emu_tx_t *tx = htm_emu_self;
+
+	if (--tx->depth == 0) {
+		htm_emu_release(tx);
+		__atomic_add_fetch(&tx->seq, 1, __ATOMIC_RELEASE);
+	}
+}
+
+#define htm_emu_in_tx() (htm_emu_self != NULL && htm_emu_self->depth > 0)
+
+// __builtin_setjmp in the frame of the caller, as _xbegin
+#define htm_begin() ({ \
+	htm_emu_tx_t *__tx = htm_emu_get(); \
+	uint32_t __s; \
+	if (__tx->depth > 0) { \
+		__tx->depth++; \
+		__s = HTM_EMU_STARTED; \
+	} else if (__builtin_setjmp(__tx->env) == 0) { \
+		__s = htm_emu_start(); \
+	} else { \
+		__s = htm_emu_self->status; \
+	} \
+	__s; \
+})
+#define htm_end()   	htm_emu_end()
+#define htm_abort()	  htm_emu_abort(ABORT_EXPLICIT | (0xabu << 24))
+
+#define htm_read(addr)  ({ if (htm_emu_in_tx()) htm_emu_access((void*) (addr), HTM_EMU_READ); })
+#define htm_write(addr) ({ if (htm_emu_in_tx()) htm_emu_write((void*) (addr)); })
+
+// a fallback waits for the running transactions
+#define htm_quiesce() htm_emu_quiesce()
+
+// a write to a word the transactions subscribe (a mode, a seqlock or a
+// clock), outside the transactions: they either committed before it or see
+// it, as the abort of the subscribers in hardware
+#define htm_exclusive(expr) ({ \
+	__typeof__(expr) __r; \
+	while (__atomic_exchange_n(&htm_emu_excl, 1, __ATOMIC_SEQ_CST)) \
+		sched_yield(); \
+	htm_emu_quiesce(); \
+	__r = (expr); \
+	__atomic_store_n(&htm_emu_excl, 0, __ATOMIC_RELEASE); \
+	__r; \
+})
+
+#define htm_has_started(s) (s == HTM_EMU_STARTED)
+
+#define htm_abort_reason(s) (s)
+
+#define htm_abort_persistent(s) (s & 0)
+
+#endif /* _RTM_INCLUDE */
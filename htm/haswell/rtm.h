@@ -13,6 +13,7 @@
 #define htm_abort_reason(s) (s)
 
 #define ABORT_EXPLICIT	  _XABORT_EXPLICIT
+#define ABORT_RETRY	      _XABORT_RETRY
 #define ABORT_TX_CONFLICT	_XABORT_CONFLICT
 #define ABORT_CAPACITY	  _XABORT_CAPACITY
 #define ABORT_ILLEGAL		  _XABORT_DEBUG
@@ -72,6 +72,9 @@ void increaseTransTimestampSize(uint64_t **ptr, uint64_t *oldLength, uint64_t ne
 void TX_START(){
 	
 	__tx_retries = 0;
+#ifdef ADAPTIVE_RETRIES
+	HTM_RP_begin(__builtin_return_address(0)); // the atomic block
+#endif /* ADAPTIVE_RETRIES */
 #if defined(PHASE_PROFILING) || defined(TIME_MODE_PROFILING)
 	if(started == 0){
 		started = 1;
@@ -123,11 +126,16 @@ void TX_START(){
 	}
 #endif
 
+#ifdef ADAPTIVE_RETRIES
+			__tx_retries = HTM_RP_abort(htm_retry_cause(abort_reason),
+				htm_retry_persistent(abort_reason)) ? 0 : HTM_MAX_RETRIES;
+#else
 			if (htm_abort_persistent(abort_reason)){
 				__tx_retries = HTM_MAX_RETRIES;
 			} else {
 				__tx_retries++;
 			}
+#endif /* ADAPTIVE_RETRIES */
 		
 			if(__tx_retries >= HTM_MAX_RETRIES){
 				__tx_retries = HTM_MAX_RETRIES;
@@ -162,6 +170,9 @@ void TX_END(){
 	}
 	else{
 		htm_end();
+#ifdef ADAPTIVE_RETRIES
+		HTM_RP_commit();
+#endif /* ADAPTIVE_RETRIES */
 		__inc_commit_counter(__tx_id);
 	}
 }
@@ -1,18 +1,51 @@
 #ifndef _HTM_H
 #define _HTM_H
 
-#if defined(__powerpc__) || defined(__ppc__) || defined(__PPC__)
+#if defined(HTM_EMULATION)
+#include "emulated/rtm.h"
+#define __CACHE_ALIGNMENT__ 0x1000
+#define __CACHE_LINE_SIZE__ (64)
+#elif defined(__powerpc__) || defined(__ppc__) || defined(__PPC__)
 #include "power8/rtm.h"
 #define __CACHE_ALIGNMENT__ 0x10000
 #define __CACHE_LINE_SIZE__ (128)
-#endif
-
-#if defined(__x86_64__) || defined(__i386)
+#elif defined(__x86_64__) || defined(__i386)
 #include "haswell/rtm.h"
 #define __CACHE_ALIGNMENT__ 0x1000
 #define __CACHE_LINE_SIZE__ (64)
 #endif
 
+// the hardware tracks the accesses (see emulated/rtm.h), nvhtm's arch.h
+// may have defined some of these already
+#ifndef htm_read
+#define htm_read(addr)  /* empty */
+#endif
+#ifndef htm_write
+#define htm_write(addr) /* empty */
+#endif
+#ifndef htm_quiesce
+#define htm_quiesce()   /* empty */
+#endif
+#ifndef htm_exclusive
+#define htm_exclusive(expr) (expr)
+#endif
+
+#ifdef ADAPTIVE_RETRIES
+// retry budget learnt per atomic block (nvhtm/htm_alg/include)
+#include <htm_retry_policy.h>
+
+#define htm_retry_cause(s) \
+	((s & ABORT_CAPACITY) ? HTM_RP_CAPACITY : \
+	(s & ABORT_TX_CONFLICT) ? HTM_RP_CONFLICT : \
+	(s & ABORT_EXPLICIT) ? HTM_RP_EXPLICIT : HTM_RP_OTHER)
+
+#ifdef ABORT_PERSISTENT
+#define htm_retry_persistent(s) htm_abort_persistent(s)
+#else
+// TSX: the hardware does not expect a retry to succeed
+#define htm_retry_persistent(s) (!(s & ABORT_RETRY))
+#endif
+#endif /* ADAPTIVE_RETRIES */
 
 #define __ALIGN__ __attribute__((aligned(__CACHE_ALIGNMENT__)))
 
@@ -13,8 +13,10 @@
 #define LOCK_INITIALIZER 0
 
 #define isLocked(l) (__atomic_load_n(l, __ATOMIC_SEQ_CST) == 1)
-#define lock(l) \
-	while (__atomic_exchange_n(l,1, __ATOMIC_SEQ_CST)) pthread_yield()
+#define lock(l) do { \
+	while (__atomic_exchange_n(l,1, __ATOMIC_SEQ_CST)) pthread_yield(); \
+	htm_quiesce(); \
+} while (0)
 
 #define unlock(l) \
 	__atomic_store_n(l, 0, __ATOMIC_RELEASE)
@@ -44,8 +46,10 @@
 #define LOCK_INITIALIZER 0
 
 #define isLocked(l) (__atomic_load_n(l,__ATOMIC_SEQ_CST) == 1)
-#define lock(l) \
-	while (__atomic_exchange_n(l,1, __ATOMIC_SEQ_CST)) pthread_yield()
+#define lock(l) do { \
+	while (__atomic_exchange_n(l,1, __ATOMIC_SEQ_CST)) pthread_yield(); \
+	htm_quiesce(); \
+} while (0)
 
 #define unlock(l) \
 	__atomic_store_n(l, 0, __ATOMIC_SEQ_CST)
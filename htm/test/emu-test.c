@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <htm.h>
+
+#ifndef HTM_EMULATION
+#error "emu-test checks the software HTM, build with HTM_EMULATION=1"
+#endif
+
+/*
+ * Aborts of the emulated HTM (emulated/rtm.h):
+ *   - HTM_EMU_WAYS lines of one set commit, one more aborts with
+ *     ABORT_CAPACITY and the words written are restored;
+ *   - a transaction that writes a line another one reads or writes, or
+ *     reads a line another one writes, aborts with ABORT_TX_CONFLICT, the
+ *     one that runs commits;
+ *   - transactions that only read the same line, or touch disjoint lines,
+ *     both commit;
+ *   - htm_abort is ABORT_EXPLICIT with the code 0xab.
+ */
+
+#define STRIDE (HTM_EMU_SETS * HTM_EMU_LINE / sizeof(long)) // same set
+#define LINE   (HTM_EMU_LINE / sizeof(long))
+
+static long set[(HTM_EMU_WAYS + 1) * STRIDE] __attribute__((aligned(HTM_EMU_LINE)));
+static long shared[2 * LINE] __attribute__((aligned(HTM_EMU_LINE)));
+static volatile int a_write, a_started, b_done;
+static volatile uint32_t a_status;
+static long failed;
+
+static void check(const char *name, int ok){
+	printf("%-24s %s\n", name, ok ? "PASSED" : "FAILED");
+	if (!ok) failed++;
+}
+
+// writes 1 to the first word of nb_lines lines of the same set
+static uint32_t fill_set(long nb_lines){
+	uint32_t status;
+	long i;
+
+	if ((status = htm_begin()) == HTM_EMU_STARTED) {
+		for (i = 0; i < nb_lines; i++) {
+			htm_write(&set[i * STRIDE]);
+			set[i * STRIDE] = 1;
+		}
+		htm_end();
+	}
+
+	return status;
+}
+
+static long set_sum(){
+	long i, sum = 0;
+
+	for (i = 0; i <= HTM_EMU_WAYS; i++) {
+		sum += set[i * STRIDE];
+	}
+
+	return sum;
+}
+
+// reads or writes the first line of shared and waits, inside the
+// transaction, for the ones of main
+static void *thread_a(void *args){
+	uint32_t status;
+
+	if ((status = htm_begin()) == HTM_EMU_STARTED) {
+		if (a_write) {
+			htm_write(&shared[0]);
+			shared[0]++;
+		} else {
+			htm_read(&shared[0]);
+		}
+		a_started = 1;
+		while (!b_done) sched_yield();
+		htm_end();
+	}
+	a_status = status;
+	a_started = 1;
+
+	return NULL;
+}
+
+static pthread_t start_a(int write){
+	pthread_t a;
+
+	a_write = write;
+	a_started = b_done = 0;
+	if (pthread_create(&a, NULL, thread_a, NULL) != 0) {
+		perror("pthread_create");
+		exit(EXIT_FAILURE);
+	}
+	while (!a_started) sched_yield();
+
+	return a;
+}
+
+static void join_a(pthread_t a){
+	b_done = 1;
+	pthread_join(a, NULL);
+}
+
+// one transaction that reads or writes addr
+static uint32_t touch(long *addr, int write){
+	uint32_t status;
+
+	if ((status = htm_begin()) == HTM_EMU_STARTED) {
+		if (write) {
+			htm_write(addr);
+			(*addr)++;
+		} else {
+			htm_read(addr);
+		}
+		htm_end();
+	}
+
+	return status;
+}
+
+static int conflict(uint32_t status){
+	return status != HTM_EMU_STARTED && (status & ABORT_TX_CONFLICT);
+}
+
+int main(int argc,char** argv){
+	pthread_t a;
+	uint32_t status;
+
+	status = fill_set(HTM_EMU_WAYS);
+	check("capacity (ways)", status == HTM_EMU_STARTED
+		&& set_sum() == HTM_EMU_WAYS);
+
+	set[0] = 0;
+	status = fill_set(HTM_EMU_WAYS + 1);
+	check("capacity (ways + 1)", status != HTM_EMU_STARTED
+		&& (status & ABORT_CAPACITY));
+	check("capacity undo", set[0] == 0 && set_sum() == HTM_EMU_WAYS - 1);
+
+	if ((status = htm_begin()) == HTM_EMU_STARTED) {
+		htm_write(&set[0]);
+		set[0] = 2;
+		htm_abort();
+	}
+	check("explicit", status != HTM_EMU_STARTED
+		&& (status & ABORT_EXPLICIT) && (status >> 24) == 0xab);
+	check("explicit undo", set[0] == 0);
+
+	// a writes shared[0]
+	a = start_a(1);
+	check("write, written line", conflict(touch(&shared[0], 1)));
+	check("read, written line", conflict(touch(&shared[1], 0)));
+	check("write, disjoint line", touch(&shared[LINE], 1) == HTM_EMU_STARTED);
+	join_a(a);
+	check("writer commits", a_status == HTM_EMU_STARTED
+		&& shared[0] == 1 && shared[1] == 0 && shared[LINE] == 1);
+
+	// a reads shared[0]
+	a = start_a(0);
+	check("read, read line", touch(&shared[0], 0) == HTM_EMU_STARTED);
+	check("write, read line", conflict(touch(&shared[0], 1)));
+	check("write, disjoint line", touch(&shared[LINE], 1) == HTM_EMU_STARTED);
+	join_a(a);
+	check("reader commits", a_status == HTM_EMU_STARTED
+		&& shared[0] == 1 && shared[LINE] == 2);
+	check("lines released", touch(&shared[0], 1) == HTM_EMU_STARTED
+		&& shared[0] == 2);
+
+	printf("\nverification = %s\n", failed ? "FAILED" : "PASSED");
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
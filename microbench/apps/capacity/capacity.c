@@ -35,18 +35,32 @@
 #define __ALIGN__ __attribute__((aligned(CACHE_ALIGNMENT)))
 #endif
 
+// the lines of the HW path, for the emulated HTM (htm/emulated/rtm.h)
+#ifndef htm_write
+#define htm_write(addr) /* empty */
+#endif
+
 #define PARAM_DEFAULT_NUMTHREADS   (1L)
 #define PARAM_DEFAULT_OVERFLOWPROB (10L)
+#define PARAM_DEFAULT_WORK         (0L)
 
 
 static pthread_t *threads __ALIGN__;
 static long nThreads __ALIGN__  = PARAM_DEFAULT_NUMTHREADS;
 static long pOverflow __ALIGN__ = PARAM_DEFAULT_OVERFLOWPROB;
+static long nWork __ALIGN__     = PARAM_DEFAULT_WORK;
 
 static uint64_t *global_array __ALIGN__;
 static int volatile stop __ALIGN__ = 0;
 static pthread_barrier_t sync_barrier __ALIGN__;
 
+// a longer overflowing transaction (PER_BLOCK_MODE of phasedTM only routes
+// the long ones to SW)
+static inline void local_work(long n){
+	volatile long j;
+	for (j = 0; j < n; j++);
+}
+
 void randomly_init_ushort_array(unsigned short *s, long n);
 void parseArgs(int argc, char** argv);
 void set_affinity(long id);
@@ -77,7 +91,9 @@ void *capacity_function(void *args){
 #ifdef HW_SW_PATHS
 			IF_HTM_MODE
 				START_HTM_MODE
+					local_work(nWork);
 					for (i=0; i < L1_BLOCKS_PER_SET + 4; i++){
+						htm_write(&global_array[thread_step + i*step + blockOffset + set]);
 						global_array[thread_step + i*step + blockOffset + set] = 42;
 					}
 				COMMIT_HTM_MODE
@@ -86,6 +102,7 @@ void *capacity_function(void *args){
 #else /* !HW_SW_PATHS */
 				TM_START(tid, RW);
 #endif /* !HW_SW_PATHS */
+					local_work(nWork);
 					for (i=0; i < L1_BLOCKS_PER_SET + 4; i++){
 						TM_STORE(&global_array[thread_step + i*step + blockOffset + set], 42);
 					}
@@ -99,6 +116,7 @@ void *capacity_function(void *args){
 			IF_HTM_MODE
 				START_HTM_MODE
 					for (i=0; i < L1_BLOCKS_PER_SET - 4; i++){
+						htm_write(&global_array[thread_step + i*step + blockOffset + set]);
 						global_array[thread_step + i*step + blockOffset + set] = 42;
 					}
 				COMMIT_HTM_MODE
@@ -185,6 +203,7 @@ void showUsage(const char* argv0){
 	printf("Options:                                      (defaults)\n");
 	printf("   n <LONG>   Number of threads                 (%ld)\n", PARAM_DEFAULT_NUMTHREADS);
 	printf("   u <LONG>   Overflow probability [0%%..100%%] (%ld)\n", PARAM_DEFAULT_OVERFLOWPROB);
+	printf("   w <LONG>   Work in the overflowing transactions (%ld)\n", PARAM_DEFAULT_WORK);
 
 }
 
@@ -192,7 +211,7 @@ void showUsage(const char* argv0){
 void parseArgs(int argc, char** argv){
 
 	int opt;
-	while( (opt = getopt(argc,argv,"n:u:")) != -1 ){
+	while( (opt = getopt(argc,argv,"n:u:w:")) != -1 ){
 		switch(opt){
 			case 'n':
 				nThreads = strtol(optarg,NULL,10);
@@ -200,6 +219,9 @@ void parseArgs(int argc, char** argv){
 			case 'u':
 				pOverflow = strtol(optarg,NULL,10);
 				break;
+			case 'w':
+				nWork = strtol(optarg,NULL,10);
+				break;
 			default:
 				showUsage(argv[0]);
 				exit(EXIT_FAILURE);
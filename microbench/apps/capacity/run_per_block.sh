@@ -0,0 +1,31 @@
+#!/bin/bash
+
+SAMPLES=5
+PHTM=../../../phasedTM
+
+# run from the capacity folder after building NOrec (and msr); the overflowing
+# block only goes to SW with PER_BLOCK_MODE, the other one stays in HTM
+run_per_block() {
+
+	sed -e "/DESIGN=OPTIMIZED/s|# ||" $PHTM/Makefile.template > $PHTM/Makefile
+	make -C $PHTM clean
+	make -C $PHTM PROFILING=TIME_MODE_PROFILING $1
+	make clean TMBUILD=phasedTM PHASED_STM=norec
+	make TMBUILD=phasedTM PHASED_STM=norec
+
+	for i in `seq $SAMPLES`
+	do
+		for t in 1 2 4 8
+		do
+			for w in 0 1000 10000 100000
+			do
+				echo "#THREADS $t W $w" >> per_block_"$2".txt
+				timeout 5m ../../phasedTM/capacity -n $t -u 10 -w $w \
+					>> per_block_"$2".txt
+			done
+		done
+	done
+}
+
+run_per_block "" GLOBAL
+run_per_block PER_BLOCK_MODE=1 PER_BLOCK
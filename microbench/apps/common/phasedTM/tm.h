@@ -164,6 +164,7 @@ static uint64_t **__stm_commits;
 static uint64_t **__stm_aborts;
 
 #define TM_INIT(nThreads)	            stm::sys_init(NULL); \
+                                      phTM_set_seqlock(stm::get_seqlock()); \
                                       phTM_init(nThreads); \
 										__stm_commits = (uint64_t **)malloc(sizeof(uint64_t *)*nThreads); \
 								    __stm_aborts  = (uint64_t **)malloc(sizeof(uint64_t *)*nThreads); \
@@ -209,7 +210,7 @@ static uint64_t **__stm_aborts;
     stm::commit(tx);      \
 
 #define IF_HTM_MODE							while(1){ \
-																	uint64_t mode = getMode(); \
+																	uint64_t mode = getBlockMode(__COUNTER__); \
 																	if (mode == HW || mode == GLOCK){
 #define START_HTM_MODE 							bool modeChanged = HTM_Start_Tx(); \
 																		if (!modeChanged) {
@@ -224,7 +225,8 @@ static uint64_t **__stm_aborts;
 																		if (!modeChanged){ \
 																			__txId__ = __COUNTER__; \
 																			STM_START(tid, ro, abort_flags);
-#define COMMIT_STM_MODE								STM_COMMIT; \
+#define COMMIT_STM_MODE								STM_PreCommit_Tx(tx->writes.size()); \
+																			STM_COMMIT; \
 																			STM_PostCommit_Tx(); \
 																			break; \
 																		} \
@@ -57,6 +57,10 @@
 	#define HTM_is_named(status)	__TM_is_named_user_abort (status, NULL);
 	#define HTM_test()				__builtin_tcheck()
 	#define HTM_commit()			__TM_end()
+	#define HTM_is_capacity(status)	__TM_is_footprint_exceeded(status)
+	#define HTM_is_conflict(status)	__TM_is_conflict(status)
+	#define HTM_is_explicit(status)	__TM_is_user_abort(status)
+	#define HTM_is_persistent(status)	__TM_is_failure_persistent(status)
 	#define HTM_get_named(status)	({ \
 		unsigned char code; \
 		__TM_is_named_user_abort (status, &code); \
@@ -110,13 +114,28 @@
 	#define HTM_STATUS_TYPE		register int
 	#define HTM_CODE_SUCCESS	_XBEGIN_STARTED
 
+#ifdef HTM_EMULATION
+	// software HTM, same status bits as TSX (htm/emulated/rtm.h)
+	#include "../../../htm/emulated/rtm.h"
+
+	#define HTM_begin(var)			(var = htm_begin())
+	#define HTM_abort()				htm_abort()
+	#define HTM_named_abort(code)	htm_emu_abort(ABORT_EXPLICIT | ((uint32_t) (code) << 24))
+	#define HTM_test()				htm_emu_in_tx()
+	#define HTM_commit()			htm_end()
+#else
 	#define HTM_begin(var)			(var = _xbegin())
 	#define HTM_abort()				_xabort(0)
 	#define HTM_named_abort(code)	_xabort(code)
 	#define HTM_test()				_xtest()
 	#define HTM_commit()			_xend()
+#endif /* HTM_EMULATION */
 	#define HTM_get_named(status)	(status >> 24)
 	#define HTM_is_named(status)	(status & 1)
+	#define HTM_is_capacity(status)	(status & _XABORT_CAPACITY)
+	#define HTM_is_conflict(status)	(status & _XABORT_CONFLICT)
+	#define HTM_is_explicit(status)	(status & _XABORT_EXPLICIT)
+	#define HTM_is_persistent(status)	(!(status & _XABORT_RETRY))
 
 	#define HTM_ERROR_INC(status, error_array) ({ \
 	  if (status == _XBEGIN_STARTED) { \
@@ -155,6 +174,18 @@
 	#define HTM_commit()
 #endif /* DISABLE_HTM */
 
+// the emulated HTM tracks and undoes the words and waits for the running
+// transactions in the fallback, the hardware needs nothing
+#ifndef htm_read
+#define htm_read(addr) /* empty */
+#endif /* htm_read */
+#ifndef htm_write
+#define htm_write(addr) /* empty */
+#endif /* htm_write */
+#ifndef htm_quiesce
+#define htm_quiesce() /* empty */
+#endif /* htm_quiesce */
+
 #define CL_ALIGN __attribute__((aligned(CACHE_LINE_SIZE)))
 #define CL_DISTANCE(type) CACHE_LINE_SIZE / sizeof(type)
 
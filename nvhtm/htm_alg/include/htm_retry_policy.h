@@ -0,0 +1,143 @@
+#ifndef HTM_RETRY_POLICY_H_GUARD
+#define HTM_RETRY_POLICY_H_GUARD
+
+#include <stdint.h>
+
+/*
+ * Adaptive retry budget, per thread and per atomic block (its call site,
+ * folded into HTM_RP_MAX_BLOCKS slots). For each abort cause it learns how
+ * often the retry that follows fails (a moving average of the outcomes,
+ * HTM_RP_ONE if every retry aborts):
+ *
+ * - a persistent capacity abort, or a cause whose retries commit less than
+ *   HTM_RP_MIN_PROB of the times, falls back at once. One decision in
+ *   HTM_RP_PROBE still retries, so the average can recover;
+ * - a conflict backs off a random number of pauses, up to HTM_RP_BACKOFF
+ *   doubled on each retry, before retrying;
+ * - the others retry while their retries commit, up to HTM_RP_MAX_RETRIES.
+ *
+ * The state is static in each translation unit, as the call sites. The
+ * users (htm_retry_template.h, htm/htm.c and phasedTM) map their abort
+ * status to the causes.
+ */
+
+#ifndef HTM_RP_MAX_RETRIES
+#define HTM_RP_MAX_RETRIES 64
+#endif /* HTM_RP_MAX_RETRIES */
+
+#ifndef HTM_RP_MIN_PROB
+#define HTM_RP_MIN_PROB 64 // of HTM_RP_ONE
+#endif /* HTM_RP_MIN_PROB */
+
+#define HTM_RP_ONE        1024
+#define HTM_RP_SHIFT      2  // weight of the last outcome, 1/4
+#define HTM_RP_PROBE      32
+#define HTM_RP_BACKOFF    16 // pauses
+#define HTM_RP_MAX_SHIFT  6  // of the backoff
+#define HTM_RP_MAX_BLOCKS 64
+
+#if defined(__x86_64__) || defined(__i386)
+#define HTM_RP_PAUSE() __builtin_ia32_pause()
+#else
+#define HTM_RP_PAUSE() __asm__ volatile ("or 31,31,31" ::: "memory")
+#endif
+
+enum {
+  HTM_RP_CAPACITY = 0,
+  HTM_RP_CONFLICT,
+  HTM_RP_EXPLICIT,
+  HTM_RP_OTHER,
+  HTM_RP_NB_CAUSES
+};
+
+typedef struct HTM_RP_cause_ {
+  int fail;  // of the retries after this cause, 0 if they all commit
+  int skips; // fall backs since the last probe
+} HTM_RP_cause_s;
+
+typedef struct HTM_RP_thr_ {
+  HTM_RP_cause_s blocks[HTM_RP_MAX_BLOCKS][HTM_RP_NB_CAUSES];
+  HTM_RP_cause_s *block; // of the running transaction
+  int retries;
+  int last; // cause of the running retry, -1 if none
+  uint32_t seed;
+} HTM_RP_thr_s;
+
+static __thread HTM_RP_thr_s HTM_RP_thr;
+
+static inline void HTM_RP_begin(const void *site)
+{
+  uint64_t h = ((uint64_t) (uintptr_t) site >> 2) * 0x9E3779B97F4A7C15ULL;
+
+  HTM_RP_thr.block = HTM_RP_thr.blocks[(h >> 32) % HTM_RP_MAX_BLOCKS];
+  HTM_RP_thr.retries = 0;
+  HTM_RP_thr.last = -1;
+}
+
+static inline void HTM_RP_backoff(int retries)
+{
+  HTM_RP_thr_s *thr = &HTM_RP_thr;
+  uint32_t x = thr->seed ? thr->seed : (uint32_t) (uintptr_t) thr | 1;
+  int shift = retries < HTM_RP_MAX_SHIFT ? retries : HTM_RP_MAX_SHIFT;
+  uint32_t i, n;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  thr->seed = x;
+  n = x % ((uint32_t) HTM_RP_BACKOFF << shift);
+  for (i = 0; i < n; ++i) {
+    HTM_RP_PAUSE();
+  }
+}
+
+// after an abort, 1 to retry in HTM, 0 to fall back
+static inline int HTM_RP_abort(int cause, int is_persistent)
+{
+  HTM_RP_thr_s *thr = &HTM_RP_thr;
+  HTM_RP_cause_s *c;
+
+  if (thr->block == NULL) {
+    thr->block = thr->blocks[0];
+  }
+  c = &(thr->block[cause]);
+
+  if (thr->last != -1) {
+    HTM_RP_cause_s *prev = &(thr->block[thr->last]);
+    prev->fail += (HTM_RP_ONE - prev->fail) >> HTM_RP_SHIFT;
+    thr->last = -1;
+  }
+
+  if (++thr->retries >= HTM_RP_MAX_RETRIES) {
+    return 0;
+  }
+
+  if ((is_persistent && cause == HTM_RP_CAPACITY)
+      || HTM_RP_ONE - c->fail < HTM_RP_MIN_PROB) {
+    if (++c->skips < HTM_RP_PROBE) {
+      return 0;
+    }
+    c->skips = 0;
+  }
+
+  if (cause == HTM_RP_CONFLICT) {
+    HTM_RP_backoff(thr->retries);
+  }
+  thr->last = cause;
+
+  return 1;
+}
+
+// after the commit in HTM
+static inline void HTM_RP_commit()
+{
+  HTM_RP_thr_s *thr = &HTM_RP_thr;
+
+  if (thr->last != -1) {
+    HTM_RP_cause_s *prev = &(thr->block[thr->last]);
+    prev->fail -= prev->fail >> HTM_RP_SHIFT;
+    thr->last = -1;
+  }
+}
+
+#endif /* HTM_RETRY_POLICY_H_GUARD */
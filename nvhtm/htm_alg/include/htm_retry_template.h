@@ -3,6 +3,10 @@
 
 #include "arch.h"
 
+#ifdef HTM_SGL_ADAPTIVE
+#include "htm_retry_policy.h"
+#endif /* HTM_SGL_ADAPTIVE */
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -12,13 +16,37 @@ extern "C"
 #define HTM_SGL_INIT_BUDGET 20
 #endif /* HTM_SGL_INIT_BUDGET */
 
+/*
+ * HTM_SGL_SCM: software-assisted conflict management. A transaction that
+ * aborts on a conflict takes the auxiliary lock (HTM_SGL_aux_var) and
+ * retries in HTM. The HTM transactions do not subscribe to it, so the
+ * threads that conflict run one at a time while the others keep going.
+ * The other aborts retry without it. Only a transaction that spends its
+ * budget, or aborts on capacity (which retrying in HTM does not fix),
+ * takes the SGL.
+ *
+ * The aborts while the SGL is taken do not spend the budget, the thread
+ * waits for the release in CHECK_SGL_NOTX (no lemming effect).
+ *
+ * Limitation (SCM and ADAPTIVE): the HTM transactions subscribe to the SGL
+ * (CHECK_SGL_HTM aborts all of them while it is taken), so a block that
+ * does not fit in the HTM still runs alone each time it executes.
+ *
+ * HTM_SGL_ADAPTIVE: the budget of each atomic block follows the aborts of
+ * its past retries (htm_retry_policy.h): it stays HTM_SGL_INIT_BUDGET
+ * while the policy retries in HTM and drops to 0 when it falls back.
+ */
+
 typedef struct HTM_SGL_local_vars_ {
     int budget,
         tid,
-        status;
+        status,
+        is_aux, // holds HTM_SGL_aux_var
+        is_sgl; // holds HTM_SGL_var
 } __attribute__((packed))  HTM_SGL_local_vars_s;
 
 extern CL_ALIGN int HTM_SGL_var;
+extern CL_ALIGN int HTM_SGL_aux_var;
 extern __thread CL_ALIGN HTM_SGL_local_vars_s HTM_SGL_vars;
 
 #define START_TRANSACTION(status) (HTM_begin(status) != HTM_CODE_SUCCESS)
@@ -46,6 +74,23 @@ extern __thread CL_ALIGN HTM_SGL_local_vars_s HTM_SGL_vars;
 #define EXIT_SGL(tid)  HTM_exit_fallback()
 #define AFTER_ABORT(tid, budget, status)   /* empty */
 
+#ifdef HTM_SGL_SCM
+// after the abort, the retries of a conflict hold the auxiliary lock
+// (explicit aborts, as the one of CHECK_SGL_HTM, and the others do not)
+#define ENTER_AUX(tid, budget, status) \
+  if (!HTM_SGL_vars.is_aux && budget > 0 && !HTM_SGL_var \
+      && HTM_is_conflict(status)) { \
+    HTM_enter_aux(); \
+  }
+#define EXIT_AUX(tid) \
+  if (HTM_SGL_vars.is_aux) { \
+    HTM_exit_aux(); \
+  }
+#else
+#define ENTER_AUX(tid, budget, status) /* empty */
+#define EXIT_AUX(tid)                  /* empty */
+#endif /* HTM_SGL_SCM */
+
 #define BEFORE_HTM_BEGIN(tid, budget)  /* empty */
 #define AFTER_HTM_BEGIN(tid, budget)   /* empty */
 #define BEFORE_SGL_BEGIN(tid)          /* empty */
@@ -56,12 +101,41 @@ extern __thread CL_ALIGN HTM_SGL_local_vars_s HTM_SGL_vars;
 #define BEFORE_SGL_COMMIT(tid)         /* empty */
 #define AFTER_SGL_COMMIT(tid)          /* empty */
 
+#ifdef HTM_SGL_ADAPTIVE
+#define HTM_RETRY_CAUSE(status) \
+  (HTM_is_capacity(status) ? HTM_RP_CAPACITY : \
+  HTM_is_conflict(status) ? HTM_RP_CONFLICT : \
+  HTM_is_explicit(status) ? HTM_RP_EXPLICIT : HTM_RP_OTHER)
+// the static is unique to each expansion of HTM_SGL_begin
+#define BEGIN_RETRY_POLICY() \
+  HTM_RP_begin(({ static char HTM_RP_site; (void*) &HTM_RP_site; }))
+#define COMMIT_RETRY_POLICY() HTM_RP_commit()
+#else
+#define BEGIN_RETRY_POLICY()  /* empty */
+#define COMMIT_RETRY_POLICY() /* empty */
+#endif /* HTM_SGL_ADAPTIVE */
+
 #define BEFORE_CHECK_BUDGET(budget) /* empty */
 // called within HTM_update_budget
+#if defined(HTM_SGL_ADAPTIVE)
+#define HTM_UPDATE_BUDGET(budget, status) ({ \
+    int res = HTM_SGL_var ? budget /* the SGL aborted it */ \
+      : (HTM_RP_abort(HTM_RETRY_CAUSE(status), HTM_is_persistent(status)) \
+      ? budget : 0); \
+    res; \
+})
+#elif defined(HTM_SGL_SCM)
+#define HTM_UPDATE_BUDGET(budget, status) ({ \
+    int res = HTM_SGL_var ? budget /* the SGL aborted it */ \
+      : HTM_is_capacity(status) ? 0 : budget - 1; \
+    res; \
+})
+#else
 #define HTM_UPDATE_BUDGET(budget, status) ({ \
     int res = budget - 1; \
     res; \
 })
+#endif /* HTM_SGL_ADAPTIVE */
 
 #define ENTER_HTM_COND(tid, budget) budget > 0
 #define IN_TRANSACTION(tid, budget, status) \
@@ -81,9 +155,13 @@ extern __thread CL_ALIGN HTM_SGL_local_vars_s HTM_SGL_vars;
 #define HTM_SGL_tid    HTM_SGL_vars.tid
 #define HTM_SGL_env    HTM_SGL_vars.env
 
+// inside HTM_SGL_begin/HTM_SGL_commit, in HTM or holding the SGL
+#define HTM_SGL_in_tx() (HTM_test() || HTM_SGL_vars.is_sgl)
+
 #define HTM_SGL_begin() \
 { \
     HTM_SGL_budget = HTM_SGL_INIT_BUDGET; /*HTM_get_budget();*/ \
+    BEGIN_RETRY_POLICY(); \
     BEFORE_TRANSACTION(HTM_SGL_tid, HTM_SGL_budget); \
     while (1) { /*setjmp(HTM_SGL_env);*/ \
         BEFORE_CHECK_BUDGET(HTM_SGL_budget); \
@@ -93,6 +171,7 @@ extern __thread CL_ALIGN HTM_SGL_local_vars_s HTM_SGL_vars;
             if (START_TRANSACTION(HTM_SGL_status)) { \
                 UPDATE_BUDGET(HTM_SGL_tid, HTM_SGL_budget, HTM_SGL_status); \
                 AFTER_ABORT(HTM_SGL_tid, HTM_SGL_budget, HTM_SGL_status); \
+                ENTER_AUX(HTM_SGL_tid, HTM_SGL_budget, HTM_SGL_status); \
                 continue; /*longjmp(HTM_SGL_env, 1);*/ \
             } \
             CHECK_SGL_HTM(); \
@@ -114,6 +193,7 @@ extern __thread CL_ALIGN HTM_SGL_local_vars_s HTM_SGL_vars;
     if (IN_TRANSACTION(HTM_SGL_tid, HTM_SGL_budget, HTM_SGL_status)) { \
         BEFORE_HTM_COMMIT(HTM_SGL_tid, HTM_SGL_budget); \
         COMMIT_TRANSACTION(HTM_SGL_tid, HTM_SGL_budget, HTM_SGL_status); \
+        COMMIT_RETRY_POLICY(); \
         AFTER_HTM_COMMIT(HTM_SGL_tid, HTM_SGL_budget); \
     } \
     else { \
@@ -121,6 +201,7 @@ extern __thread CL_ALIGN HTM_SGL_local_vars_s HTM_SGL_vars;
         EXIT_SGL(HTM_SGL_tid); \
         AFTER_SGL_COMMIT(HTM_SGL_tid); \
     } \
+    EXIT_AUX(HTM_SGL_tid); \
     AFTER_TRANSACTION(HTM_SGL_tid, HTM_SGL_budget); \
 } \
 
@@ -180,6 +261,8 @@ void HTM_block();
 #define HTM_update_budget(budget, status) HTM_UPDATE_BUDGET(budget, status)
 void HTM_enter_fallback();
 void HTM_exit_fallback();
+void HTM_enter_aux();
+void HTM_exit_aux();
 
 void HTM_inc_status_count(int status_code);
 int HTM_get_nb_threads();
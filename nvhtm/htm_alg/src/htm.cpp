@@ -14,6 +14,7 @@ __sync_synchronize()
 using namespace std;
 
 CL_ALIGN int HTM_SGL_var;
+CL_ALIGN int HTM_SGL_aux_var;
 __thread CL_ALIGN HTM_SGL_local_vars_s HTM_SGL_vars;
 
 static mutex mtx;
@@ -30,6 +31,7 @@ void HTM_init_(int init_budget, int nb_threads)
   init_budget = HTM_SGL_INIT_BUDGET;
   threads = nb_threads;
   HTM_SGL_var = 0;
+  HTM_SGL_aux_var = 0;
   HTM_INIT();
 }
 
@@ -64,20 +66,39 @@ void HTM_enter_fallback()
   while (!__sync_bool_compare_and_swap(&HTM_SGL_var, 0, 1)) {
     PAUSE();
   }
+  htm_quiesce();
 
   // HTM_SGL_var = 1;
   // __sync_synchronize();
+  HTM_SGL_vars.is_sgl = 1;
   errors[HTM_FALLBACK]++;
 }
 
 void HTM_exit_fallback()
 {
   // __sync_val_compare_and_swap(&HTM_SGL_var, 1, 0);
+  HTM_SGL_vars.is_sgl = 0;
   HTM_SGL_var = 0;
   __sync_synchronize();
   // mtx.unlock();
 }
 
+// not subscribed by the HTM transactions, only orders the conflicting ones
+void HTM_enter_aux()
+{
+  while (!__sync_bool_compare_and_swap(&HTM_SGL_aux_var, 0, 1)) {
+    PAUSE();
+  }
+  HTM_SGL_vars.is_aux = 1;
+}
+
+void HTM_exit_aux()
+{
+  HTM_SGL_vars.is_aux = 0;
+  HTM_SGL_aux_var = 0;
+  __sync_synchronize();
+}
+
 void HTM_block()
 {
   while(HTM_SGL_var == 1) {
@@ -75,10 +75,51 @@ extern "C"
   #define clflush(p) ({ \
     asm volatile ( "clflush (%0)" :: "r"((p)) ); \
   })
+
+  // weakly ordered, need a fence (MN_drain) before the writes are durable
+  #define clflushopt(p) ({ \
+    asm volatile ( "clflushopt (%0)" :: "r"((p)) : "memory" ); \
+  })
+
+  // does not evict the line
+  #define clwb(p) ({ \
+    asm volatile ( "clwb (%0)" :: "r"((p)) : "memory" ); \
+  })
+
+  // best write-back the CPU has (cpuid), set when the library loads
+  enum { MN_CLFLUSH = 0, MN_CLFLUSHOPT, MN_CLWB };
+  extern int MN_flush_insn;
+
+  // the one the compiler targets (e.g., -march=native), else MN_flush_insn
+  #if defined(__CLWB__)
+  #define MN_FLUSH_LINE(p) clwb(p)
+  #elif defined(__CLFLUSHOPT__)
+  #define MN_FLUSH_LINE(p) clflushopt(p)
+  #else
+  #define MN_FLUSH_LINE(p) ({ \
+    if (MN_flush_insn == MN_CLWB) clwb(p); \
+    else if (MN_flush_insn == MN_CLFLUSHOPT) clflushopt(p); \
+    else clflush(p); \
+  })
   #endif
+  #endif
+
+  // with MN_USE_MMAP the pools are files mapped with MAP_SHARED, each file
+  // starts with this header (one page, the pool is page aligned)
+  typedef struct MN_pool_header_ {
+    unsigned long long magic;
+    void *base;        // address of the mapping when the file was created
+    size_t size;       // usable size (after the header)
+    size_t mapped_len; // header included
+    int is_reattached; // set on each MN_alloc (1 if the file was reused)
+  } MN_pool_header_s;
 
   void *MN_alloc(const char *file_name, size_t);
   void MN_free(void*);
+  // 1 if MN_alloc mapped an existing pool (the content is preserved)
+  int MN_is_reattached(void*);
+  // 1 if the address is in a pool, mapped now, that MN_alloc reattached
+  int MN_in_reattached_pool(void*);
 
   void MN_thr_enter(void);
   void MN_thr_exit(void);
@@ -89,7 +130,9 @@ extern "C"
 
   int MN_write(void *addr, void *buf, size_t size, int to_aux);
 
-  void MN_flush(void *addr, size_t size, int);
+  // do_flush == 0 only spins (emulated latency), else writes back the lines
+  // in [addr, addr+size) with MN_FLUSH_LINE, MN_drain orders them
+  void MN_flush(void *addr, size_t size, int do_flush);
   void MN_drain(void);
   void MN_learn_nb_nops(void);
 
@@ -2,6 +2,48 @@
 #include <string.h>
 #include <mutex>
 
+#if !defined(__powerpc__)
+#include <cpuid.h>
+#endif
+
+#ifdef MN_USE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// prefix of the pool files, e.g., a DAX mount point or /dev/shm/
+#ifndef MN_POOL_DIR
+#define MN_POOL_DIR ""
+#endif
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+#ifdef MN_MMAP_HUGE
+#define MN_PAGE_SIZE (2*1024*1024)
+#else
+#define MN_PAGE_SIZE 4096
+#endif
+
+#define MN_POOL_MAGIC  0x4d4e504f4f4c0001ULL
+#define MN_HEADER_SIZE MN_PAGE_SIZE
+#define MN_ROUND_PAGE(size) \
+  (((size) + MN_PAGE_SIZE - 1) / MN_PAGE_SIZE * MN_PAGE_SIZE)
+#define MN_HEADER_OF(ptr) \
+  ((MN_pool_header_s*) ((char*) (ptr) - MN_HEADER_SIZE))
+
+#ifndef MN_MAX_POOLS
+#define MN_MAX_POOLS 64
+#endif
+
+static void *map_pool(const char *file_name, size_t size);
+
+// the pools mapped now, for MN_in_reattached_pool
+static MN_pool_header_s *pools[MN_MAX_POOLS];
+#endif /* MN_USE_MMAP */
+
 #ifndef ALLOC_FN
 #define ALLOC_FN(ptr, type, size) \
 ptr = (type*) malloc(size * sizeof(type))
@@ -32,6 +74,27 @@ __thread CL_ALIGN NH_spin_info_s MN_info;
 
 static std::mutex mtx;
 
+#if !defined(__powerpc__)
+// CPUID.(EAX=7,ECX=0):EBX, bit 24 CLWB, bit 23 CLFLUSHOPT
+static int flush_insn_of_cpu()
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+		return MN_CLFLUSH;
+	}
+	if (ebx & (1u << 24)) {
+		return MN_CLWB;
+	}
+	if (ebx & (1u << 23)) {
+		return MN_CLFLUSHOPT;
+	}
+	return MN_CLFLUSH;
+}
+
+int MN_flush_insn = flush_insn_of_cpu();
+#endif
+
 int SPIN_PER_WRITE(int nb_writes)
 {
 	ts_s _ts1_ = rdtscp();
@@ -64,21 +127,71 @@ int MN_write(void *addr, void *buf, size_t size, int to_aux)
 
 void *MN_alloc(const char *file_name, size_t size)
 {
-	// TODO: do with mmap
-	char *res;
-	size_t missing = size % CACHE_LINE_SIZE;
-
-	ALLOC_FN(res, char, size + missing);
+#ifdef MN_USE_MMAP
+	return map_pool(file_name, size);
+#else /* !MN_USE_MMAP */
+	void *res;
+	size_t missing = (CACHE_LINE_SIZE - size % CACHE_LINE_SIZE) % CACHE_LINE_SIZE;
+
+	// cache line aligned, the pool and the checkpoint have the same offsets
+	// within the lines
+	if (posix_memalign(&res, CACHE_LINE_SIZE, size + missing) != 0) {
+		res = NULL;
+	}
 	//    res = aligned_alloc(CACHE_LINE_SIZE, size + missing);
 	//    res = malloc(size);
 
-	return (void*) res;
+	return res;
+#endif /* MN_USE_MMAP */
 }
 
 void MN_free(void *ptr)
 {
-	// TODO: do with mmap
+#ifdef MN_USE_MMAP
+	// the file is kept, the next MN_alloc reattaches it
+	MN_pool_header_s *header = MN_HEADER_OF(ptr);
+	int i;
+
+	mtx.lock();
+	for (i = 0; i < MN_MAX_POOLS; ++i) {
+		if (pools[i] == header) pools[i] = NULL;
+	}
+	mtx.unlock();
+	munmap(header, header->mapped_len);
+#else /* !MN_USE_MMAP */
 	free(ptr);
+#endif /* MN_USE_MMAP */
+}
+
+int MN_is_reattached(void *ptr)
+{
+#ifdef MN_USE_MMAP
+	return MN_HEADER_OF(ptr)->is_reattached;
+#else /* !MN_USE_MMAP */
+	return 0;
+#endif /* MN_USE_MMAP */
+}
+
+int MN_in_reattached_pool(void *ptr)
+{
+#ifdef MN_USE_MMAP
+	char *addr = (char*) ptr;
+	int i, res = 0;
+
+	mtx.lock();
+	for (i = 0; i < MN_MAX_POOLS && !res; ++i) {
+		MN_pool_header_s *header = pools[i];
+
+		res = header != NULL && header->is_reattached
+			&& addr >= (char*) header + MN_HEADER_SIZE
+			&& addr < (char*) header + header->mapped_len;
+	}
+	mtx.unlock();
+
+	return res;
+#else /* !MN_USE_MMAP */
+	return 0;
+#endif /* MN_USE_MMAP */
 }
 
 void MN_thr_enter()
@@ -100,21 +213,14 @@ void MN_thr_exit()
 
 void MN_flush(void *addr, size_t size, int do_flush)
 {
-	int i;
-	int size_cl = CACHE_LINE_SIZE / sizeof (char);
-	int new_size = size / size_cl;
-
-	// TODO: not cache_align flush
-
-	if (size < size_cl) {
-		new_size = 1;
-	}
+	// every line touched by [addr, addr+size), addr may not be aligned
+	uintptr_t line = (uintptr_t) addr & ~((uintptr_t) CACHE_LINE_SIZE - 1);
+	uintptr_t end = (uintptr_t) addr + (size > 0 ? size : 1);
 
-	for (i = 0; i < new_size; i += size_cl) {
-		// TODO: addr may not be aligned
+	for (; line < end; line += CACHE_LINE_SIZE) {
 		if (do_flush) {
 			ts_s _ts1_ = rdtscp();
-			clflush(((char*) addr) + i); // does not need fence
+			MN_FLUSH_LINE((char*) line);
 			MN_count_spins++;
 			MN_time_spins += rdtscp() - _ts1_;
 		} else
@@ -164,3 +270,75 @@ void MN_learn_nb_nops() {
 		fclose(fp);
 	}
 }
+
+#ifdef MN_USE_MMAP
+static void *map_pool(const char *file_name, size_t size)
+{
+	char path[512];
+	MN_pool_header_s header;
+	size_t mapped_len = MN_ROUND_PAGE(size + MN_HEADER_SIZE);
+	int flags = MAP_SHARED;
+	int is_reattached = 0;
+	void *hint = NULL;
+	char *res;
+	int fd, i;
+
+	sprintf(path, MN_POOL_DIR "%s", file_name);
+	fd = open(path, O_RDWR | O_CREAT, 0666);
+	if (fd < 0) {
+		perror("open");
+		exit(EXIT_FAILURE);
+	}
+
+	if (pread(fd, &header, sizeof (header), 0) == sizeof (header)
+		&& header.magic == MN_POOL_MAGIC && header.size >= size) {
+		// same address as before, the pointers in the pool are still valid
+		hint = header.base;
+		mapped_len = header.mapped_len;
+		flags |= MAP_FIXED_NOREPLACE;
+		is_reattached = 1;
+	} else if (ftruncate(fd, mapped_len) != 0) {
+		perror("ftruncate");
+		exit(EXIT_FAILURE);
+	}
+
+#ifdef MN_MMAP_POPULATE
+	flags |= MAP_POPULATE;
+#endif
+
+	res = (char*) mmap(hint, mapped_len, PROT_READ | PROT_WRITE, flags, fd, 0);
+	if (is_reattached && (res == MAP_FAILED || res != hint)) {
+		// address taken (or kernel without MAP_FIXED_NOREPLACE)
+		fprintf(stderr, "MN_alloc: cannot reattach %s at %p\n", path, hint);
+		if (res != MAP_FAILED) munmap(res, mapped_len);
+		flags &= ~MAP_FIXED_NOREPLACE;
+		res = (char*) mmap(NULL, mapped_len, PROT_READ | PROT_WRITE, flags, fd, 0);
+	}
+	close(fd);
+
+	if (res == MAP_FAILED) {
+		perror("mmap");
+		exit(EXIT_FAILURE);
+	}
+
+#ifdef MN_MMAP_HUGE
+	madvise(res, mapped_len, MADV_HUGEPAGE);
+#endif
+
+	header.magic = MN_POOL_MAGIC;
+	header.base = res;
+	header.size = mapped_len - MN_HEADER_SIZE;
+	header.mapped_len = mapped_len;
+	header.is_reattached = is_reattached && res == hint;
+	memcpy(res, &header, sizeof (header));
+	MN_flush(res, sizeof (header), 1);
+	MN_drain();
+
+	mtx.lock();
+	for (i = 0; i < MN_MAX_POOLS && pools[i] != NULL; ++i);
+	if (i < MN_MAX_POOLS) pools[i] = (MN_pool_header_s*) res;
+	mtx.unlock();
+
+	return res + MN_HEADER_SIZE;
+}
+#endif /* MN_USE_MMAP */
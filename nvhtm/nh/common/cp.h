@@ -8,20 +8,40 @@ extern "C"
 {
 #endif /* __cplusplus */
 
+/**
+ * Bounded lock-free queue of fixed size items, any number of producers and
+ * consumers (each slot has a sequence number, the producers and the
+ * consumers only contend on their own counter).
+ */
 typedef struct cp_ cp_s;
 
+/**
+ * The capacity is nb_item rounded up to a power of 2.
+ */
 cp_s* cp_init(size_t nb_item, size_t item_size);
 
+void cp_destroy(cp_s*);
+
 /**
- * Writes the item in the buffer.
+ * Writes the item in the buffer, returns 0 if it is full.
  */
 int cp_produce(cp_s*, void* item);
 
 /**
- * Writes in item from the buffer.
+ * Writes in item from the buffer, returns 0 if it is empty.
  */
 int cp_consume(cp_s*, void* item);
 
+/**
+ * Writes up to nb_items consecutive items, returns the number written.
+ */
+int cp_produce_batch(cp_s*, void* items, int nb_items);
+
+/**
+ * Writes up to nb_items in items, returns the number read.
+ */
+int cp_consume_batch(cp_s*, void* items, int nb_items);
+
 int cp_count_items(cp_s*);
 
 #ifdef __cplusplus
@@ -29,4 +49,3 @@ int cp_count_items(cp_s*);
 #endif /* __cplusplus */
 
 #endif /* CP_H_GUARD */
-
@@ -60,6 +60,7 @@ extern "C"
   #define NH_write(addr, val) ({ \
     GRANULE_TYPE buf = val; \
     NH_before_write(addr, val); \
+    htm_write(addr); \
     MN_write(addr, &(buf), sizeof(GRANULE_TYPE), 0); /* *((GRANULE_TYPE*)addr) = val; */ \
     NH_after_write(addr, val); \
     val; \
@@ -84,6 +85,7 @@ extern "C"
 
   #define NH_read(addr) ({ \
     NH_before_read(addr); \
+    htm_read(addr); \
     (__typeof__(*addr))*(addr); \
   })
 
@@ -45,6 +45,11 @@
 #endif /* MAX_NB_THREADS */
 
 #define CODE_LOG_ABORT 1
+#define CODE_ST_ABORT  2 // first write to a page (SOFTWARE_TRANSLATION)
+
+// explicit abort with the code (HTM_is_named is any explicit abort in TSX)
+#define NH_is_abort_code(status, code) \
+  (HTM_is_explicit(status) && HTM_get_named(status) == (code))
 
 // #################################
 // ### PHTM ########################
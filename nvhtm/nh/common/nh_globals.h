@@ -21,6 +21,8 @@ extern CL_ALIGN long global_flushed_ts;
 extern CL_ALIGN int TM_nb_threads;
 extern volatile int *NH_checkpointer_state;
 extern sem_t *NH_chkp_sem;
+// the SW commits of phTM are in the logs, switching to SW does not drain
+extern volatile int NH_sw_in_log;
 //extern CL_ALIGN int MAX_PHYS_THRS;
 //extern CL_ALIGN long long CPU_MAX_FREQ;
 //extern CL_ALIGN int SPINS_PER_100NS;
@@ -24,6 +24,7 @@ extern "C"
     void NVHTM_shutdown();
     void NVHTM_reduce_logs();
     void NVHTM_recover();
+    void NVHTM_set_checkpointer_threads(int nb_threads);
     void NVHTM_thr_init();
     void NVHTM_thr_exit();
     void NVHTM_abort_tx();
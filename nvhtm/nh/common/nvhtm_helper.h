@@ -55,6 +55,7 @@ extern "C"
         NVCheckpoint_s chkp;
         ts_s ts, chkp_counter;
         void *ptr, *last_alloc;
+        void *heap; // volatile state of NVMHTM_malloc (pool_alloc.h)
         size_t size;
         char file_name[256]; // TODO: check the size
         int flags;
@@ -68,6 +69,7 @@ extern "C"
      */
     void* NVMHTM_alloc(const char* file_name, size_t, int vol_pool);
     void* NVMHTM_malloc(void *pool, size_t size); // allocs in a pool
+    void NVMHTM_pfree(void *pool, void *ptr); // frees in a pool
     void NVMHTM_free(void *ptr);
     void NVMHTM_apply_allocs(); // call this after TX ends
     NVMHTM_mem_s* NVMHTM_get_instance(void *pool);
@@ -83,12 +85,22 @@ extern "C"
     void NVMHTM_write_ts(int tid, ts_s ts);
     int NVMHTM_has_writes(int tid);
     void NVMHTM_commit(int tid, ts_s ts, int nb_writes);
+
+    // commit of a software transaction (phTM), call begin while holding the
+    // STM commit lock: the writes go to the log of the calling thread, the
+    // commit may be after the release (RH-NOrec)
+    void NVMHTM_sw_begin();
+    void NVMHTM_sw_write(void *addr, void *val);
+    void NVMHTM_sw_commit();
+    void NVMHTM_sw_abort();
     void NVMHTM_copy_to_checkpoint(void*);
     void NVMHTM_free(void*);
     void NVMHTM_shutdown();
 	void NVMHTM_thr_exit();
 
 	void NVMHTM_reduce_logs();
+	void NVMHTM_recover(); // replays the logs into the checkpoint
+	void NVMHTM_set_checkpointer_threads(int nb_threads);
 
     // simulates a crash (SIGKILL)
     void NVMHTM_crash();
@@ -59,8 +59,10 @@ extern "C"
 
 #ifdef USE_MIN_NVM
 
+// maps the file if minimal_nvm is built with USE_MMAP, else mallocs
 #define ALLOC_MEM(file, size)  MN_alloc(file, size)
 #define FREE_MEM(ptr, size)    MN_free(ptr)
+#define ALLOC_IS_REATTACHED(ptr) MN_is_reattached(ptr)
 
 // in order to simulate PHTM as well
 //#ifdef DISABLE_FLUSH
@@ -89,6 +91,7 @@ extern "C"
 #endif /* USE_VOL */
 
 #define FREE_MEM(ptr, size)    pmem_unmap(ptr, size)
+#define ALLOC_IS_REATTACHED(ptr) 0
 
 #ifdef DISABLE_FLUSH
 #define NVM_PERSIST(ptr, size) SPIN_PER_WRITE(MAX(size / CACHE_LINE_SIZE, 1))
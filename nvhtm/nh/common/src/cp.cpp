@@ -4,79 +4,187 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
+
+/*
+ * Bounded MPMC queue (D. Vyukov). The slot of position pos is free for
+ * the producer of pos when its seq is pos, and holds the item for the
+ * consumer of pos when its seq is pos + 1. The consumer then sets it to
+ * pos + nb_items (free for the next round).
+ */
+
+#define SLOT(cp, pos) \
+((cp_slot_s*) &((cp)->buffer[((pos) & (cp)->mask) * (cp)->slot_size]))
+
+#define LOAD_ACQ(ptr)       __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define LOAD_RLX(ptr)       __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define STORE_REL(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+#define CAS_RLX(ptr, old, new) \
+__atomic_compare_exchange_n(ptr, old, new, 1, __ATOMIC_RELAXED, \
+	__ATOMIC_RELAXED)
+
+typedef struct cp_slot_ {
+	uint64_t seq;
+	char item[];
+} cp_slot_s;
 
-#define BUFFER_ADDR(ptr) \
-((void*) &(((char*) buffer)[ptr * item_size]) )
-
-#define IS_EMPTY (c_ptr == p_ptr)
-#define IS_FULL (ptr_mod(c_ptr, -p_ptr, nb_items) == 1)
-
-#define CPY_AND_INC(type, dst, src) ({ \
-	type block = *((type*) src); \
-	type *src2 = (type*)src, *dst2 = (type*)dst;\
-	*dst2 = block; \
-	src = (void*) ++src2; \
-	dst = (void*) ++dst2; \
-})
-
-#define CPY_PTR(dst, src) memcpy(dst, src, item_size)
-
-// TODO: allow more than one buffer
 struct cp_ {
-	int dummy;
+	// read-only after cp_init
+	char *buffer;
+	size_t item_size;
+	size_t slot_size;
+	uint64_t nb_items;
+	uint64_t mask;
+
+	CL_ALIGN uint64_t p_ptr; // next position to produce
+	CL_ALIGN uint64_t c_ptr; // next position to consume
 };
 
-static void* buffer;
-static int c_ptr;
-static int p_ptr;
-static size_t nb_items;
-static size_t item_size;
+// waits the slot of pos to reach seq (a claimed slot is done quickly)
+static void wait_slot(cp_slot_s *slot, uint64_t seq);
 
 cp_s* cp_init(size_t nb_items_, size_t item_size_)
 {
-	nb_items = nb_items_;
-	item_size = item_size_;
-	buffer = malloc(nb_items * item_size);
-	return NULL;
+	cp_s *cp;
+	uint64_t i, nb_items = 2;
+
+	while (nb_items < nb_items_) nb_items <<= 1;
+
+	if (posix_memalign((void**) &cp, CACHE_LINE_SIZE, sizeof (cp_s)) != 0) {
+		perror("posix_memalign");
+		exit(EXIT_FAILURE);
+	}
+
+	cp->item_size = item_size_;
+	cp->slot_size = (sizeof (cp_slot_s) + item_size_ + 7) & ~((size_t) 7);
+	cp->nb_items = nb_items;
+	cp->mask = nb_items - 1;
+	cp->p_ptr = 0;
+	cp->c_ptr = 0;
+
+	if (posix_memalign((void**) &cp->buffer, CACHE_LINE_SIZE,
+			nb_items * cp->slot_size) != 0) {
+		perror("posix_memalign");
+		exit(EXIT_FAILURE);
+	}
+
+	for (i = 0; i < nb_items; ++i) {
+		SLOT(cp, i)->seq = i;
+	}
+
+	return cp;
 }
 
-int cp_produce(cp_s*, void* i)
+void cp_destroy(cp_s *cp)
 {
-	void* item;
-	void* place;
+	free(cp->buffer);
+	free(cp);
+}
 
-	if (IS_FULL) return 0;
+int cp_produce(cp_s *cp, void *item)
+{
+	uint64_t pos = LOAD_RLX(&cp->p_ptr);
+	cp_slot_s *slot;
 
-	item = i;
-	place = BUFFER_ADDR(p_ptr);
+	while (1) {
+		slot = SLOT(cp, pos);
+		int64_t diff = (int64_t) (LOAD_ACQ(&slot->seq) - pos);
 
-	CPY_PTR(place, item);
+		if (diff == 0) {
+			if (CAS_RLX(&cp->p_ptr, &pos, pos + 1)) break;
+		} else if (diff < 0) {
+			return 0; // full
+		} else {
+			pos = LOAD_RLX(&cp->p_ptr);
+		}
+	}
 
-	p_ptr = p_ptr < nb_items ? p_ptr+1 : 0;
-	__sync_synchronize(); // TODO: need this?
+	memcpy(slot->item, item, cp->item_size);
+	STORE_REL(&slot->seq, pos + 1);
 
 	return 1;
 }
 
-int cp_consume(cp_s*, void* i)
+int cp_consume(cp_s *cp, void *item)
 {
-	void* item;
-	void* place;
+	uint64_t pos = LOAD_RLX(&cp->c_ptr);
+	cp_slot_s *slot;
 
-	if (IS_EMPTY) return 0;
+	while (1) {
+		slot = SLOT(cp, pos);
+		int64_t diff = (int64_t) (LOAD_ACQ(&slot->seq) - (pos + 1));
 
-	item = i;
-	place = BUFFER_ADDR(c_ptr);
+		if (diff == 0) {
+			if (CAS_RLX(&cp->c_ptr, &pos, pos + 1)) break;
+		} else if (diff < 0) {
+			return 0; // empty
+		} else {
+			pos = LOAD_RLX(&cp->c_ptr);
+		}
+	}
 
-	CPY_PTR(item, place);
-
-	c_ptr = ptr_mod(c_ptr, 1, nb_items);
-	__sync_synchronize(); // TODO: need this?
+	memcpy(item, slot->item, cp->item_size);
+	STORE_REL(&slot->seq, pos + cp->nb_items);
 
 	return 1;
 }
 
-int cp_count_items(cp_s*)
+int cp_produce_batch(cp_s *cp, void *items, int nb_items)
+{
+	uint64_t pos = LOAD_RLX(&cp->p_ptr), i, nb;
+	char *src = (char*) items;
+
+	// claims the positions the consumers already passed
+	do {
+		int64_t used = (int64_t) (pos - LOAD_ACQ(&cp->c_ptr));
+		uint64_t free_items = used < 0 ? cp->nb_items
+			: (uint64_t) used < cp->nb_items ? cp->nb_items - used : 0;
+		nb = free_items < (uint64_t) nb_items ? free_items : nb_items;
+		if (nb == 0) return 0;
+	} while (!CAS_RLX(&cp->p_ptr, &pos, pos + nb));
+
+	for (i = 0; i < nb; ++i) {
+		cp_slot_s *slot = SLOT(cp, pos + i);
+		wait_slot(slot, pos + i);
+		memcpy(slot->item, src + i * cp->item_size, cp->item_size);
+		STORE_REL(&slot->seq, pos + i + 1);
+	}
+
+	return nb;
+}
+
+int cp_consume_batch(cp_s *cp, void *items, int nb_items)
+{
+	uint64_t pos = LOAD_RLX(&cp->c_ptr), i, nb;
+	char *dst = (char*) items;
+
+	// claims the positions the producers already passed
+	do {
+		int64_t avail = (int64_t) (LOAD_ACQ(&cp->p_ptr) - pos);
+		if (avail < 0) avail = 0;
+		nb = (uint64_t) avail < (uint64_t) nb_items ? avail : nb_items;
+		if (nb == 0) return 0;
+	} while (!CAS_RLX(&cp->c_ptr, &pos, pos + nb));
+
+	for (i = 0; i < nb; ++i) {
+		cp_slot_s *slot = SLOT(cp, pos + i);
+		wait_slot(slot, pos + i + 1);
+		memcpy(dst + i * cp->item_size, slot->item, cp->item_size);
+		STORE_REL(&slot->seq, pos + i + cp->nb_items);
+	}
+
+	return nb;
+}
+
+int cp_count_items(cp_s *cp)
+{
+	int64_t count = (int64_t) (LOAD_ACQ(&cp->p_ptr) - LOAD_ACQ(&cp->c_ptr));
+	return count < 0 ? 0 : (int) count;
+}
+
+static void wait_slot(cp_slot_s *slot, uint64_t seq)
 {
-	return ptr_mod(p_ptr, -c_ptr, nb_items);
+	while (LOAD_ACQ(&slot->seq) != seq) {
+		PAUSE();
+	}
 }
@@ -323,6 +323,16 @@ void NVHTM_reduce_logs()
 	NVMHTM_reduce_logs();
 }
 
+void NVHTM_recover()
+{
+	NVMHTM_recover();
+}
+
+void NVHTM_set_checkpointer_threads(int nb_threads)
+{
+	NVMHTM_set_checkpointer_threads(nb_threads);
+}
+
 // ################ implementation local functions
 
 // TODO: remove or move to arch_dep
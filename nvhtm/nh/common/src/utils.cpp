@@ -11,9 +11,16 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <sched.h>
+#include <sys/syscall.h>
 
 #include <pthread.h>
 
+// from numaif.h (libnuma is not needed)
+#define TOPO_MPOL_PREFERRED 1
+#define TOPO_MPOL_MF_MOVE   (1 << 1)
+#define TOPO_MAX_NODES      64
+
 // #define BUFFER_SIZE 1024
 
 FILE *DBG_LOG_log_fp; // extern
@@ -130,3 +137,88 @@ void set_affinity_at(int core) {
 
     sched_setaffinity(0, sizeof (cpu_set_t), &cpuset);
 }
+
+// ################ NUMA topology
+
+static int topo_nb_nodes;
+static int topo_cpu_node[CPU_SETSIZE];
+static int topo_nb_cpus[TOPO_MAX_NODES];
+static int *topo_node_cpus[TOPO_MAX_NODES]; // ascending
+
+static void topo_add_cpu(int node, int cpu) {
+    if (cpu >= CPU_SETSIZE) return;
+    topo_cpu_node[cpu] = node;
+    topo_node_cpus[node] = (int*) realloc(topo_node_cpus[node],
+            (topo_nb_cpus[node] + 1) * sizeof (int));
+    topo_node_cpus[node][topo_nb_cpus[node]++] = cpu;
+}
+
+// parses the cpulist of each node, e.g., "0-13,28-41"
+static void topo_init() {
+    char path[128];
+    int node, cpu, last;
+
+    if (topo_nb_nodes > 0) return;
+
+    for (node = 0; node < TOPO_MAX_NODES; ++node) {
+        FILE *fp;
+        sprintf(path, "/sys/devices/system/node/node%i/cpulist", node);
+        fp = fopen(path, "r");
+        if (fp == NULL) break;
+        while (fscanf(fp, "%i", &cpu) == 1) {
+            last = cpu;
+            if (fgetc(fp) == '-') {
+                if (fscanf(fp, "%i", &last) != 1) break;
+                fgetc(fp); // ',' or '\n'
+            }
+            for (; cpu <= last; ++cpu) topo_add_cpu(node, cpu);
+        }
+        fclose(fp);
+        if (topo_nb_cpus[node] == 0) break;
+    }
+    topo_nb_nodes = node;
+
+    if (topo_nb_nodes == 0) {
+        for (cpu = 0; cpu < MAX_PHYS_THRS; ++cpu) topo_add_cpu(0, cpu);
+        topo_nb_nodes = 1;
+    }
+}
+
+int TOPO_nb_nodes() {
+    topo_init();
+    return topo_nb_nodes;
+}
+
+int TOPO_node_of_cpu(int cpu) {
+    topo_init();
+    return cpu >= 0 && cpu < CPU_SETSIZE ? topo_cpu_node[cpu] : 0;
+}
+
+int TOPO_current_node() {
+    return TOPO_node_of_cpu(sched_getcpu());
+}
+
+int TOPO_node_cpu_from_last(int node, int i) {
+    int nb_cpus;
+
+    topo_init();
+    node %= topo_nb_nodes;
+    nb_cpus = topo_nb_cpus[node];
+    return topo_node_cpus[node][nb_cpus - 1 - i % nb_cpus];
+}
+
+void TOPO_bind_to_node(void *addr, size_t size, int node) {
+    unsigned long mask = 1UL << node;
+    uintptr_t page = sysconf(_SC_PAGESIZE);
+    // only the whole pages, the others may be shared with other threads
+    uintptr_t begin = ((uintptr_t) addr + page - 1) & ~(page - 1);
+    uintptr_t end = ((uintptr_t) addr + size) & ~(page - 1);
+
+    if (TOPO_nb_nodes() < 2 || end <= begin) return;
+
+    // best effort, the pages stay where they are on error
+    if (syscall(SYS_mbind, begin, end - begin, TOPO_MPOL_PREFERRED, &mask,
+            TOPO_MAX_NODES + 1, TOPO_MPOL_MF_MOVE) != 0) {
+        perror("mbind");
+    }
+}
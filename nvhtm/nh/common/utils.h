@@ -79,6 +79,15 @@ int run_command(char *command, char *buffer_stdout, size_t size_buf);
 void launch_thread_at(int core, void*(*callback)(void*));
 void set_affinity_at(int core);
 
+// NUMA topology from sysfs (one node with all the CPUs if not available)
+int TOPO_nb_nodes();
+int TOPO_node_of_cpu(int cpu);
+int TOPO_current_node();
+// i-th CPU of the node counting from its last one (wraps around)
+int TOPO_node_cpu_from_last(int node, int i);
+// prefers the node for the pages in [addr, addr + size), moving the touched
+void TOPO_bind_to_node(void *addr, size_t size, int node);
+
 #ifdef __cplusplus
 }
 #endif
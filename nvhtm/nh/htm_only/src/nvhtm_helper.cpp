@@ -126,6 +126,8 @@ void* NVMHTM_malloc(void *pool, size_t size)
     return NULL; // TODO: PHTM
 }
 
+void NVMHTM_pfree(void *pool, void *ptr) { /* empty */ }
+
 void NVMHTM_reduce_logs() { /* empty */ }
 
 void NVMHTM_apply_allocs() { /* empty */ }
@@ -224,6 +226,8 @@ void NVMHTM_recover()
 	// TODO:
 }
 
+void NVMHTM_set_checkpointer_threads(int nb_threads) { /* empty */ }
+
 void NVMHTM_validate(int id, bitset<MAX_NB_THREADS>&)
 {
 }
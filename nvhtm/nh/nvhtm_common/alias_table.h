@@ -0,0 +1,131 @@
+#ifndef ALIAS_TABLE_H_GUARD
+#define ALIAS_TABLE_H_GUARD
+
+#include "arch.h"
+#include "nh_defines.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+  #endif
+
+  /**
+  * Software translation of the PC solution (SOFTWARE_TRANSLATION).
+  *
+  * The transactions do not write the persistent image. The first write to
+  * a page copies it to a volatile shadow page, then the reads and writes of
+  * that page go to the shadow. The log keeps the persistent addresses, the
+  * checkpointer does not need to fork for a copy-on-write image
+  * (DO_CHECKPOINT=1). It does not write the pool either: CHKP_WRITE goes to
+  * the aux buffer, or to the checkpoint pool with REAL_CHECKPOINT. So the
+  * pool pages at instance->ptr keep the data before the first write of the
+  * run, the shadow is the only current copy: the readers outside the
+  * transactions (e.g., the STAMP verification) use NH_translate. A page
+  * without shadow was never written by a transaction and is read in place.
+  *
+  * The index is an open addressing table of pages (linear probing). The
+  * shadow pages come from a slice of an anonymous mapping per thread. Pages
+  * are not reclaimed, the shadow holds every page written in the run.
+  *
+  * The copy of a page (64 lines) does not fit in the HTM: a write to a page
+  * without shadow aborts with CODE_ST_ABORT and the transaction retries in
+  * the SGL (NH_ST_AFTER_ABORT), where the first touch copies the page. TSX
+  * drops the stores of an aborted transaction, so the page to seed cannot
+  * be passed to the retry. The later transactions find the shadow and run
+  * in HTM.
+  */
+
+  #ifndef NH_ST_PAGE_BITS
+  #define NH_ST_PAGE_BITS 12
+  #endif
+  #if NH_ST_PAGE_BITS > 12
+  #error "The shadow copies whole pages, NH_ST_PAGE_BITS must be <= 12."
+  #endif
+  #define NH_ST_PAGE_SIZE (1UL << NH_ST_PAGE_BITS)
+  #define NH_ST_PAGE_MASK (NH_ST_PAGE_SIZE - 1)
+
+  // shadow pages of each thread
+  #ifndef NH_ST_PAGES
+  #define NH_ST_PAGES (1 << 16)
+  #endif
+
+  typedef struct NH_ST_alias_entry_ {
+    uintptr_t page; // page number + 1, 0 is an empty slot
+    char *shadow;
+  } NH_ST_alias_entry_s;
+
+  extern NH_ST_alias_entry_s *NH_alias_table;
+  extern uintptr_t NH_alias_mask; // number of slots - 1
+  extern __thread char *NH_ST_next_page;
+  extern __thread char *NH_ST_end_page;
+
+  // maps the table and the shadow pages (in NVMHTM_init_thrs)
+  void NH_ST_init(int nb_threads);
+
+  // slice of shadow pages of the thread
+  void NH_ST_thr_init(int tid);
+
+  // out of shadow pages, exits
+  char *NH_ST_no_space();
+
+  static inline NH_ST_alias_entry_s *NH_ST_find(uintptr_t page)
+  {
+    uintptr_t i = (page ^ (page >> 17)) & NH_alias_mask;
+
+    while (NH_alias_table[i].page != 0 && NH_alias_table[i].page != page + 1) {
+      i = (i + 1) & NH_alias_mask;
+    }
+
+    return &(NH_alias_table[i]);
+  }
+
+  // where to read addr
+  static inline void *NH_ST_read_addr(void *addr)
+  {
+    uintptr_t a = (uintptr_t) addr;
+    NH_ST_alias_entry_s *entry = NH_ST_find(a >> NH_ST_PAGE_BITS);
+
+    if (entry->page == 0) {
+      return addr;
+    }
+
+    return entry->shadow + (a & NH_ST_PAGE_MASK);
+  }
+
+  // where to write addr, creates the shadow of the page (outside the HTM)
+  static inline void *NH_ST_write_addr(void *addr)
+  {
+    uintptr_t a = (uintptr_t) addr, page = a >> NH_ST_PAGE_BITS;
+    NH_ST_alias_entry_s *entry = NH_ST_find(page);
+
+    if (entry->page == 0) {
+      if (HTM_test()) {
+        HTM_named_abort(CODE_ST_ABORT);
+      }
+      char *shadow = NH_ST_next_page;
+      if (shadow == NH_ST_end_page) {
+        shadow = NH_ST_no_space();
+      }
+      NH_ST_next_page = shadow + NH_ST_PAGE_SIZE;
+      memcpy(shadow, (void*) (page << NH_ST_PAGE_BITS), NH_ST_PAGE_SIZE);
+      entry->shadow = shadow;
+      entry->page = page + 1;
+    }
+
+    return entry->shadow + (a & NH_ST_PAGE_MASK);
+  }
+
+  // a transaction that missed a shadow retries in the SGL
+  #define NH_ST_AFTER_ABORT(budget, status) \
+    if (NH_is_abort_code(status, CODE_ST_ABORT)) { \
+      budget = 0; \
+    }
+
+  #ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: ALIAS_TABLE_H_GUARD */
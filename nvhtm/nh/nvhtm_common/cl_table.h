@@ -0,0 +1,132 @@
+#ifndef CL_TABLE_H_GUARD
+#define CL_TABLE_H_GUARD
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif /* __AVX2__ */
+
+#ifdef __cplusplus
+extern "C"
+{
+  #endif
+
+  /**
+  * Set of cache lines with a mask of the words written in each line, used
+  * to coalesce the writes of a checkpoint.
+  *
+  * Open addressing with linear probing in groups of CL_TABLE_GROUP slots
+  * (compared at once with AVX2). A slot is a single word with the line, the
+  * mask and the generation, slots of older generations are empty, so
+  * clearing the table is O(1) (only the list of touched lines is reset).
+  *
+  * Assumes 48-bit virtual addresses (42 bits of line number).
+  */
+
+  #define CL_TABLE_GROUP    4
+  #define CL_TABLE_MASK_BIT 42
+  #define CL_TABLE_GEN_BIT  50
+  #define CL_TABLE_MAX_GEN  ((1ULL << (64 - CL_TABLE_GEN_BIT)) - 1)
+  #define CL_TABLE_KEY_MASK (~(0xffULL << CL_TABLE_MASK_BIT))
+
+  #define CL_TABLE_KEY(line, gen) \
+    (((uint64_t)(line) >> 6) | ((uint64_t)(gen) << CL_TABLE_GEN_BIT))
+  #define CL_TABLE_GEN(tag) ((uint64_t)(tag) >> CL_TABLE_GEN_BIT)
+  #define CL_TABLE_LINE(tag) \
+    ((uintptr_t)((tag) & ((1ULL << CL_TABLE_MASK_BIT) - 1)) << 6)
+  // near lines in near slots, the high bits break strided conflicts
+  #define CL_TABLE_HOME(t, line) ({ \
+    uint64_t __cl = (uint64_t)(line) >> 6; \
+    ((__cl ^ (__cl >> (t)->log_slots) ^ (__cl >> (2 * (t)->log_slots))) \
+      & ((t)->nb_slots - 1) & ~(uint64_t)(CL_TABLE_GROUP - 1)); \
+  })
+
+  typedef struct cl_table_ {
+    uint64_t *tags;       // line, mask of written words and generation
+    uintptr_t *lines;     // lines of this generation, in insertion order
+    uint64_t nb_slots;    // power of 2
+    uint64_t gen;
+    int nb_lines;
+    int log_slots;
+  } cl_table_s;
+
+  cl_table_s *cl_table_init(size_t nb_lines);
+  void cl_table_destroy(cl_table_s*);
+
+  // empties the table (new generation), grows it to fit nb_lines
+  void cl_table_clear(cl_table_s*, size_t nb_lines);
+
+  // doubles the number of slots (called before it gets half full)
+  void cl_table_grow(cl_table_s*);
+
+  // the slot of the line, the line is inserted (no words) if not found
+  static inline uint64_t *cl_table_line_slot(cl_table_s *t, uintptr_t line)
+  {
+    uint64_t key = CL_TABLE_KEY(line, t->gen);
+    uint64_t g;
+    int empty;
+
+    if (2 * (uint64_t) t->nb_lines >= t->nb_slots) {
+      cl_table_grow(t);
+    }
+
+    g = CL_TABLE_HOME(t, line);
+
+    while (1) {
+#ifdef __AVX2__
+      __m256i tags = _mm256_load_si256((__m256i*) &(t->tags[g]));
+      __m256i keys = _mm256_and_si256(tags,
+        _mm256_set1_epi64x(CL_TABLE_KEY_MASK));
+      int match = _mm256_movemask_pd(_mm256_castsi256_pd(
+        _mm256_cmpeq_epi64(keys, _mm256_set1_epi64x(key))));
+      if (match) {
+        return &(t->tags[g + __builtin_ctz(match)]);
+      }
+      empty = ~_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(
+        _mm256_srli_epi64(tags, CL_TABLE_GEN_BIT),
+        _mm256_set1_epi64x(t->gen)))) & 0xf;
+#else /* !__AVX2__ */
+      int i;
+      empty = 0;
+      for (i = 0; i < CL_TABLE_GROUP; ++i) {
+        if ((t->tags[g + i] & CL_TABLE_KEY_MASK) == key) {
+          return &(t->tags[g + i]);
+        }
+        if (CL_TABLE_GEN(t->tags[g + i]) != t->gen) {
+          empty |= 1 << i;
+        }
+      }
+#endif /* __AVX2__ */
+      if (empty) {
+        // never deleted, then the line is not in a further group
+        uint64_t slot = g + __builtin_ctz(empty);
+        t->tags[slot] = key;
+        t->lines[t->nb_lines++] = line;
+        return &(t->tags[slot]);
+      }
+      g = (g + CL_TABLE_GROUP) & (t->nb_slots - 1);
+    }
+  }
+
+  // 1 if the word was not in the table (it is added), 0 otherwise
+  static inline int cl_table_add_word(cl_table_s *t, void *addr)
+  {
+    uintptr_t line = (uintptr_t) addr & ~((uintptr_t) 63);
+    int word = ((uintptr_t) addr & 0x38) >> 3;
+    uint64_t bit = 1ULL << (CL_TABLE_MASK_BIT + word);
+    uint64_t *slot = cl_table_line_slot(t, line);
+
+    if (*slot & bit) {
+      return 0;
+    }
+    *slot |= bit;
+    return 1;
+  }
+
+  #ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: CL_TABLE_H_GUARD */
@@ -9,10 +9,16 @@
 // global
 extern CL_ALIGN NVLog_s **NH_global_logs;
 extern void* LOG_global_ptr;
+extern NVLogMarkers_s **NH_global_markers;
+extern NVLogCtrl_s *NH_global_ctrl;
+extern volatile ts_s *NH_active_ts; // see log_order.h
 // thread local
 extern __thread CL_ALIGN NVLog_s *nvm_htm_local_log;
 extern __thread CL_ALIGN int LOG_nb_wraps;
 extern __thread CL_ALIGN NVLogLocal_s LOG_local_state;
+#ifdef LOG_NT_APPEND
+extern __thread CL_ALIGN NVLogEntry_s LOG_staged[LOG_NT_STAGE]; // see log.h
+#endif /* LOG_NT_APPEND */
 // ####################################################
 
 #endif /* EXTRA_GLOBALS_H */
@@ -21,6 +21,7 @@ typedef struct NVLog_
 	int start_tx;
 	int end_last_tx;
 	int tid;
+	int node; // NUMA node of the owner (set in LOG_thr_init)
 
 	char pad2[2*CACHE_LINE_SIZE];
 	
@@ -36,12 +37,57 @@ typedef struct NVLogLocation_
     ts_s ts;
 } __attribute__((packed)) NVLogLocation_s;
 
+// commit-marker index (volatile), one per log
+typedef struct NVLogMarker_
+{
+	int pos; // of the LOG_TS entry
+	ts_s ts;
+} __attribute__((packed)) NVLogMarker_s;
+
+typedef struct NVLogMarkers_
+{
+	long long end;  // published markers (after log->end)
+	long long next; // pushed by the owner, not yet published
+	int size;       // size_of_log, never wraps over a live marker
+	NVLogMarker_s *ptr;
+} NVLogMarkers_s;
+
+// signals of a worker to the log threshold controller (shared, LOG_ADAPTIVE)
+typedef struct NVLogCtrlThr_
+{
+	ts_s time_blocked;       // last NH_time_blocked
+	long long nb_log_aborts; // CODE_LOG_ABORT
+	char pad[CACHE_LINE_SIZE - sizeof(ts_s) - sizeof(long long)];
+} __attribute__((packed)) NVLogCtrlThr_s;
+
+// checkpointer thresholds, retuned each round by LOG_CTRL_update
+typedef struct NVLogCtrl_
+{
+	int trigger;   // entries in a log that start a round (APPLY_BACKWARD_VAL)
+	int apply;     // entries of each log applied in a round (LOG_APPLY_VAL)
+	int too_empty; // a log with less entries delays the round (TOO_EMPTY)
+	int wait_distance; // free entries needed before a TX (WAIT_DISTANCE)
+	NVLogCtrlThr_s *thrs;
+} NVLogCtrl_s;
+
 typedef struct NVLogLocal_
 {
 	int start;
 	int end;
 	int counter;
     int size_of_log;
+#ifdef LOG_COMPACT
+	GRANULE_TYPE *base; // first write of the TX
+	int half;           // packed entry with one write (-1 if none)
+#endif /* LOG_COMPACT */
+#ifdef LOG_NT_APPEND
+	int staged_begin;   // log position of LOG_staged[0]
+	int nb_staged;      // -1 after LOG_NT_drain
+#endif /* LOG_NT_APPEND */
 } __attribute__((packed)) NVLogLocal_s;
+
+#ifndef LOG_NT_STAGE
+#define LOG_NT_STAGE 256 // entries staged in a TX (16B each)
+#endif
 	
 #endif /* EXTRA_TYPES_H */
@@ -8,6 +8,10 @@
 #include "log_aux.h"
 #include "log_forward.h"
 #include "log_backward.h"
+#include "log_recover.h"
+#include "log_ctrl.h"
+#include "log_order.h"
+#include "log_group.h"
 #include "utils.h"
 
 #include <stdlib.h>
@@ -21,8 +25,16 @@ extern "C"
 	// that the number of writes within transactions are never greater than:
 	// NVMHTM_CHECKPOINT_CRITICAL * NVMHTM_LOG_SIZE
 
-	// TODO: WAIT_DISTANCE must be smaller than size of the log minus max size TX
-	#define WAIT_DISTANCE (512)
+	// free entries a worker needs before a TX, a TX that writes more aborts
+	// with CODE_LOG_ABORT (LOG_ADAPTIVE grows it on these aborts), at most a
+	// quarter of the log
+	#define WAIT_DISTANCE_INIT(size_of_log) \
+		((size_of_log) / 4 < 512 ? (size_of_log) / 4 : 512)
+	#ifdef LOG_ADAPTIVE
+	#define WAIT_DISTANCE (NH_global_ctrl->wait_distance) // see log_ctrl.h
+	#else /* !LOG_ADAPTIVE */
+	#define WAIT_DISTANCE WAIT_DISTANCE_INIT(LOG_local_state.size_of_log)
+	#endif /* LOG_ADAPTIVE */
 
 	// TODO: space it more, like 8 or 12
 	#define WAIT_LOG_CONDITION \
@@ -31,35 +43,58 @@ extern "C"
 	// this parameters are a bit random,
 	// but they are meant to minimize HTM aborts
 	#define TOO_FULL (LOG_local_state.size_of_log - WAIT_DISTANCE - 1)
-	#define TOO_EMPTY 512
+	#define TOO_EMPTY_INIT 512
+	#ifdef LOG_ADAPTIVE
+	#define TOO_EMPTY (NH_global_ctrl->too_empty) // see log_ctrl.h
+	#else /* !LOG_ADAPTIVE */
+	#define TOO_EMPTY TOO_EMPTY_INIT
+	#endif /* LOG_ADAPTIVE */
 
 	// TODO: why was this?
 	#define CHECK_AND_REQUEST(tid) ({ })
 
 	#if DO_CHECKPOINT == 2
-	// TODO: 0.05 and 0.5 are magic numbers
 
 	// ocuppied ==> distance_ptr(log->start, log->end)
 
-	// REACTIVE one
+	// REACTIVE one: a worker without WAIT_DISTANCE free entries reduces the
+	// logs until LOG_REACTIVE_FREE entries of its log are free. This is the
+	// round of the checkpointer, LOG_ADAPTIVE retunes the free entries as the
+	// apply of a round. At least 2 * WAIT_DISTANCE, or it blocks again soon
+	// (THRESHOLD=0 would never free).
+	#ifdef LOG_ADAPTIVE
+	#define LOG_REACTIVE_FREE (NH_global_ctrl->apply)
+	#else /* !LOG_ADAPTIVE */
+	#define LOG_REACTIVE_FREE \
+		((int) ((double) LOG_local_state.size_of_log * LOG_THRESHOLD))
+	#endif /* LOG_ADAPTIVE */
+
 	#define FREE_LOG_SPACE(log) ({ \
 		if (LOG_try_lock()) { \
+			ts_s ts1_free_log_time = rdtscp(); \
+			int free_log_target; \
 			LOG_nb_wraps++; \
+			LOG_CTRL_reactive_update(); \
+			free_log_target = LOG_REACTIVE_FREE > 2 * WAIT_DISTANCE \
+				? LOG_REACTIVE_FREE : 2 * WAIT_DISTANCE; \
+			if (free_log_target > LOG_local_state.size_of_log) \
+				free_log_target = LOG_local_state.size_of_log; \
 			while((LOG_local_state.size_of_log - distance_ptr(log->start, log->end)) < \
-			LOG_local_state.size_of_log * LOG_THRESHOLD) { \
+			free_log_target) { \
 				NVHTM_reduce_logs(); \
 				PAUSE(); \
 			} \
 			LOG_move_start_ptrs(); \
+			LOG_CTRL_reactive_round(rdtscp() - ts1_free_log_time); \
 			LOG_unlock(); \
 		} \
 	})
 
 	#define WAIT_MORE_LOG(log) ({ \
-		if (distance_ptr(log->start, log->end) > (LOG_local_state.size_of_log - 32)) { \
+		if (distance_ptr(log->start, log->end) > (LOG_local_state.size_of_log - WAIT_DISTANCE)) { \
 			ts_s ts1_wait_log_time; \
 			ts1_wait_log_time = rdtscp(); \
-			while (distance_ptr(log->start, log->end) > (LOG_local_state.size_of_log - 32)) { \
+			while (distance_ptr(log->start, log->end) > (LOG_local_state.size_of_log - WAIT_DISTANCE)) { \
 				if (HTM_test()) HTM_named_abort(CODE_LOG_ABORT); \
 				FREE_LOG_SPACE(log); \
 				PAUSE(); \
@@ -67,12 +102,14 @@ extern "C"
 			LOG_before_TX(); \
 			NH_count_blocks++; \
 			NH_time_blocked += rdtscp() - ts1_wait_log_time; \
+			LOG_CTRL_blocked(); \
 		} \
 	})
 
 	#define CHECK_LOG_ABORT(TM_tid_var, TM_status_var) ({ \
-		if (HTM_is_named(TM_status_var) == CODE_LOG_ABORT) { \
+		if (NH_is_abort_code(TM_status_var, CODE_LOG_ABORT)) { \
 			NVLog_s *log = LOG_get(TM_tid_var); \
+			LOG_CTRL_log_abort(); \
 			FREE_LOG_SPACE(log); \
 			LOG_before_TX(); \
 		} \
@@ -117,6 +154,7 @@ extern "C"
 			LOG_before_TX(); \
 			ts2_wait_log_time = rdtscp(); \
 			NH_time_blocked += rdtscp() - ts1_wait_log_time; \
+			LOG_CTRL_blocked(); \
 			/*double lat = (double)(ts2_wait_log_time - ts1_wait_log_time) / (double)CPU_MAX_FREQ; \
 			 if (lat > 100) printf("Blocked for %f ms\n", lat); */ \
 		} \
@@ -124,10 +162,11 @@ extern "C"
 
 	// TODO: there are aborts marked as EXPLICIT when the log is empty, WHY?
 	#define CHECK_LOG_ABORT(TM_tid_var, TM_status_var) \
-	if (HTM_is_named(TM_status_var) == CODE_LOG_ABORT) { \
+	if (NH_is_abort_code(TM_status_var, CODE_LOG_ABORT)) { \
 		ts_s ts1_wait_log_time, ts2_wait_log_time; \
 		ts1_wait_log_time = rdtscp(); \
 		NVLog_s *log = NH_global_logs[TM_tid_var]; \
+		LOG_CTRL_log_abort(); \
 		while ((LOG_local_state.counter == distance_ptr(log->start, log->end) \
 			&& (LOG_local_state.size_of_log - LOG_local_state.counter) < WAIT_DISTANCE) \
 			|| (distance_ptr(log->end, log->start) < WAIT_DISTANCE \
@@ -142,6 +181,7 @@ extern "C"
 		LOG_before_TX(); \
 		ts2_wait_log_time = rdtscp(); \
 		NH_time_blocked += ts2_wait_log_time - ts1_wait_log_time; \
+		LOG_CTRL_blocked(); \
 		/* double lat = (double)(ts2_wait_log_time - ts1_wait_log_time) / (double)CPU_MAX_FREQ; \
 		if (lat > 100) printf("Blocked for %f ms\n", lat); */ \
 	}
@@ -175,13 +215,62 @@ extern "C"
 
 	void LOG_attach_shared_mem();
 
+	#ifdef LOG_NT_APPEND
+	/**
+	 * Non-temporal log appends (LOG_NT_APPEND).
+	 *
+	 * The entries of the TX go to LOG_staged (thread-local, it stays in the
+	 * L1) and not to the log lines, which left the cache after the last
+	 * append. The HTM write set only has the staging lines and there is no
+	 * prefetch in LOG_before_TX. LOG_NT_drain, after the commit and before
+	 * the LOG_TS, writes them at their positions in the log with
+	 * non-temporal stores (full lines, they bypass the cache) and a fence.
+	 * The entries after the first LOG_NT_STAGE, or after the drain, go to
+	 * the log as before.
+	 */
+	#define LOG_entry_slot(log, pos) ({ \
+		int staged_i = distance_ptr(LOG_local_state.staged_begin, pos); \
+		staged_i < LOG_local_state.nb_staged ? &(LOG_staged[staged_i]) : \
+			&((log)->ptr[pos]); \
+	})
+
+	#define LOG_stage_entry(log, end) ({ \
+		int nb_staged = LOG_local_state.nb_staged; \
+		nb_staged >= 0 && nb_staged < LOG_NT_STAGE ? \
+			&(LOG_staged[LOG_local_state.nb_staged++]) : &((log)->ptr[end]); \
+	})
+
+	#define LOG_NT_reset() ({ \
+		LOG_local_state.staged_begin = LOG_local_state.end; \
+		LOG_local_state.nb_staged = 0; \
+	})
+
+	// outside the HTM, the staged entries go before anything else is pushed
+	#define LOG_NT_drain() ({ \
+		if (LOG_local_state.nb_staged > 0) { \
+			LOG_NT_write(NH_global_logs[TM_tid_var], \
+				LOG_local_state.staged_begin, LOG_staged, \
+				LOG_local_state.nb_staged); \
+		} \
+		LOG_local_state.nb_staged = -1; \
+	})
+
+	// non-temporal stores of entries at pos (may wrap) and a store fence
+	void LOG_NT_write(NVLog_s *log, int pos, NVLogEntry_s *entries, int nb);
+	#else /* !LOG_NT_APPEND */
+	#define LOG_entry_slot(log, pos)   (&((log)->ptr[pos]))
+	#define LOG_stage_entry(log, end)  (&((log)->ptr[end]))
+	#define LOG_NT_reset()             /* empty */
+	#define LOG_NT_drain()             /* empty */
+	#endif /* LOG_NT_APPEND */
+
 	#define LOG_push_entry(log, entry) ({ \
 		int end = LOG_local_state.end/* log->end */, new_end; \
 		LOG_local_state.counter++; \
 		new_end = ptr_mod_log(end, 1); \
 		/*log->ptr[end].addr = entry.addr; log->ptr[end].value = entry.value;*/ \
 		MN_count_writes++; \
-		memcpy(&(log->ptr[end]), &entry, sizeof(NVLogEntry_s)); \
+		memcpy(LOG_stage_entry(log, end), &entry, sizeof(NVLogEntry_s)); \
 		/*TODO: this aborts the transactions: */ \
 		/*MN_write(&(log->ptr[end]), &(entry), sizeof(NVLogEntry_s), 0);*/ \
 		/* log->end */ LOG_local_state.end = new_end; \
@@ -191,6 +280,43 @@ extern "C"
 
 	// this is called inside of the transaction
 	// void LOG_push_addr(int tid, GRANULE_TYPE *addr, GRANULE_TYPE value);
+	#ifdef LOG_COMPACT
+	#define LOG_push_addr(tid, adr, val) ({ \
+		int id = TM_tid_var; \
+		NVLog_s *log = tid == id ? nvm_htm_local_log : NH_global_logs[tid]; \
+		GRANULE_TYPE *addr_c = (GRANULE_TYPE*)adr, val_c = (GRANULE_TYPE)val; \
+		long long delta_c = addr_c - LOG_local_state.base; \
+		NVLogEntry_s entry; \
+		if (LOG_local_state.base != NULL && LOG_FITS_PACKED(delta_c, val_c)) { \
+			if (LOG_local_state.half != -1) { \
+				/* second write of the packed entry, no new entry */ \
+				NVLogEntry_s *half = LOG_entry_slot(log, LOG_local_state.half); \
+				half->addr = (GRANULE_TYPE*)((uintptr_t)half->addr \
+					| LOG_PACKED_SECOND(delta_c)); \
+				half->value |= LOG_PACKED_VAL2(val_c); \
+				LOG_local_state.half = -1; \
+			} else { \
+				WAIT_MORE_LOG(log); \
+				entry.addr = LOG_PACKED_FIRST(delta_c); \
+				entry.value = LOG_PACKED_VAL1(val_c); \
+				LOG_local_state.half = LOG_local_state.end; \
+				LOG_push_entry(log, entry); \
+			} \
+		} else { \
+			WAIT_MORE_LOG(log); /* only waits on the addr */ \
+			if (LOG_local_state.base == NULL) LOG_local_state.base = addr_c; \
+			LOG_local_state.half = -1; /* keeps the order of the writes */ \
+			entry.addr = addr_c; \
+			entry.value = val_c; \
+			LOG_push_entry(log, entry); \
+		} \
+	})
+	#define LOG_before_TX_compact() ({ \
+		LOG_local_state.base = NULL; \
+		LOG_local_state.half = -1; \
+	})
+	#else /* !LOG_COMPACT */
+	#define LOG_before_TX_compact() /* empty */
 	#define LOG_push_addr(tid, adr, val) ({ \
 		int id = TM_tid_var; \
 		NVLog_s *log = tid == id ? nvm_htm_local_log : NH_global_logs[tid]; \
@@ -201,11 +327,13 @@ extern "C"
 		entry.value = (GRANULE_TYPE)val; \
 		new_end = LOG_push_entry(log, entry); \
 	})
+	#endif /* LOG_COMPACT */
 
 	// void LOG_push_ts(int tid, ts_s ts);
 	#define LOG_push_ts(tid, ts) ({ \
 		int id = TM_tid_var; \
 		NVLog_s *log = tid == id ? nvm_htm_local_log : NH_global_logs[tid]; \
+		LOG_NT_drain(); /* the LOG_TS after the entries */ \
 		int end = LOG_local_state.end, new_end; \
 		NVLogEntry_s entry; \
 		entry.addr = (GRANULE_TYPE*) LOG_TS; \
@@ -213,6 +341,22 @@ extern "C"
 		new_end = LOG_push_entry(log, entry); \
 		log->start_tx = new_end; \
 		log->end_last_tx = end; \
+		LOG_push_marker(tid, end, ts); \
+	})
+
+	// indexes the commit marker (outside the TX), see LOG_AUX_marker_first
+	#define LOG_push_marker(tid, pos_val, ts_val) ({ \
+		NVLogMarkers_s *mk = NH_global_markers[tid]; \
+		NVLogMarker_s *m = &(mk->ptr[mk->next % mk->size]); \
+		m->pos = pos_val; \
+		m->ts = ts_val; \
+		mk->next++; \
+	})
+
+	// the markers are published after log->end (readers load them before)
+	#define LOG_publish_markers() ({ \
+		NVLogMarkers_s *mk = NH_global_markers[TM_tid_var]; \
+		__atomic_store_n(&(mk->end), mk->next, __ATOMIC_RELEASE); \
 	})
 
 	void LOG_push_malloc(int tid, GRANULE_TYPE *addr);
@@ -221,6 +365,7 @@ extern "C"
 	#define LOG_before_TX() ({ \
 		NVLog_s *log = NH_global_logs[TM_tid_var]; \
 		LOG_nb_writes = 0; \
+		LOG_before_TX_compact(); \
 		LOG_local_state.start = log->start; \
 		LOG_local_state.end = log->end; \
 		LOG_local_state.counter = distance_ptr((int)LOG_local_state.start, \
@@ -228,7 +373,13 @@ extern "C"
 		if (LOG_local_state.counter >= APPLY_BACKWARD_VAL) { \
 			if (*NH_checkpointer_state == 0) sem_post(NH_chkp_sem); \
 		} \
-		/* prefetch */ \
+		LOG_before_TX_prefetch(); \
+	})
+
+	#ifdef LOG_NT_APPEND
+	#define LOG_before_TX_prefetch() LOG_NT_reset()
+	#else /* !LOG_NT_APPEND */
+	#define LOG_before_TX_prefetch() ({ \
 		if (LOG_local_state.counter < LOG_local_state.size_of_log - 16) { \
 			NH_global_logs[TM_tid_var]->ptr[ptr_mod_log(LOG_local_state.end, 1)].value = 0; \
 			NH_global_logs[TM_tid_var]->ptr[ptr_mod_log(LOG_local_state.end, 3)].value = 0; \
@@ -241,6 +392,7 @@ extern "C"
 			NH_global_logs[TM_tid_var]->ptr[ptr_mod_log(LOG_local_state.end, 64)].value = 0; \
 		} \
 	})
+	#endif /* LOG_NT_APPEND */
 
 	#if DO_CHECKPOINT == 4
 	#define LOG_after_TX() ({ \
@@ -250,6 +402,7 @@ extern "C"
 		MN_count_spins++; \
 		/*log->end = LOG_local_state.end;*/ \
 		__sync_synchronize(); \
+		LOG_publish_markers(); \
 	})
 	#else
 	#define LOG_after_TX() ({ \
@@ -264,12 +417,15 @@ extern "C"
 		MN_count_spins++; \
 		/* log->end = LOG_local_state.end; */ \
 		__sync_synchronize(); \
+		LOG_publish_markers(); \
 	})
 	#endif
 
 	#define LOG_count_writes(tid) ({ LOG_nb_writes; })
 
 	void LOG_get_ts_before_tx(int tid);
+	// the thread waits outside a transaction, the commits do not wait for it
+	void LOG_idle_tx(int tid);
 
 	// the two below update start_ptr and not start (to avoid contention)
 	int LOG_checkpoint_apply_one(); // map
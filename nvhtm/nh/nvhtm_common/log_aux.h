@@ -5,6 +5,8 @@
 #include "nvhtm_helper.h"
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include <assert.h>
 
 #ifdef __cplusplus
@@ -29,15 +31,45 @@ extern "C"
     res; \
   })*/
 
-  #define APPLY_BACKWARD_VAL (int)((double)LOG_FILTER_THRESHOLD*\
-    (double)LOG_local_state.size_of_log) // TODO: parametrize this
+  #define APPLY_BACKWARD_INIT(size_of_log) \
+    (int)((double)LOG_FILTER_THRESHOLD*(double)(size_of_log))
+
+  #ifdef LOG_ADAPTIVE
+  #define APPLY_BACKWARD_VAL (NH_global_ctrl->trigger) // see log_ctrl.h
+  #define LOG_APPLY_VAL (NH_global_ctrl->apply)
+  #else /* !LOG_ADAPTIVE */
+  #define APPLY_BACKWARD_VAL APPLY_BACKWARD_INIT(LOG_local_state.size_of_log)
+  #define LOG_APPLY_VAL APPLY_BACKWARD_VAL
+  #endif /* LOG_ADAPTIVE */
 
   // NOTE: LOG_TS is the actual commit marker
   enum LOG_MARKS
   {
     LOG_EMPTY = 0, LOG_TS = 1, LOG_COMMIT = 2, LOG_MALLOC = 3,
+    LOG_PACKED = 5, // tag in the low bits of addr (LOG_COMPACT)
   };
 
+  // LOG_COMPACT: the first write of the TX is a full entry (the base), the
+  // next writes with a small value near the base are packed two per entry:
+  // addr  = [63..34] delta2 | [33..4] delta1 | [3] has2 | [2..0] LOG_PACKED
+  // value = [63..32] value2 | [31..0] value1 (deltas in granules, signed)
+  #define LOG_PACKED_TAG_MASK 0x7
+  #define LOG_PACKED_HAS2     0x8
+  #define LOG_PACKED_MAX_DELTA (1LL << 29)
+
+  #define LOG_FITS_PACKED(delta, val) \
+    ((delta) >= -LOG_PACKED_MAX_DELTA && (delta) < LOG_PACKED_MAX_DELTA \
+    && (GRANULE_TYPE)(int32_t)(val) == (GRANULE_TYPE)(val))
+  #define LOG_PACKED_FIRST(delta) \
+    ((GRANULE_TYPE*)(LOG_PACKED | (((uintptr_t)(delta) & 0x3fffffff) << 4)))
+  #define LOG_PACKED_SECOND(delta) \
+    (LOG_PACKED_HAS2 | ((uintptr_t)(delta) << 34))
+  #define LOG_PACKED_VAL1(val) ((GRANULE_TYPE)(uint32_t)(val))
+  #define LOG_PACKED_VAL2(val) ((GRANULE_TYPE)((uintptr_t)(val) << 32))
+
+  #define entry_is_packed(entry) \
+    (((uintptr_t)entry.addr & LOG_PACKED_TAG_MASK) == LOG_PACKED)
+
   int LOG_check_correct_ts(int tid);
   int LOG_try_lock();
   void LOG_unlock();
@@ -74,6 +106,34 @@ extern "C"
   // applies N transactions backward, and avoids repeated writes
   void *LOG_AUX_apply_to_checkpoint(void *addr, GRANULE_TYPE value, int do_flush);
 
+  // snapshots the pools (and their checkpoints), call before translating
+  void LOG_AUX_chkp_regions_update();
+  // address of the image of addr in the checkpoint pool, if addr does not
+  // belong to any pool (e.g., forked checkpointer) addr is returned
+  GRANULE_TYPE *LOG_AUX_chkp_addr(GRANULE_TYPE *addr);
+
+  // commit-marker index: (pos, ts) of each LOG_TS, pushed by LOG_push_ts
+  // and published with log->end, so the TX boundaries are found without
+  // scanning (and aborting) the logs
+  void LOG_AUX_markers_init(int nb_threads);
+  // indexes the markers already in [log->start, log->end)
+  void LOG_AUX_markers_rebuild(int tid);
+  // first/last marker in [start, end) of the log, -1 if none; mk_end is
+  // LOG_AUX_markers_end(tid) loaded before end (the markers are before it)
+  long long LOG_AUX_marker_first(int tid, long long mk_end, int start, int end);
+  long long LOG_AUX_marker_last(int tid, long long mk_end, int start, int end);
+  // first marker in [first, last] at or after pos, last + 1 if none
+  long long LOG_AUX_marker_find(int tid, long long first, long long last,
+    int start, int pos);
+
+  #define LOG_AUX_markers_end(tid) \
+    __atomic_load_n(&(NH_global_markers[tid]->end), __ATOMIC_ACQUIRE)
+
+  #define LOG_AUX_marker(tid, k) ({ \
+    NVLogMarkers_s *mk = NH_global_markers[tid]; \
+    &(mk->ptr[(k) % mk->size]); \
+  })
+
   size_t LOG_base2_before(size_t size_of_log);
   NVLog_s* LOG_init_1thread(void *log_pool, size_t max_size);
   // arg can be a signed int
@@ -94,6 +154,43 @@ extern "C"
     res; \
   })
 
+  // writes of an update entry in the order they were done (2 if packed),
+  // *base is the first write of the TX (NULL at the beginning of the TX)
+  static inline int LOG_decode(NVLogEntry_s entry, GRANULE_TYPE **base,
+    NVLogEntry_s *writes)
+  {
+#ifdef LOG_COMPACT
+    if (entry_is_packed(entry)) {
+      uintptr_t w = (uintptr_t) entry.addr;
+      writes[0].addr = *base + (((long long) (w << 30)) >> 34);
+      writes[0].value = (GRANULE_TYPE)(int32_t) entry.value;
+      if (!(w & LOG_PACKED_HAS2)) {
+        return 1;
+      }
+      writes[1].addr = *base + (((long long) w) >> 34);
+      writes[1].value = (GRANULE_TYPE)(int32_t)((uintptr_t) entry.value >> 32);
+      return 2;
+    }
+#endif /* LOG_COMPACT */
+    if (*base == NULL) {
+      *base = entry.addr;
+    }
+    writes[0] = entry;
+    return 1;
+  }
+
+  // base of the TX in [begin, end) for readers that do not start at begin
+  static inline GRANULE_TYPE *LOG_tx_base(NVLog_s *log, int begin, int end)
+  {
+    for (; begin != end; begin = (begin + 1) & (log->size_of_log - 1)) {
+      NVLogEntry_s entry = log->ptr[begin];
+      if (entry_is_update(entry) && !entry_is_packed(entry)) {
+        return entry.addr;
+      }
+    }
+    return NULL;
+  }
+
   #ifdef __cplusplus
 }
 #endif
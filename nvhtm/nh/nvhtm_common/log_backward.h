@@ -10,5 +10,18 @@
   // called internally
   int LOG_checkpoint_backward_apply_one();
 
+  /**
+   * Number of threads applying each checkpoint (the manager included), the
+   * write-set is sharded by cache line among them. Takes effect in the next
+   * checkpoint (with DO_CHECKPOINT=5 call it before the manager is forked).
+   */
+  void LOG_checkpoint_backward_set_threads(int nb_threads);
+
+  // thread s on node s % nb_nodes, from the last CPU (the manager is s = 0)
+  #define CHKP_SHARD_CPU(shard) TOPO_node_cpu_from_last( \
+    (shard) % TOPO_nb_nodes(), (shard) / TOPO_nb_nodes())
+  #define CHKP_MANAGER_CPU CHKP_SHARD_CPU(0)
+  #define CHKP_SORTER_CPU TOPO_node_cpu_from_last(0, 1)
+
 
 #endif /* end of include guard: LOG_BACKWARD_H_GUARD */
@@ -0,0 +1,62 @@
+#ifndef LOG_CTRL_H_GUARD
+#define LOG_CTRL_H_GUARD
+
+#include "extra_types.h"
+#include "extra_globals.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+  #endif
+
+  /**
+   * Feedback controller of the checkpointer thresholds (LOG_ADAPTIVE).
+   *
+   * Each round the checkpointer samples the fill rate of the logs, the time
+   * the workers were blocked on a full log and the CODE_LOG_ABORTs. Blocked
+   * workers or log aborts start the next rounds earlier and apply more log
+   * (multiplicative), calm rounds back off slowly (additive). The trigger
+   * always leaves free log for the entries written while a round runs.
+   * Log aborts also double the free log a worker needs before a TX
+   * (WAIT_DISTANCE, TOO_FULL), calm rounds shrink it.
+   *
+   * The state is shared with the forked checkpointer (DO_CHECKPOINT=5).
+   * With the reactive checkpoint (DO_CHECKPOINT=2) the worker that frees
+   * the logs runs the round (FREE_LOG_SPACE, under the log lock).
+   */
+
+  // creates the shared state with the static thresholds (in LOG_init)
+  void LOG_CTRL_init(int nb_threads);
+
+  // retunes the thresholds, call at the beginning of a round
+  void LOG_CTRL_update();
+
+  // duration of a round that applied log
+  void LOG_CTRL_round(ts_s duration);
+
+  #ifdef LOG_ADAPTIVE
+  // after NH_time_blocked is updated (outside the HTM)
+  #define LOG_CTRL_blocked() ({ \
+    NH_global_ctrl->thrs[TM_tid_var].time_blocked = NH_time_blocked; \
+  })
+
+  // after a CODE_LOG_ABORT
+  #define LOG_CTRL_log_abort() ({ \
+    NH_global_ctrl->thrs[TM_tid_var].nb_log_aborts++; \
+  })
+
+  // round of the reactive checkpoint
+  #define LOG_CTRL_reactive_update()        LOG_CTRL_update()
+  #define LOG_CTRL_reactive_round(duration) LOG_CTRL_round(duration)
+  #else /* !LOG_ADAPTIVE */
+  #define LOG_CTRL_blocked()   /* empty */
+  #define LOG_CTRL_log_abort() /* empty */
+  #define LOG_CTRL_reactive_update()        /* empty */
+  #define LOG_CTRL_reactive_round(duration) /* empty */
+  #endif /* LOG_ADAPTIVE */
+
+  #ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: LOG_CTRL_H_GUARD */
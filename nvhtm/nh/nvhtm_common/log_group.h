@@ -0,0 +1,54 @@
+#ifndef LOG_GROUP_H_GUARD
+#define LOG_GROUP_H_GUARD
+
+#include "log_order.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+  #endif
+
+  /**
+   * Group commit of the PC solution (LOG_GROUP_COMMIT).
+   *
+   * A small writer (up to LOG_GROUP_MAX_WRITES entries) flushes its entries,
+   * writes its LOG_TS and posts its ts instead of validating. The thread
+   * that gets the group lock combines: it waits up to LOG_GROUP_WINDOW
+   * cycles after its own ts for others to post, then takes the posted ts
+   * below every slot of the threads that did not post (see log_order.h),
+   * these only wait for each other, and makes their markers durable with
+   * one flush per marker line (one per log) and a single fence. The others
+   * spin on their request, the leader returns once its own is durable.
+   *
+   * The larger writers validate as before, they wait for the slots of the
+   * posted ones until the group is durable.
+   */
+
+  #if defined(LOG_GROUP_COMMIT) && VALIDATION != 3
+  #error "LOG_GROUP_COMMIT needs the commit-order frontier (SOLUTION=4)."
+  #endif
+
+  // cycles the leader waits for the group after its ts
+  #ifndef LOG_GROUP_WINDOW
+  #define LOG_GROUP_WINDOW 500
+  #endif
+
+  // writes of the transactions that commit in groups
+  #ifndef LOG_GROUP_MAX_WRITES
+  #define LOG_GROUP_MAX_WRITES 16
+  #endif
+
+  // allocates the requests (in LOG_init)
+  void LOG_GROUP_init(int nb_threads);
+
+  // after the LOG_TS of ts is written, returns when it is durable
+  void LOG_GROUP_commit(int tid, ts_s ts);
+
+  // number of groups and of the transactions in them
+  void LOG_GROUP_stats(long long *nb_groups, long long *nb_txs);
+
+  #ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: LOG_GROUP_H_GUARD */
@@ -0,0 +1,50 @@
+#ifndef LOG_ORDER_H_GUARD
+#define LOG_ORDER_H_GUARD
+
+#include "extra_types.h"
+#include "extra_globals.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+  #endif
+
+  /**
+   * Commit-order frontier of the PC solution (VALIDATION == 3).
+   *
+   * A writer publishes its commit marker only after every transaction that
+   * may commit with a smaller ts. Each thread keeps one slot in
+   * NH_active_ts: the ts before the transaction while it runs, its commit
+   * ts until the marker is public and LOG_ORDER_IDLE otherwise. A slot
+   * only moves forward, once it is not below a ts it never is again.
+   *
+   * The slots are packed (LOG_ORDER_GROUP per cache line), the committer
+   * reads them once (with AVX2) and then polls only the slots below its ts.
+   * After LOG_ORDER_SPINS polls it yields at each one: with more threads
+   * than cores the slot it waits for may belong to a preempted thread.
+   */
+
+  #define LOG_ORDER_GROUP 8
+  #ifndef LOG_ORDER_SPINS
+  #define LOG_ORDER_SPINS 1024 // before yielding
+  #endif /* LOG_ORDER_SPINS */
+  // signed max, the AVX2 compare is signed
+  #define LOG_ORDER_IDLE  ((ts_s) 0x7fffffffffffffffLL)
+
+  // allocates the slots, all idle (in LOG_init)
+  void LOG_ORDER_init(int nb_threads);
+
+  // smallest slot
+  ts_s LOG_ORDER_min();
+
+  // waits until no slot is below ts
+  void LOG_ORDER_wait(ts_s ts);
+
+  #define LOG_ORDER_set(tid, ts) ({ NH_active_ts[tid] = ts; })
+  #define LOG_ORDER_idle(tid)    ({ NH_active_ts[tid] = LOG_ORDER_IDLE; })
+
+  #ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: LOG_ORDER_H_GUARD */
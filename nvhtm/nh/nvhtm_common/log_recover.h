@@ -0,0 +1,26 @@
+#ifndef LOG_RECOVER_H_GUARD
+#define LOG_RECOVER_H_GUARD
+
+#ifdef __cplusplus
+extern "C"
+{
+  #endif
+
+  /**
+  * Replays the committed transactions of all logs into the checkpoint
+  * (call after a crash, with no transactions running).
+  *
+  * The logs are scanned from start to end, the transactions are merged
+  * by their commit TS and the writes are partitioned by cache line among
+  * nb_workers threads. Writes not followed by a commit marker are
+  * discarded. The logs are left empty.
+  *
+  * Returns the number of bytes of log that were replayed.
+  */
+  long long LOG_recover(int nb_workers);
+
+  #ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: LOG_RECOVER_H_GUARD */
@@ -0,0 +1,57 @@
+#ifndef POOL_ALLOC_H_GUARD
+#define POOL_ALLOC_H_GUARD
+
+#include "nvhtm_helper.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+  #endif
+
+  /**
+   * Persistent allocator of the NVMHTM_mem_s pools (NVMHTM_malloc and
+   * NVMHTM_pfree).
+   *
+   * The heap starts at the last_alloc of the pool (the memory before it is
+   * used directly), the first line holds the persistent top. The heap is a
+   * sequence of slabs of NH_PA_SLAB_SIZE (or one block, if larger), each
+   * with blocks of a single power of two size class. A block starts with a
+   * header word, class << 1 | used, then the payload. The header of the
+   * first block of a slab is written when the slab is carved, the others
+   * are 0 until the block is allocated.
+   *
+   * The top, the headers and the free list links (in the payload of the
+   * free blocks) are written with NH_write, in the redo log of the
+   * transaction that allocates or frees, and are undone with it: call the
+   * allocator inside a transaction (HTM or SGL, not the STM path), outside
+   * NVMHTM_malloc and NVMHTM_pfree run one of their own. The heads of the
+   * free lists and the slab being carved are volatile and per thread (a
+   * block freed goes to the thread that frees it), no lock is taken and
+   * the HTM only conflicts on the top, once per slab. The volatile state
+   * is attached with the pool, or on the first use if the pool was
+   * allocated inside a transaction. When a pool is reattached the free
+   * lists are rebuilt from the headers.
+   */
+
+  // bytes of a slab, the blocks of a class are carved from it
+  #ifndef NH_PA_SLAB_SIZE
+  #define NH_PA_SLAB_SIZE 65536
+  #endif
+
+  #define NH_PA_MIN_CLASS  5 // 32B blocks
+  #define NH_PA_NB_CLASSES 48
+
+  // volatile state of a pool (after the pool is mapped), the first attach
+  // wins
+  void NH_PA_attach(NVMHTM_mem_s *instance);
+  void NH_PA_detach(NVMHTM_mem_s *instance);
+
+  // inside a transaction, NULL if out of memory
+  void *NH_PA_malloc(NVMHTM_mem_s *instance, size_t size);
+  void NH_PA_free(NVMHTM_mem_s *instance, void *ptr);
+
+  #ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: POOL_ALLOC_H_GUARD */
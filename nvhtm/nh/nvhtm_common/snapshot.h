@@ -0,0 +1,64 @@
+#ifndef SNAPSHOT_H_GUARD
+#define SNAPSHOT_H_GUARD
+
+#ifdef __cplusplus
+extern "C"
+{
+  #endif
+
+  /**
+   * Incremental snapshot checkpointer (CHKP_SNAPSHOT).
+   *
+   * Instead of applying the logs to a copy-on-write image of the heap (the
+   * forked checkpointer, DO_CHECKPOINT=5), a round copies the pages of the
+   * pools written since the last round into their checkpoint image
+   * (NVMHTM_mem_s::chkp) and truncates the logs of the transactions it
+   * covers, the cost follows the written pages and not the heap size.
+   *
+   * The pools are registered in a userfaultfd in asynchronous write-protect
+   * mode: the kernel unprotects a page on its first write, the PAGEMAP_SCAN
+   * of the round returns the written pages and protects them again (both in
+   * the same walk). Without support (Linux < 6.7, or a mapping that cannot
+   * be write-protected) the round copies the whole pool.
+   *
+   * The round takes the SGL, then no transaction writes the pools, copies
+   * the written pages to a volatile buffer and releases the SGL. Once the
+   * transactions with a smaller ts have their marker public the buffer goes
+   * to the images and the logs are truncated up to the ts of the round. A
+   * crash in between replays the logs on a mix of old and new pages, both
+   * only hold durable values. If the SGL is taken or a log fills up in the
+   * meantime the round applies the logs backward instead, the pages copied
+   * are kept for the next round.
+   *
+   * The first write to a protected page faults, in the HTM the transaction
+   * aborts until it runs in the fallback (as the copy-on-write faults after
+   * the fork, but once per round).
+   */
+
+  #if defined(CHKP_SNAPSHOT) && DO_CHECKPOINT != 1
+  #error "CHKP_SNAPSHOT runs in the checkpointer thread, use DO_CHECKPOINT=1."
+  #endif
+  #if defined(CHKP_SNAPSHOT) && (VALIDATION != 3 || !defined(REAL_CHECKPOINT))
+  #error "CHKP_SNAPSHOT needs the PC solution and REAL_CHKP=1."
+  #endif
+  #if defined(CHKP_SNAPSHOT) && defined(HW_SW_PATHS)
+  #error "CHKP_SNAPSHOT does not stop the STM path of NVPhTM."
+  #endif
+  // the transactions write the shadow pages (alias_table.h), the pool pages
+  // are never written nor tracked: the round would truncate the logs of
+  // writes that are in no image
+  #if defined(CHKP_SNAPSHOT) && defined(SOFTWARE_TRANSLATION)
+  #error "CHKP_SNAPSHOT copies the pool pages, not the shadow of SOFTWARE_TRANSLATION."
+  #endif
+
+  /**
+   * Snapshot of the pools written since the last round (in the place of
+   * LOG_checkpoint_backward), returns 0 if the logs were truncated.
+   */
+  int NH_SNP_checkpoint();
+
+  #ifdef __cplusplus
+}
+#endif
+
+#endif /* end of include guard: SNAPSHOT_H_GUARD */
@@ -0,0 +1,65 @@
+#ifdef SOFTWARE_TRANSLATION
+
+#include "alias_table.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <sys/mman.h>
+
+// ################ variables
+
+NH_ST_alias_entry_s *NH_alias_table; // extern
+uintptr_t NH_alias_mask; // extern
+__thread char *NH_ST_next_page; // extern
+__thread char *NH_ST_end_page; // extern
+
+static char *shadow_pool;
+
+// ################ local functions
+
+static void *map_anonymous(size_t size)
+{
+  // only the touched pages are backed
+  void *res = mmap(NULL, size, PROT_READ | PROT_WRITE,
+    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+  if (res == MAP_FAILED) {
+    perror("mmap");
+    exit(EXIT_FAILURE);
+  }
+
+  return res;
+}
+
+// ################ implementation header
+
+void NH_ST_init(int nb_threads)
+{
+  size_t nb_slots = 1;
+
+  // at most half full
+  while (nb_slots < 2 * (size_t) nb_threads * NH_ST_PAGES) {
+    nb_slots <<= 1;
+  }
+
+  NH_alias_table = (NH_ST_alias_entry_s*)
+    map_anonymous(nb_slots * sizeof (NH_ST_alias_entry_s));
+  NH_alias_mask = nb_slots - 1;
+  shadow_pool = (char*) map_anonymous(
+    (size_t) nb_threads * NH_ST_PAGES * NH_ST_PAGE_SIZE);
+}
+
+void NH_ST_thr_init(int tid)
+{
+  NH_ST_next_page = shadow_pool + (size_t) tid * NH_ST_PAGES * NH_ST_PAGE_SIZE;
+  NH_ST_end_page = NH_ST_next_page + (size_t) NH_ST_PAGES * NH_ST_PAGE_SIZE;
+}
+
+char *NH_ST_no_space()
+{
+  fprintf(stderr, "Out of shadow pages, increase NH_ST_PAGES!\n");
+  exit(EXIT_FAILURE);
+  return NULL;
+}
+
+#endif /* SOFTWARE_TRANSLATION */
@@ -0,0 +1,121 @@
+#include "cl_table.h"
+
+#include <cstdio>
+#include <cstring>
+
+// ################ defines
+
+#define MIN_SLOTS 64
+
+// ################ local functions
+
+static void alloc_slots(cl_table_s *t, uint64_t nb_slots);
+
+// ################ implementation header
+
+cl_table_s *cl_table_init(size_t nb_lines)
+{
+  cl_table_s *t = (cl_table_s*) malloc(sizeof (cl_table_s));
+  uint64_t nb_slots = MIN_SLOTS;
+
+  while (nb_slots < 2 * (uint64_t) nb_lines + CL_TABLE_GROUP) {
+    nb_slots <<= 1;
+  }
+
+  t->gen = 1; // tags are 0, all slots empty
+  t->nb_lines = 0;
+  alloc_slots(t, nb_slots);
+
+  return t;
+}
+
+void cl_table_destroy(cl_table_s *t)
+{
+  free(t->tags);
+  free(t->lines);
+  free(t);
+}
+
+void cl_table_clear(cl_table_s *t, size_t nb_lines)
+{
+  t->nb_lines = 0;
+
+  if (2 * (uint64_t) nb_lines + CL_TABLE_GROUP > t->nb_slots) {
+    uint64_t nb_slots = t->nb_slots;
+    while (nb_slots < 2 * (uint64_t) nb_lines + CL_TABLE_GROUP) {
+      nb_slots <<= 1;
+    }
+    free(t->tags);
+    free(t->lines);
+    t->gen = 1;
+    alloc_slots(t, nb_slots);
+    return;
+  }
+
+  t->gen++;
+  if (t->gen > CL_TABLE_MAX_GEN) {
+    // wrapped, the old tags could look current
+    memset(t->tags, 0, t->nb_slots * sizeof (uint64_t));
+    t->gen = 1;
+  }
+}
+
+void cl_table_grow(cl_table_s *t)
+{
+  uint64_t *old_tags = t->tags;
+  uintptr_t *old_lines = t->lines;
+  uint64_t old_nb_slots = t->nb_slots, i;
+  int nb_lines = t->nb_lines;
+
+  alloc_slots(t, 2 * old_nb_slots);
+
+  // the insertion order is kept
+  memcpy(t->lines, old_lines, nb_lines * sizeof (uintptr_t));
+  t->nb_lines = nb_lines;
+  free(old_lines);
+
+  for (i = 0; i < old_nb_slots; ++i) {
+    uint64_t tag = old_tags[i];
+    if (CL_TABLE_GEN(tag) != t->gen) continue;
+
+    uint64_t g = CL_TABLE_HOME(t, CL_TABLE_LINE(tag));
+    while (1) {
+      int j;
+      for (j = 0; j < CL_TABLE_GROUP; ++j) {
+        if (CL_TABLE_GEN(t->tags[g + j]) != t->gen) break;
+      }
+      if (j < CL_TABLE_GROUP) {
+        t->tags[g + j] = tag;
+        break;
+      }
+      g = (g + CL_TABLE_GROUP) & (t->nb_slots - 1);
+    }
+  }
+
+  free(old_tags);
+}
+
+// ################ implementation local functions
+
+static void alloc_slots(cl_table_s *t, uint64_t nb_slots)
+{
+  void *tags;
+  int log_slots = 0;
+  uint64_t s;
+
+  for (s = nb_slots; s > 1; s >>= 1) {
+    log_slots++;
+  }
+
+  // aligned to the SIMD loads of a group
+  if (posix_memalign(&tags, 64, nb_slots * sizeof (uint64_t)) != 0) {
+    perror("posix_memalign");
+    exit(EXIT_FAILURE);
+  }
+  memset(tags, 0, nb_slots * sizeof (uint64_t));
+
+  t->tags = (uint64_t*) tags;
+  t->lines = (uintptr_t*) malloc(nb_slots / 2 * sizeof (uintptr_t));
+  t->nb_slots = nb_slots;
+  t->log_slots = log_slots;
+}
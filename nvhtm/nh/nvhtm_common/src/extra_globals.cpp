@@ -6,9 +6,15 @@
 // global
 CL_ALIGN NVLog_s **NH_global_logs;
 void* LOG_global_ptr;
+NVLogMarkers_s **NH_global_markers;
+NVLogCtrl_s *NH_global_ctrl;
+volatile ts_s *NH_active_ts;
 int is_sigsegv = 0;
 // thread local
 __thread CL_ALIGN NVLog_s *nvm_htm_local_log;
 __thread CL_ALIGN int LOG_nb_wraps;
 __thread CL_ALIGN NVLogLocal_s LOG_local_state;
+#ifdef LOG_NT_APPEND
+__thread CL_ALIGN NVLogEntry_s LOG_staged[LOG_NT_STAGE];
+#endif /* LOG_NT_APPEND */
 // ####################################################
@@ -28,6 +28,10 @@
 #include <thread>
 #include <mutex>
 
+#if defined(LOG_NT_APPEND) && !defined(__powerpc__)
+#include <emmintrin.h>
+#endif
+
 /**
 * TODO: Set log size to power of 2, then use bitwise operations.
 */
@@ -126,7 +130,7 @@ void LOG_init(int nb_threads, int fresh)
     LOG_global_ptr = shmat(shmid, (void *)0, 0);
     fresh = 1; // this is not init to 0
 
-    if (LOG_global_ptr < 0) {
+    if (LOG_global_ptr == (void*) -1) {
       perror("shmat");
     }
     #else
@@ -139,6 +143,19 @@ void LOG_init(int nb_threads, int fresh)
     NVLog_s *new_log = NH_global_logs[i];
     init_log(new_log, i, fresh);
   }
+  if (NH_global_markers == NULL) {
+    // the forked checkpointer keeps the (shared) markers of the parent
+    LOG_AUX_markers_init(nb_threads);
+  }
+  if (NH_global_ctrl == NULL) {
+    LOG_CTRL_init(nb_threads);
+  }
+  if (NH_active_ts == NULL) {
+    LOG_ORDER_init(nb_threads);
+    #ifdef LOG_GROUP_COMMIT
+    LOG_GROUP_init(nb_threads);
+    #endif /* LOG_GROUP_COMMIT */
+  }
 
   sort_logs(); // TODO
   #if defined(SORT_ALG) && SORT_ALG == 4
@@ -165,6 +182,12 @@ void LOG_get_ts_before_tx(int tid)
   if (ts > NH_before_ts[tid]) {
     NH_before_ts[tid] = ts;
   }
+  LOG_ORDER_set(tid, NH_before_ts[tid]);
+}
+
+void LOG_idle_tx(int tid)
+{
+  LOG_ORDER_idle(tid);
 }
 
 void LOG_alloc(int tid, const char *pool_file, int fresh)
@@ -189,8 +212,17 @@ void LOG_alloc(int tid, const char *pool_file, int fresh)
 
 void LOG_thr_init(int tid)
 {
+  NVLogMarkers_s *mk = NH_global_markers[tid];
+  int node = TOPO_current_node();
+
   nvm_htm_local_log = NH_global_logs[tid];
   LOG_local_state.size_of_log = nvm_htm_local_log->size_of_log;
+
+  // only the owner writes the log, the checkpointer reads it per node
+  nvm_htm_local_log->node = node;
+  TOPO_bind_to_node(nvm_htm_local_log, NVMHTM_LOG_SIZE, node);
+  TOPO_bind_to_node(mk, CACHE_LINE_SIZE + mk->size * sizeof(NVLogMarker_s),
+    node);
 }
 
 void LOG_clear(int tid)
@@ -232,6 +264,30 @@ void LOG_push_malloc(int tid, GRANULE_TYPE *addr) {
   new_end = LOG_push_entry(log, entry);
 }
 
+#ifdef LOG_NT_APPEND
+void LOG_NT_write(NVLog_s *log, int pos, NVLogEntry_s *entries, int nb)
+{
+  int i;
+
+  for (i = 0; i < nb; ++i) {
+    NVLogEntry_s *entry = &(log->ptr[ptr_mod_log(pos, i)]);
+    #ifndef __powerpc__
+    // consecutive 8B stores fill the write-combining buffer of the line
+    _mm_stream_si64((long long*) &(entry->addr), (long long) entries[i].addr);
+    _mm_stream_si64((long long*) &(entry->value), (long long) entries[i].value);
+    #else /* __powerpc__ */
+    memcpy(entry, &(entries[i]), sizeof(NVLogEntry_s));
+    #endif /* __powerpc__ */
+  }
+
+  #ifndef __powerpc__
+  _mm_sfence();
+  #else /* __powerpc__ */
+  __sync_synchronize();
+  #endif /* __powerpc__ */
+}
+#endif /* LOG_NT_APPEND */
+
 int LOG_checkpoint_apply_one()
 {
   return LOG_AUX_apply_one_to_checkpoint(true, true, NULL);
@@ -43,7 +43,10 @@ using namespace std;
 
 // ################ types
 
-/* empty */
+typedef struct chkp_region_ {
+  uintptr_t begin, end;
+  long long int delta_to_pool; // in granules
+} chkp_region_s;
 
 // ################ variables
 //
@@ -62,6 +65,13 @@ CL_ALIGN cp_s *cp_instance;
 static CL_ALIGN mutex log_mtx;
 static CL_ALIGN int log_lock;
 
+extern mutex mtx; // from nvhtm_helper.cpp (protects instances)
+static vector<chkp_region_s> chkp_regions; // sorted by begin
+static int chkp_regions_version;
+
+static void *markers_pool; // shared with the forked checkpointer
+static size_t markers_pool_size;
+
 // ################ variables (thread-local)
 
 //__thread CL_ALIGN NVLog_s nvm_htm_local_log_inst; // DOESN'T WORK!!! why?
@@ -76,6 +86,9 @@ static inline ts_s first_ts(NVLog_s *log, int &entry_ptr);
 
 static int empty_to_sorted();
 static int check_correct_ts(int tid);
+static inline int marker_is_live(int tid, long long k, int start, int end);
+static inline void apply_entry(NVLogEntry_s entry, GRANULE_TYPE **base,
+  set<intptr_t> *to_flush, int do_flush);
 
 // ################ implementation header
 
@@ -88,12 +101,63 @@ void* LOG_AUX_apply_to_checkpoint(void *addr,
   return NULL;
 }
 
+void LOG_AUX_chkp_regions_update()
+{
+  map<void*, NVMHTM_mem_s*>::iterator it;
+
+  mtx.lock();
+  chkp_regions.clear();
+  for (it = instances.begin(); it != instances.end(); ++it) {
+    NVMHTM_mem_s *instance = it->second;
+    chkp_region_s region;
+
+    if (instance->chkp.ptr == NULL) continue;
+
+    region.begin = (uintptr_t) instance->ptr;
+    region.end = region.begin + instance->size;
+    region.delta_to_pool = instance->chkp.delta_to_pool;
+    chkp_regions.push_back(region); // map is sorted
+  }
+  chkp_regions_version++;
+  mtx.unlock();
+}
+
+GRANULE_TYPE *LOG_AUX_chkp_addr(GRANULE_TYPE *addr)
+{
+  // one entry cache, writes tend to hit the same pool
+  static __thread chkp_region_s last = { 0, 0, 0 };
+  static __thread int last_version = -1;
+  uintptr_t a = (uintptr_t) addr;
+  int lo = 0, hi = (int) chkp_regions.size() - 1;
+
+  if (last_version == chkp_regions_version
+    && a >= last.begin && a < last.end) {
+    return addr + last.delta_to_pool;
+  }
+
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (a < chkp_regions[mid].begin) {
+      hi = mid - 1;
+    } else if (a >= chkp_regions[mid].end) {
+      lo = mid + 1;
+    } else {
+      last = chkp_regions[mid];
+      last_version = chkp_regions_version;
+      return addr + last.delta_to_pool;
+    }
+  }
+
+  return addr; // not in a pool, the image is the address itself
+}
+
 // use maps
 int LOG_AUX_apply_one_to_checkpoint(int update_start,
   int do_flush, void *to_fl
 )
 {
   set<intptr_t> *to_flush = (set<intptr_t> *) to_fl;
+  GRANULE_TYPE *base;
 
   int i;
 
@@ -106,6 +170,7 @@ int LOG_AUX_apply_one_to_checkpoint(int update_start,
   // maps are sorted
   NVLog_s *smallest_log = sorted_logs.begin()->second;
   i = smallest_log->start;
+  base = NULL;
 
   while (i != smallest_log->end) {
 
@@ -141,15 +206,7 @@ int LOG_AUX_apply_one_to_checkpoint(int update_start,
     }
 
     if (entry_is_update(entry)) {
-      if (to_flush) {
-        // apply the flush lazily
-        intptr_t cl_addr = (intptr_t) entry.addr;
-        cl_addr >>= 6; // remove the log_2(CL_SIZE) bits (offset)
-        cl_addr <<= 6;
-        to_flush->insert(cl_addr);
-      }
-      // writes
-      LOG_AUX_apply_to_checkpoint(entry.addr, entry.value, do_flush);
+      apply_entry(entry, &base, to_flush, do_flush);
     }
 
     i = ptr_mod_log(i, 1);
@@ -178,6 +235,7 @@ int LOG_AUX_apply_one_to_checkpoint2(int update_start,
 )
 {
   set<intptr_t> *to_flush = (set<intptr_t> *) to_fl;
+  GRANULE_TYPE *base;
   int i;
 
 
@@ -195,6 +253,7 @@ int LOG_AUX_apply_one_to_checkpoint2(int update_start,
   NH_manager_order_logs += ts2 - ts1;
 
   i = smallest_log->start;
+  base = NULL;
   while (1/* i != smallest_log->end_last_tx */) {
     NVLogEntry_s entry = smallest_log->ptr[i];
     ts_s ts_val = entry_is_ts(entry);
@@ -207,15 +266,7 @@ int LOG_AUX_apply_one_to_checkpoint2(int update_start,
     }
 
     if (entry_is_update(entry)) {
-      if (to_flush) {
-        // apply the flush lazily
-        intptr_t cl_addr = (intptr_t) entry.addr;
-        cl_addr >>= 6; // remove the log_2(CL_SIZE) bits (offset)
-        cl_addr <<= 6;
-        to_flush->insert(cl_addr);
-      }
-      // writes
-      LOG_AUX_apply_to_checkpoint(entry.addr, entry.value, do_flush);
+      apply_entry(entry, &base, to_flush, do_flush);
     }
 
     i = ptr_mod_log(i, 1);
@@ -231,6 +282,7 @@ int LOG_AUX_apply_one_to_checkpoint3(int update_start,
 {
   static int next_log = 0;
   set<intptr_t> *to_flush = (set<intptr_t> *) to_fl;
+  GRANULE_TYPE *base;
   int i;
 
   ts_s ts1 = 0, ts2 = 0;
@@ -249,6 +301,7 @@ int LOG_AUX_apply_one_to_checkpoint3(int update_start,
   NH_manager_order_logs += ts2 - ts1;
 
   i = smallest_log->start;
+  base = NULL;
   while (i != smallest_log->end) {
     NVLogEntry_s entry = smallest_log->ptr[i];
     ts_s ts_val = entry_is_ts(entry);
@@ -261,15 +314,7 @@ int LOG_AUX_apply_one_to_checkpoint3(int update_start,
     }
 
     if (entry_is_update(entry)) {
-      if (to_flush) {
-        // apply the flush lazily
-        intptr_t cl_addr = (intptr_t) entry.addr;
-        cl_addr >>= 6; // remove the log_2(CL_SIZE) bits (offset)
-        cl_addr <<= 6;
-        to_flush->insert(cl_addr);
-      }
-      // writes
-      LOG_AUX_apply_to_checkpoint(entry.addr, entry.value, do_flush);
+      apply_entry(entry, &base, to_flush, do_flush);
     }
 
     i = ptr_mod_log(i, 1);
@@ -311,24 +356,10 @@ ts_s LOG_first_ts(int tid, int *entry_pos)
 ts_s LOG_last_ts(int tid)
 {
   NVLog_s *log = NH_global_logs[tid];
-  // log->end is not part of the log
-  int i = ptr_mod_log(log->end, -1);
+  long long mk_end = LOG_AUX_markers_end(tid);
+  long long k = LOG_AUX_marker_last(tid, mk_end, log->start, log->end);
 
-  while (i != log->start) {
-    ts_s ts_val = entry_is_ts(log->ptr[i]);
-    if (ts_val) {
-      return ts_val;
-    }
-    i = ptr_mod_log(i, -1);
-  }
-
-  // log->start is still part of the log
-  ts_s ts_val = entry_is_ts(log->ptr[i]);
-  if (ts_val) {
-    return ts_val;
-  }
-
-  return 0;
+  return k == -1 ? 0 : LOG_AUX_marker(tid, k)->ts;
 }
 
 int LOG_last_commit_idx(int tid)
@@ -354,8 +385,9 @@ int LOG_last_commit_idx(int tid)
 // pos is updated to that transaction (after the previous ts)
 ts_s LOG_AUX_next_ts(NVLog_s *log, ts_s ts, int *pos)
 {
-  int i = log->start, log_end = log->end;
-  ts_s res = 0;
+  int tid = log->tid;
+  long long mk_end = LOG_AUX_markers_end(tid), k, last;
+  int log_start = log->start, log_end = log->end, i = log_start;
 
   if (pos != NULL && *pos >= 0 && distance_ptr(i, log_end) >
   distance_ptr(*pos, log_end)) {
@@ -366,21 +398,23 @@ ts_s LOG_AUX_next_ts(NVLog_s *log, ts_s ts, int *pos)
     *pos = i;
   }
 
-  while (i != log_end) {
-    ts_s ts_val = entry_is_ts(log->ptr[i]);
-    if (ts_val && ts_val > ts) {
-      res = ts_val;
-      return res;
-    } else if (ts_val && ts_val <= ts && pos != NULL) {
-      *pos = ptr_mod_log(i, 1); // lets find the next ts
+  k = LOG_AUX_marker_first(tid, mk_end, log_start, log_end);
+  if (k != -1) {
+    last = LOG_AUX_marker_last(tid, mk_end, log_start, log_end);
+    k = LOG_AUX_marker_find(tid, k, last, log_start, i);
+    for (; k <= last; ++k) {
+      NVLogMarker_s *marker = LOG_AUX_marker(tid, k);
+      if (marker->ts > ts) {
+        return marker->ts;
+      } else if (pos != NULL) {
+        *pos = ptr_mod_log(marker->pos, 1); // lets find the next ts
+      }
     }
-
-    i = ptr_mod_log(i, 1);
   }
 
-  if (res == 0 && pos) *pos = -1;
+  if (pos) *pos = -1;
 
-  return res;
+  return 0;
 }
 
 ts_s LOG_next_tx_ts(int *pos, int* tid) {
@@ -541,6 +575,109 @@ int LOG_AUX_sort_logs()
   return 1;
 }
 
+void LOG_AUX_markers_init(int nb_threads)
+{
+  size_t size = 0;
+  char *aux_ptr;
+  int i;
+
+  if (markers_pool != NULL) {
+    munmap(markers_pool, markers_pool_size);
+    free(NH_global_markers);
+  }
+
+  for (i = 0; i < nb_threads; ++i) {
+    size += CACHE_LINE_SIZE + NH_global_logs[i]->size_of_log
+      * sizeof(NVLogMarker_s);
+  }
+
+  markers_pool = mmap(NULL, size, PROT_READ | PROT_WRITE,
+    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (markers_pool == MAP_FAILED) {
+    perror("mmap");
+    exit(EXIT_FAILURE);
+  }
+  markers_pool_size = size;
+
+  NH_global_markers = (NVLogMarkers_s**) malloc(nb_threads
+    * sizeof(NVLogMarkers_s*));
+  aux_ptr = (char*) markers_pool;
+  for (i = 0; i < nb_threads; ++i) {
+    NVLogMarkers_s *mk = (NVLogMarkers_s*) aux_ptr;
+    aux_ptr += CACHE_LINE_SIZE;
+    mk->end = mk->next = 0;
+    mk->size = NH_global_logs[i]->size_of_log;
+    mk->ptr = (NVLogMarker_s*) aux_ptr;
+    aux_ptr += mk->size * sizeof(NVLogMarker_s);
+    NH_global_markers[i] = mk;
+  }
+}
+
+void LOG_AUX_markers_rebuild(int tid)
+{
+  NVLog_s *log = NH_global_logs[tid];
+  NVLogMarkers_s *mk = NH_global_markers[tid];
+  int i, size = log->size_of_log;
+
+  for (i = log->start; i != log->end; i = ptr_mod(i, 1, size)) {
+    ts_s ts = entry_is_ts(log->ptr[i]);
+    if (ts) {
+      LOG_push_marker(tid, i, ts);
+    }
+  }
+  __atomic_store_n(&(mk->end), mk->next, __ATOMIC_RELEASE);
+}
+
+long long LOG_AUX_marker_first(int tid, long long mk_end, int start, int end)
+{
+  long long lo = mk_end - NH_global_markers[tid]->size, hi = mk_end - 1;
+
+  if (lo < 0) lo = 0;
+  if (hi < lo || !marker_is_live(tid, hi, start, end)) {
+    return -1;
+  }
+
+  // the older markers are truncated, the newer ones are live
+  while (lo < hi) {
+    long long mid = lo + (hi - lo) / 2;
+    if (marker_is_live(tid, mid, start, end)) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+
+  return lo;
+}
+
+long long LOG_AUX_marker_last(int tid, long long mk_end, int start, int end)
+{
+  if (mk_end == 0 || !marker_is_live(tid, mk_end - 1, start, end)) {
+    return -1;
+  }
+  return mk_end - 1;
+}
+
+long long LOG_AUX_marker_find(int tid, long long first, long long last,
+  int start, int pos)
+{
+  int size = NH_global_logs[tid]->size_of_log;
+  long long dist = LOG_DISTANCE2(start, pos, size);
+
+  // the live markers are in log order
+  last++;
+  while (first < last) {
+    long long mid = first + (last - first) / 2;
+    if (LOG_DISTANCE2(start, LOG_AUX_marker(tid, mid)->pos, size) < dist) {
+      first = mid + 1;
+    } else {
+      last = mid;
+    }
+  }
+
+  return first;
+}
+
 size_t LOG_base2_before(size_t size_of_log)
 {
   double new_exp = log((double)size_of_log) / log(2.0);
@@ -566,6 +703,7 @@ NVLog_s* LOG_init_1thread(void *log_pool, size_t max_size)
   new_log->ptr = (NVLogEntry_s*) aux_ptr;
   new_log->size_of_log = new_size_log;
   new_log->start = new_log->end = 0; // TODO: recovery
+  new_log->node = 0;
   aux_ptr += size_of_log;
 
   return new_log;
@@ -641,6 +779,43 @@ static int check_correct_ts(int tid)
   return 1;
 }
 
+// base is the first write of the TX (LOG_decode)
+static inline void apply_entry(NVLogEntry_s entry, GRANULE_TYPE **base,
+  set<intptr_t> *to_flush, int do_flush)
+{
+  NVLogEntry_s writes[2];
+  int j, nb_writes = LOG_decode(entry, base, writes);
+
+  for (j = 0; j < nb_writes; ++j) {
+    if (to_flush) {
+      // apply the flush lazily
+      intptr_t cl_addr = (intptr_t) writes[j].addr;
+      cl_addr >>= 6; // remove the log_2(CL_SIZE) bits (offset)
+      cl_addr <<= 6;
+      to_flush->insert(cl_addr);
+    }
+    // writes
+    LOG_AUX_apply_to_checkpoint(writes[j].addr, writes[j].value, do_flush);
+  }
+}
+
+// k was not truncated, i.e., its LOG_TS entry is still in [start, end)
+static inline int marker_is_live(int tid, long long k, int start, int end)
+{
+  NVLog_s *log = NH_global_logs[tid];
+  NVLogMarker_s m = *LOG_AUX_marker(tid, k);
+  int size = log->size_of_log;
+
+  if (m.pos < 0 || m.pos >= size || m.ts == 0) {
+    return 0;
+  }
+  if (LOG_DISTANCE2(start, m.pos, size) >= LOG_DISTANCE2(start, end, size)) {
+    return 0;
+  }
+  // the position may have been reused by a newer entry
+  return entry_is_ts(log->ptr[m.pos]) == m.ts;
+}
+
 static inline ts_s first_ts(int tid, int &entry_ptr)
 {
   NVLog_s *log = NH_global_logs[tid];
@@ -1,4 +1,6 @@
 #include "log.h"
+#include "utils.h"
+#include "cl_table.h"
 
 #include <map>
 #include <unordered_map>
@@ -9,61 +11,113 @@
 #include <thread>
 #include <mutex>
 #include <vector>
+#include <algorithm>
 #include <unistd.h>
+#include <pthread.h>
 
 using namespace std;
 
-// pos has an hint, return the next tx after the given ts
-static ts_s max_tx_after(NVLog_s *log, int start, ts_s target, int *pos)
+// with REAL_CHECKPOINT the writes go to the checkpoint pool and each dirty
+// line is written back once, else to the aux buffer and the flush is spin
+#ifdef REAL_CHECKPOINT
+#define CHKP_WRITE(addr, value) ({ \
+  GRANULE_TYPE *chkp_addr = LOG_AUX_chkp_addr(addr); \
+  MN_write(chkp_addr, &(value), sizeof(GRANULE_TYPE), 0); \
+})
+#define CHKP_FLUSH_LINE(cl_addr) \
+  MN_flush(LOG_AUX_chkp_addr(cl_addr), CACHE_LINE_SIZE, 1)
+#define CHKP_DRAIN() MN_drain()
+#else /* !REAL_CHECKPOINT */
+#define CHKP_WRITE(addr, value) \
+  MN_write(addr, &(value), sizeof(GRANULE_TYPE), 1)
+#define CHKP_FLUSH_LINE(cl_addr) \
+  MN_flush(cl_addr, CACHE_LINE_SIZE, 0)
+#define CHKP_DRAIN() /* empty */
+#endif /* REAL_CHECKPOINT */
+
+#ifndef CHKP_NB_THREADS
+#define CHKP_NB_THREADS 1
+#endif
+
+// log lines applied before the starts move (0 is the whole round)
+#ifndef CHKP_TRUNC_LINES
+#define CHKP_TRUNC_LINES 0
+#endif
+#define CHKP_TRUNC_ENTRIES \
+  (CHKP_TRUNC_LINES * (CACHE_LINE_SIZE / (int) sizeof(NVLogEntry_s)))
+
+#define CHKP_MAX_NODES 64
+#define CHKP_GATHER 0 // each node dedups the writes in its logs
+#define CHKP_APPLY  1 // each shard applies the writes of its lines
+
+// shard (checkpointer thread) that owns the cache line
+#define CHKP_SHARD(cl_addr, nb_shards) ({ \
+  uintptr_t cl = ((uintptr_t)(cl_addr)) >> 6; \
+  (int)((cl ^ (cl >> 17)) % (uintptr_t)(nb_shards)); \
+})
+
+// ################ types
+
+typedef struct chkp_tx_ {
+  ts_s ts;
+  int tid;
+  int begin; // first write
+  int end;   // the commit marker
+} chkp_tx_s;
+
+// newest write of a word in the logs of a node
+typedef struct chkp_write_ {
+  GRANULE_TYPE *addr;
+  GRANULE_TYPE value;
+  ts_s ts;
+} chkp_write_s;
+
+// ################ variables
+
+// number of threads applying the next checkpoint (the manager included)
+static int chkp_nb_threads = CHKP_NB_THREADS;
+static int chkp_nb_helpers; // launched helpers (they are never stopped)
+
+// current checkpoint, the TXs are sorted newest first, the shards apply
+// the chunk [chkp_first, chkp_last) of them
+static vector<chkp_tx_s> chkp_txs;
+static size_t chkp_first, chkp_last;
+static int chkp_nb_shards;
+static int chkp_size_hashmap;
+
+// with logs in more than one NUMA node, thread n first reads only the logs
+// of node n (newest first), then the shards merge these by TS
+static int chkp_nb_nodes; // 0 if the logs are not gathered per node
+static int chkp_phase;
+static vector<chkp_write_s> *chkp_node_writes[CHKP_MAX_NODES];
+
+// no destructors, the helpers are still waiting when the process exits
+static pthread_mutex_t chkp_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t chkp_cond = PTHREAD_COND_INITIALIZER;
+static volatile int chkp_round;
+static volatile int chkp_nb_done;
+
+// written lines of the shard, reused across checkpoints
+static __thread cl_table_s *chkp_table;
+
+// ################ local functions
+
+static void run_phase(int phase);
+static void run_shard(int shard);
+static int log_nodes();
+static void clear_table();
+static void gather_node(int node);
+static void apply_shard(int shard);
+static long long marker_below(int tid, long long first, long long k,
+  ts_s target_ts);
+static void launch_helpers(int nb_threads);
+static void helper_loop(int shard, int round);
+
+// ################ implementation header
+
+void LOG_checkpoint_backward_set_threads(int nb_threads)
 {
-  int hint = *pos;
-  for (; hint != start; hint = ptr_mod_log(hint, -1)) {
-    ts_s ts = entry_is_ts(log->ptr[hint]);
-    if (ts && ts <= target) {
-      *pos = ptr_mod_log(hint, -1); // updates for the next write
-      return ts;
-    }
-  }
-  *pos = start; // did not find
-  return 0;
-}
-
-// pos has an hint PER LOG (array), return the idx of the next log to apply
-static int max_next_log(int *pos, int starts[], int ends[])
-{
-  int i;
-  ts_s max_ts[TM_nb_threads];
-  ts_s disc_max;
-  int disc_max_pos;
-  int count_ends = 0;
-  for (i = 0; i < TM_nb_threads; ++i) {
-    max_ts[i] = 0;
-    NVLog_s *log = NH_global_logs[i];
-    ts_s ts = entry_is_ts(log->ptr[pos[i]]);
-    while (!ts && pos[i] != starts[i]) {
-      pos[i] = ptr_mod_log(pos[i], -1);
-      ts = entry_is_ts(log->ptr[pos[i]]);
-    }
-    if (pos[i] == starts[i]) {
-      count_ends++;
-    }
-    if (starts[i] != ends[i]) {
-      max_ts[i] = ts;
-    }
-  }
-  if (count_ends == TM_nb_threads) {
-    return -1; // no more transactions
-  }
-  disc_max = max_ts[0];
-  disc_max_pos = 0;
-  for (i = 1; i < TM_nb_threads; ++i) {
-    if (disc_max < max_ts[i]) {
-      // some ts may be 0 if log ended
-      disc_max = max_ts[i];
-      disc_max_pos = i;
-    }
-  }
-  return disc_max_pos;
+  chkp_nb_threads = nb_threads < 1 ? 1 : nb_threads;
 }
 
 // Apply log backwards and avoid repeated writes
@@ -71,7 +125,8 @@ int LOG_checkpoint_backward_apply_one()
 {
   // this function needs a huge refactoring!
   int i, j, targets[TM_nb_threads], size_hashmap = 0,
-  starts[TM_nb_threads], ends[TM_nb_threads];
+  starts[TM_nb_threads], ends[TM_nb_threads], pos_to_start[TM_nb_threads];
+  long long k, firsts[TM_nb_threads], lasts[TM_nb_threads];
   int log_start, log_end;
   bool too_full = false;
   bool too_empty = false;
@@ -81,24 +136,12 @@ int LOG_checkpoint_backward_apply_one()
 
   if (LOG_local_state.size_of_log == 0) LOG_local_state.size_of_log = NH_global_logs[0]->size_of_log;
 
-  typedef struct _CL_BLOCK {
-    char bit_map;
-  } CL_BLOCK;
-
   ///sem_wait(NH_chkp_sem);
   //*NH_checkpointer_state = 1; // doing checkpoint
   //__sync_synchronize();
 
-  // stores the possible repeated writes
-  unordered_map<GRANULE_TYPE*, CL_BLOCK> writes_map;
-  vector<GRANULE_TYPE*> writes_list;
-
-  writes_list.reserve(32000);
-  writes_map.reserve(32000);
-
   // find target ts, and the idx in the log
   ts_s target_ts = 0;
-  int pos[TM_nb_threads], pos_to_start[TM_nb_threads];
 
 	if (*NH_checkpointer_state == 2) {
 		goto FORCED_CHECKPOINT;
@@ -120,7 +163,6 @@ int LOG_checkpoint_backward_apply_one()
       too_full = true;
     }
     if (dist > APPLY_BACKWARD_VAL) {
-      j = ends[i];
       someone_passed = true;
     }
   }
@@ -138,42 +180,39 @@ FORCED_CHECKPOINT:
   // first find target_ts, then the remaining TSs
   // TODO: keep the minimum anchor
   for (i = 0; i < TM_nb_threads; ++i) {
+    long long mk_end = LOG_AUX_markers_end(i);
     log = NH_global_logs[i];
 
     starts[i] = log->start;
-    ends[i] = log->end;
+    ends[i] = log->end; // after mk_end, the markers are before it
+    firsts[i] = LOG_AUX_marker_first(i, mk_end, starts[i], ends[i]);
+    lasts[i] = LOG_AUX_marker_last(i, mk_end, starts[i], ends[i]);
 
     // TODO: check the size of the log
     size_t log_size = ptr_mod_log(ends[i], -starts[i]);
-    ts_s ts = 0;
-    // find target ts in this log
-    if (log_size <= APPLY_BACKWARD_VAL) {
-      j = ends[i];
-    } else {
-      j = ptr_mod_log(starts[i], APPLY_BACKWARD_VAL);
+
+    if (log_size == 0 || firsts[i] == -1) {
+      targets[i] = starts[i];
+      continue;
     }
 
-    // TODO: repeated code
-    for (; j != starts[i]; j = ptr_mod_log(j, -1)) {
-      NVLogEntry_s entry = log->ptr[j];
-      ts = entry_is_ts(entry);
-      if (ts && ((ts < target_ts) || !target_ts)) { // find minimum
-        target_ts = ts;
-        break;
-      }
+    // find target ts in this log (the TXs in the first LOG_APPLY_VAL)
+    k = lasts[i];
+    if (log_size > LOG_APPLY_VAL) {
+      k = LOG_AUX_marker_find(i, firsts[i], lasts[i], starts[i],
+        ptr_mod_log(starts[i], LOG_APPLY_VAL + 1)) - 1;
     }
+    k = marker_below(i, firsts[i], k, target_ts);
 
-    // if ts == 0 it means that we need to analyze more log
-    if (ts == 0) {
-      j = ends[i];
-      for (; j != starts[i]; j = ptr_mod_log(j, -1)) {
-        NVLogEntry_s entry = log->ptr[j];
-        ts = entry_is_ts(entry);
-        if (ts && ((ts < target_ts) || !target_ts)) { // find minimum
-          target_ts = ts;
-          break;
-        }
-      }
+    // if not found it means that we need to analyze more log
+    if (k == -1) {
+      k = marker_below(i, firsts[i], lasts[i], target_ts);
+    }
+
+    j = starts[i];
+    if (k != -1) {
+      target_ts = LOG_AUX_marker(i, k)->ts;
+      j = LOG_AUX_marker(i, k)->pos;
     }
 
     targets[i] = j;
@@ -191,139 +230,289 @@ FORCED_CHECKPOINT:
     // printf("s:%i t:%i e:%i \n", starts[i], targets[i], ends[i]);
   }
 
-  // other TSs smaller than target
-  // TODO: sweep from the threshold backward only
-  for (i = 0; i < TM_nb_threads; ++i) {
-    log = NH_global_logs[i];
-    ts_s ts = 0;
-    // find the maximum TS of other TXs smaller than target_ts
+  if (!target_ts) {
+    *NH_checkpointer_state = 0; // doing checkpoint
+    __sync_synchronize();
+    return 1; // there isn't enough transactions
+  }
 
-    // sizes[] has the target idx
-    pos[i] = targets[i]; // init with some default value
-    // if j == start (none TX has smaller TS) then pos_to_start must not be changed
+  // the TXs with TS <= target_ts are a prefix of each log
+  chkp_txs.clear();
+  for (i = 0; i < TM_nb_threads; ++i) {
+    int begin = starts[i];
     pos_to_start[i] = starts[i];
-
-    for (j = pos[i]; j != starts[i]; j = ptr_mod_log(j, -1)) {
-      NVLogEntry_s entry = log->ptr[j];
-      ts = entry_is_ts(entry);
-      if (ts && ts <= target_ts) {
-        // previous idx contains the write
-        pos[i] = j; // ptr_mod_log(j, -1);
-        if(j == ends[i]) {
-          pos_to_start[i] = j; // THERE IS SOME BUG HERE!
-        } else {
-          pos_to_start[i] = ptr_mod_log(j, 1); // THERE IS SOME BUG HERE!
-        }
-        break;
-      }
+    if (firsts[i] == -1) continue;
+    for (k = firsts[i]; k <= lasts[i]; ++k) {
+      NVLogMarker_s *marker = LOG_AUX_marker(i, k);
+      ts_s ts = marker->ts;
+      j = marker->pos;
+      if (ts > target_ts) break;
+      chkp_tx_s tx = { ts, i, begin, j };
+      chkp_txs.push_back(tx);
+      begin = ptr_mod_log(j, 1);
+      pos_to_start[i] = begin;
     }
   }
 
-  if (!target_ts) {
+  if (chkp_txs.empty()) {
     *NH_checkpointer_state = 0; // doing checkpoint
     __sync_synchronize();
     return 1; // there isn't enough transactions
   }
 
+  sort(chkp_txs.begin(), chkp_txs.end(),
+    [](const chkp_tx_s &a, const chkp_tx_s &b) { return a.ts > b.ts; });
+
   NH_nb_checkpoints++;
 
-  // find the write-set to apply to the checkpoint (Cache_lines!)
-  int next_log;
-  unsigned long long proc_writes = 0;
-
-  // ts_s time_ts1, time_ts2, time_ts3, time_ts4 = 0;
-  // time_ts1 = rdtscp();
-  writes_map.reserve(size_hashmap);
-  do {
-    // time_ts3 = rdtscp();
-    next_log = max_next_log(pos, starts, ends);
-    i = next_log;
-    if (next_log == -1) {
-      break;
+#ifdef REAL_CHECKPOINT
+  LOG_AUX_chkp_regions_update(); // pools may have been allocated
+#endif /* REAL_CHECKPOINT */
+
+  // the write-set is split by cache line, one shard per thread
+  chkp_nb_shards = chkp_nb_threads;
+  chkp_nb_nodes = log_nodes();
+  launch_helpers(chkp_nb_shards);
+
+  // oldest chunk first, the image is a prefix of the TXs after each one
+  // and the producers get its space back (CHKP_TRUNC_LINES)
+  for (chkp_last = chkp_txs.size(); chkp_last > 0; chkp_last = chkp_first) {
+    size_hashmap = 0;
+    chkp_first = chkp_last;
+    do {
+      chkp_tx_s *tx = &(chkp_txs[--chkp_first]);
+      size_hashmap += distance_ptr(tx->begin, tx->end) + 1;
+    } while (chkp_first > 0
+      && (CHKP_TRUNC_ENTRIES == 0 || size_hashmap < CHKP_TRUNC_ENTRIES));
+    chkp_size_hashmap = size_hashmap / chkp_nb_shards + 1;
+
+    if (chkp_nb_nodes > 0) {
+      run_phase(CHKP_GATHER);
     }
+    // the logs can only be truncated after all shards are durable
+    run_phase(CHKP_APPLY);
 
-    log = NH_global_logs[next_log];
+    // advance the pointers past the last marker of each log in the chunk
+    for (k = chkp_last; k > (long long) chkp_first; --k) {
+      chkp_tx_s *tx = &(chkp_txs[k - 1]);
+      starts[tx->tid] = ptr_mod_log(tx->end, 1);
+    }
+    for (i = 0; i < TM_nb_threads; ++i) {
+      log = NH_global_logs[i];
+      if (starts[i] == log->start) continue; // only this thread changes it
+      // either in the boundary or just cleared the log
+      assert(distance_ptr(starts[i], ends[i]) >=
+      distance_ptr(pos_to_start[i], ends[i]));
+
+      MN_write(&(log->start), &(starts[i]), sizeof(int), 0);
+    }
+  }
+  *NH_checkpointer_state = 0;
+  __sync_synchronize();
+  return 0;
+}
 
-    target_ts = max_tx_after(log, starts[next_log], target_ts, &(pos[next_log])); // updates the ptr
-    // time_ts4 += rdtscp() - time_ts3;
-    // advances to the next write after the TS
+// ################ implementation local functions
 
-    // pos[next_log] must be between start and end
-    if (pos[next_log] != starts[next_log]) {
-      pos[next_log] = ptr_mod_log(pos[next_log], -1);
-    } else {
-      // ended
-      break;
+// all the threads run the phase, returns when it is done
+static void run_phase(int phase)
+{
+  chkp_phase = phase;
+
+  if (chkp_nb_shards > 1) {
+    pthread_mutex_lock(&chkp_mtx);
+    chkp_nb_done = 0;
+    chkp_round++;
+    pthread_cond_broadcast(&chkp_cond);
+    pthread_mutex_unlock(&chkp_mtx);
+  }
+
+  run_shard(0);
+
+  while (chkp_nb_done < chkp_nb_shards - 1) {
+    PAUSE();
+  }
+  __sync_synchronize();
+}
+
+static void run_shard(int shard)
+{
+  if (chkp_phase == CHKP_APPLY) {
+    apply_shard(shard);
+  } else if (shard < chkp_nb_nodes) {
+    gather_node(shard);
+  }
+}
+
+// nodes to gather, there must be a thread per node
+static int log_nodes()
+{
+  int i, nb_nodes = 0;
+
+  for (i = 0; i < TM_nb_threads; ++i) {
+    nb_nodes = max(nb_nodes, NH_global_logs[i]->node + 1);
+  }
+
+  return nb_nodes > 1 && nb_nodes <= chkp_nb_shards
+    && nb_nodes <= CHKP_MAX_NODES ? nb_nodes : 0;
+}
+
+static void clear_table()
+{
+  if (chkp_table == NULL) {
+    chkp_table = cl_table_init(chkp_size_hashmap);
+  } else {
+    cl_table_clear(chkp_table, chkp_size_hashmap);
+  }
+}
+
+// calls fn(addr, value) for the writes of the TX, newest first
+template <typename F>
+static inline void tx_writes(chkp_tx_s *tx, F fn)
+{
+  NVLog_s *log = NH_global_logs[tx->tid];
+  int pos = tx->end, k, nb_writes;
+  NVLogEntry_s writes[2];
+#ifdef LOG_COMPACT
+  GRANULE_TYPE *base = LOG_tx_base(log, tx->begin, tx->end);
+#else /* !LOG_COMPACT */
+  GRANULE_TYPE *base = NULL;
+#endif /* LOG_COMPACT */
+
+  // within a TX the last write to a word wins as well
+  while (pos != tx->begin) {
+    pos = ptr_mod_log(pos, -1);
+    NVLogEntry_s entry = log->ptr[pos];
+
+    if (!entry_is_update(entry)) {
+      continue;
     }
 
-    // within the start/end boundary
-    assert((starts[i] <= ends[i] && pos[i] >= starts[i] &&
-      pos[i] <= ends[i]) || (starts[i] > ends[i] &&
-        ((pos[i] >= 0 && pos[i] < starts[i]) ||
-        (pos[i] < LOG_local_state.size_of_log && pos[i] > ends[i]))
-      )
-    );
+    nb_writes = LOG_decode(entry, &base, writes);
+    for (k = nb_writes - 1; k >= 0; --k) {
+      fn(writes[k].addr, writes[k].value);
+    }
+  }
+}
 
-    NVLogEntry_s entry = log->ptr[pos[next_log]];
-    ts_s ts = entry_is_ts(entry);
-    while (!ts && pos[next_log] != starts[next_log]) {
-
-      // uses only the bits needed to identify the cache line
-      intptr_t cl_addr = (((intptr_t)entry.addr >> 6) << 6);
-      auto it = writes_map.find((GRANULE_TYPE*)cl_addr);
-      int val_idx = ((intptr_t)entry.addr & 0x38) >> 3; // use bits 4,5,6
-      char bit_map = 1 << val_idx;
-      if (it == writes_map.end()) {
-        // not found the write --> insert it
-        CL_BLOCK block;
-        block.bit_map = bit_map;
-        /*block.block[val_idx] = entry.value;*/
-        auto to_insert = make_pair((GRANULE_TYPE*)cl_addr, block);
-        writes_map.insert(to_insert);
-        writes_list.push_back((GRANULE_TYPE*)cl_addr);
-        MN_write(entry.addr, &(entry.value), sizeof(GRANULE_TYPE), 1);
-      } else {
-        if ( !(it->second.bit_map & bit_map) ) {
-          // Need to write this word
-          MN_write(entry.addr, &(entry.value), sizeof(GRANULE_TYPE), 1);
-          it->second.bit_map |= bit_map;
+// the newest write of each word in the logs of the node (local reads)
+static void gather_node(int node)
+{
+  size_t i;
+
+  if (chkp_node_writes[node] == NULL) {
+    chkp_node_writes[node] = new vector<chkp_write_s>(); // first touch
+  }
+  vector<chkp_write_s> *node_writes = chkp_node_writes[node];
+
+  node_writes->clear();
+  clear_table();
+
+  for (i = chkp_first; i < chkp_last; ++i) {
+    chkp_tx_s *tx = &(chkp_txs[i]);
+    if (NH_global_logs[tx->tid]->node != node) continue;
+    tx_writes(tx, [&](GRANULE_TYPE *addr, GRANULE_TYPE value) {
+      if (cl_table_add_word(chkp_table, addr)) {
+        chkp_write_s w = { addr, value, tx->ts };
+        node_writes->push_back(w);
+      }
+    });
+  }
+}
+
+// applies the writes of the lines owned by the shard, newest first
+static void apply_shard(int shard)
+{
+  size_t i, idx[CHKP_MAX_NODES];
+  int j, n;
+  auto apply_write = [&](GRANULE_TYPE *addr, GRANULE_TYPE value) {
+    if (chkp_nb_shards > 1 && CHKP_SHARD(addr, chkp_nb_shards) != shard) {
+      return;
+    }
+    // only the newest write of each word
+    if (cl_table_add_word(chkp_table, addr)) {
+      CHKP_WRITE(addr, value);
+    }
+  };
+
+  clear_table();
+
+  if (chkp_nb_nodes == 0) {
+    for (i = chkp_first; i < chkp_last; ++i) {
+      tx_writes(&(chkp_txs[i]), apply_write);
+    }
+  } else {
+    // merges the (newest first) writes of the nodes
+    for (n = 0; n < chkp_nb_nodes; ++n) {
+      idx[n] = 0;
+    }
+    while (1) {
+      chkp_write_s *w = NULL;
+      int best = -1;
+      for (n = 0; n < chkp_nb_nodes; ++n) {
+        vector<chkp_write_s> *node_writes = chkp_node_writes[n];
+        if (idx[n] < node_writes->size()
+          && (w == NULL || (*node_writes)[idx[n]].ts > w->ts)) {
+          w = &((*node_writes)[idx[n]]);
+          best = n;
         }
       }
+      if (w == NULL) break;
+      idx[best]++;
+      apply_write(w->addr, w->value);
+    }
+  }
 
-      pos[next_log] = ptr_mod_log(pos[next_log], -1);
-      entry = log->ptr[pos[next_log]];
-      ts = entry_is_ts(entry);
+  // flushes the changes (the table lists each cache line once)
+  for (j = 0; j < chkp_table->nb_lines; ++j) {
+    CHKP_FLUSH_LINE((GRANULE_TYPE*) chkp_table->lines[j]);
+  }
+  CHKP_DRAIN(); // the checkpoint is durable before the logs are truncated
+}
+
+// newest marker in [first, k] with a TS smaller than target_ts (if set)
+static long long marker_below(int tid, long long first, long long k,
+  ts_s target_ts)
+{
+  for (; k >= first; --k) {
+    ts_s ts = LOG_AUX_marker(tid, k)->ts;
+    if (!target_ts || ts < target_ts) {
+      return k;
     }
-    // NH_nb_applied_txs++;
-  } while (next_log != -1);
-
-  // flushes the changes
-  auto cl_iterator = writes_list.begin();
-  // auto cl_it_end = writes_list.end();
-  for (; cl_iterator != writes_list.end(); ++cl_iterator) {
-    // TODO: must write the cache line, now is just spinning
-    GRANULE_TYPE *addr = *cl_iterator;
-    MN_flush(addr, CACHE_LINE_SIZE, 0);
   }
+  return -1;
+}
 
-  // advance the pointers
-  //    int freed_space = 0;
-  for (i = 0; i < TM_nb_threads; ++i) {
-    log = NH_global_logs[i];
-    //        freed_space += distance_ptr(log->start, pos_to_start[i]);
-    assert(starts[i] == log->start); // only this thread changes this
-    // either in the boundary or just cleared the log
-    assert((distance_ptr(starts[i], ends[i]) >=
-    distance_ptr(pos_to_start[i], ends[i]))
-    || (ptr_mod_log(ends[i], 1) == pos_to_start[i] ));
-    //            printf("s:%i t:%i e:%i d1:%i d2:%i \n", starts[i], pos_to_start[i], ends[i],
-    //                   distance_ptr(starts[i], ends[i]), distance_ptr(pos_to_start[i], ends[i]));
-
-    MN_write(&(log->start), &(pos_to_start[i]), sizeof(int), 0);
-    // log->start = pos_to_start[i];
-    // TODO: snapshot the old ptrs before moving them
+// lazy, in the forked checkpointer the helpers are created in the child
+static void launch_helpers(int nb_threads)
+{
+  while (chkp_nb_helpers < nb_threads - 1) {
+    chkp_nb_helpers++;
+    thread(helper_loop, chkp_nb_helpers, chkp_round).detach();
+  }
+}
+
+// round is the last one started before the helper existed
+static void helper_loop(int shard, int round)
+{
+  // gathers the logs of node shard (if any), see CHKP_SHARD_CPU
+  set_affinity_at(CHKP_SHARD_CPU(shard));
+  MN_thr_enter();
+  LOG_local_state.size_of_log = NH_global_logs[0]->size_of_log;
+
+  while (1) {
+    pthread_mutex_lock(&chkp_mtx);
+    while (chkp_round == round) {
+      pthread_cond_wait(&chkp_cond, &chkp_mtx);
+    }
+    round = chkp_round;
+    pthread_mutex_unlock(&chkp_mtx);
+
+    if (shard >= chkp_nb_shards) {
+      continue; // the pool was shrunk
+    }
+
+    run_shard(shard);
+    __sync_fetch_and_add(&chkp_nb_done, 1);
   }
-  *NH_checkpointer_state = 0;
-  __sync_synchronize();
-  return 0;
 }
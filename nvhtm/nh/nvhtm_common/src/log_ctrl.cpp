@@ -0,0 +1,151 @@
+#include "log.h"
+#include "log_ctrl.h"
+
+#include "rdtsc.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <sys/mman.h>
+
+using namespace std;
+
+// ################ defines
+
+// calm rounds before the thresholds back off
+#define CALM_ROUNDS 8
+// bounds of WAIT_DISTANCE (a log abort doubles it)
+#define MIN_WAIT_DISTANCE 32
+#define MAX_WAIT_DISTANCE(size_of_log) ((size_of_log) / 4)
+// weight of the new sample in the moving averages
+#define EWMA_NEW 0.25
+
+// ################ variables (only the checkpointer updates them)
+
+static ts_s last_time, round_time;
+static ts_s last_blocked;
+static long long last_aborts;
+static int *last_ends;
+static double fill_rate; // entries per clock of the fastest log
+static int calm_rounds;
+
+// ################ local functions
+
+static void retune(int pressure, int log_aborts, ts_s period);
+
+// ################ implementation header
+
+void LOG_CTRL_init(int nb_threads)
+{
+  size_t size = CACHE_LINE_SIZE + nb_threads * sizeof(NVLogCtrlThr_s);
+  int size_of_log = NH_global_logs[0]->size_of_log;
+  char *pool;
+
+  pool = (char*) mmap(NULL, size, PROT_READ | PROT_WRITE,
+    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (pool == MAP_FAILED) {
+    perror("mmap");
+    exit(EXIT_FAILURE);
+  }
+
+  // mmap memory is zeroed
+  NH_global_ctrl = (NVLogCtrl_s*) pool;
+  NH_global_ctrl->trigger = APPLY_BACKWARD_INIT(size_of_log);
+#if DO_CHECKPOINT == 2
+  // the reactive checkpoint frees LOG_THRESHOLD of the log (log.h)
+  NH_global_ctrl->apply = (int) ((double) size_of_log * LOG_THRESHOLD);
+#else /* DO_CHECKPOINT != 2 */
+  NH_global_ctrl->apply = APPLY_BACKWARD_INIT(size_of_log);
+#endif /* DO_CHECKPOINT */
+  NH_global_ctrl->too_empty = TOO_EMPTY_INIT;
+  NH_global_ctrl->wait_distance = WAIT_DISTANCE_INIT(size_of_log);
+  NH_global_ctrl->thrs = (NVLogCtrlThr_s*) (pool + CACHE_LINE_SIZE);
+}
+
+void LOG_CTRL_update()
+{
+  ts_s now = rdtscp(), blocked = 0, period;
+  long long aborts = 0;
+  int i, max_fill = 0;
+
+  if (last_ends == NULL) {
+    last_ends = (int*) malloc(TM_nb_threads * sizeof(int));
+    for (i = 0; i < TM_nb_threads; ++i) {
+      last_ends[i] = NH_global_logs[i]->end;
+    }
+    last_time = now;
+    return;
+  }
+
+  for (i = 0; i < TM_nb_threads; ++i) {
+    int end = NH_global_logs[i]->end;
+    // a log cannot wrap over its start, then this is what was written
+    max_fill = max(max_fill, (int) distance_ptr(last_ends[i], end));
+    last_ends[i] = end;
+    blocked += NH_global_ctrl->thrs[i].time_blocked;
+    aborts += NH_global_ctrl->thrs[i].nb_log_aborts;
+  }
+
+  period = now - last_time;
+  last_time = now;
+  if (period > 0) {
+    fill_rate = (1.0 - EWMA_NEW) * fill_rate
+      + EWMA_NEW * (double) max_fill / (double) period;
+  }
+
+  retune(blocked > last_blocked || aborts > last_aborts,
+    aborts > last_aborts, period);
+
+  last_blocked = blocked;
+  last_aborts = aborts;
+}
+
+void LOG_CTRL_round(ts_s duration)
+{
+  round_time = (ts_s) ((1.0 - EWMA_NEW) * (double) round_time
+    + EWMA_NEW * (double) duration);
+}
+
+// ################ implementation local functions
+
+static void retune(int pressure, int log_aborts, ts_s period)
+{
+  int size_of_log = LOG_local_state.size_of_log;
+  int min_val = size_of_log / 64, max_trigger, min_apply;
+  int trigger = NH_global_ctrl->trigger, apply = NH_global_ctrl->apply;
+  int wait_distance = NH_global_ctrl->wait_distance;
+
+  if (pressure) {
+    // workers waited for log: start earlier, free more
+    trigger -= trigger / 4;
+    apply += apply / 2;
+    // TXs found less free log than they write: keep more before each TX
+    if (log_aborts) wait_distance *= 2;
+    calm_rounds = 0;
+  } else if (++calm_rounds >= CALM_ROUNDS) {
+    trigger += size_of_log / 32;
+    apply -= apply / 8;
+    wait_distance -= wait_distance / 8;
+    calm_rounds = 0;
+  }
+
+  wait_distance = max(MIN_WAIT_DISTANCE,
+    min(wait_distance, MAX_WAIT_DISTANCE(size_of_log)));
+  NH_global_ctrl->wait_distance = wait_distance;
+
+  // the workers must not fill the log while a round runs
+  max_trigger = size_of_log - WAIT_DISTANCE
+    - (int) min((double) size_of_log, 2.0 * fill_rate * (double) round_time);
+  // keep up with the fastest log until the next round
+  min_apply = (int) min((double) size_of_log,
+    fill_rate * (double) period);
+
+  trigger = max(min_val, min(trigger, max_trigger));
+  apply = max(min_val, min(max(apply, min_apply),
+    size_of_log - WAIT_DISTANCE));
+
+  NH_global_ctrl->trigger = trigger;
+  NH_global_ctrl->apply = apply;
+  NH_global_ctrl->too_empty = min(TOO_EMPTY_INIT, trigger / 4);
+  __sync_synchronize();
+}
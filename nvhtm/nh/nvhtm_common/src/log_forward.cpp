@@ -12,6 +12,10 @@
 
 using namespace std;
 
+#define CP_BATCH 64
+
+extern CL_ALIGN cp_s *cp_instance;
+
 int LOG_checkpoint_forward()
 {
   return LOG_checkpoint_forward_apply_one(true, true, NULL);
@@ -23,6 +27,21 @@ static unordered_set<uintptr_t> buffered_cls; // TODO: uses unordered_set
 
 #define BUFFERING_THRESHOLD 0.5
 
+// locations taken from cp_instance but not applied yet
+static NVLogLocation_s pending_locs[CP_BATCH];
+static int nb_pending, next_pending;
+
+static int next_location(NVLogLocation_s *loc)
+{
+  if (next_pending == nb_pending) {
+    nb_pending = cp_consume_batch(cp_instance, pending_locs, CP_BATCH);
+    next_pending = 0;
+    if (nb_pending == 0) return 0;
+  }
+  *loc = pending_locs[next_pending++];
+  return 1;
+}
+
 static void move_ptrs()
 {
   int i;
@@ -58,6 +77,7 @@ int LOG_checkpoint_forward_apply_one(int, int do_flush,  void *to_fl)
   int log_start, log_end;
   int dist, threshold, entries_threshold;
   NVLog_s* log, *smallest_log;
+  GRANULE_TYPE *base;
   int tid = -1;
   ts_s next_ts;
   bool too_full = false;
@@ -140,7 +160,7 @@ int LOG_checkpoint_forward_apply_one(int, int do_flush,  void *to_fl)
   }
 
   // consume from buffer
-  if (!cp_consume(NULL, &loc)) {
+  if (!next_location(&loc)) {
     return 1;
   }
 
@@ -152,6 +172,7 @@ int LOG_checkpoint_forward_apply_one(int, int do_flush,  void *to_fl)
   log_end = smallest_log->end;
 
   i = snapshot_start_ptrs[tid]; // buffered new start pointers
+  base = NULL; // i is the beginning of a TX
 
   // ts2 = rdtscp();
   // NH_manager_order_logs += ts2 - ts1;
@@ -182,9 +203,13 @@ int LOG_checkpoint_forward_apply_one(int, int do_flush,  void *to_fl)
     }
 
     if (entry_is_update(entry)) {
-      uintptr_t addr = (((uintptr_t)entry.addr) >> 6);
-      buffered_cls.insert(addr);
-      MN_write(entry.addr, &(entry.value), sizeof(GRANULE_TYPE), 1);
+      NVLogEntry_s writes[2];
+      int j, nb_writes = LOG_decode(entry, &base, writes);
+      for (j = 0; j < nb_writes; ++j) {
+        uintptr_t addr = (((uintptr_t)writes[j].addr) >> 6);
+        buffered_cls.insert(addr);
+        MN_write(writes[j].addr, &(writes[j].value), sizeof(GRANULE_TYPE), 1);
+      }
       // -----------
       // comment to new
       // SPIN_PER_WRITE(1); // flushes right away
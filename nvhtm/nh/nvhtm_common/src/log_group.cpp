@@ -0,0 +1,122 @@
+#include "log.h"
+#include "log_group.h"
+
+#include "rdtsc.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sched.h>
+
+// ################ types
+
+typedef struct group_req_ {
+  volatile ts_s ts; // posted ts, 0 if none
+  volatile int is_durable;
+  uintptr_t marker_line; // of the LOG_TS, in the log of the thread
+} __attribute__((aligned(CACHE_LINE_SIZE))) group_req_s;
+
+// ################ variables
+
+static group_req_s *reqs;
+static int nb_reqs;
+static CL_ALIGN volatile int group_lock;
+static long long nb_groups, nb_grouped_txs; // updated by the leader
+
+// ################ local functions
+
+static void combine(ts_s ts);
+
+// ################ implementation header
+
+void LOG_GROUP_init(int nb_threads)
+{
+  nb_reqs = nb_threads;
+  if (posix_memalign((void**) &reqs, CACHE_LINE_SIZE,
+      nb_reqs * sizeof (group_req_s)) != 0) {
+    perror("posix_memalign");
+    exit(EXIT_FAILURE);
+  }
+  memset((void*) reqs, 0, nb_reqs * sizeof (group_req_s));
+}
+
+void LOG_GROUP_commit(int tid, ts_s ts)
+{
+  NVLog_s *log = NH_global_logs[tid];
+  int spins = 0;
+
+  reqs[tid].marker_line =
+    (uintptr_t) &(log->ptr[log->end_last_tx]) / CACHE_LINE_SIZE;
+  reqs[tid].is_durable = 0;
+  reqs[tid].ts = ts;
+  __sync_synchronize();
+
+  while (!reqs[tid].is_durable) {
+    if (group_lock == 0 && __sync_bool_compare_and_swap(&group_lock, 0, 1)) {
+      combine(ts);
+      group_lock = 0;
+      __sync_synchronize();
+      if (reqs[tid].is_durable) break;
+    }
+    // the leader, or the TX before the group, may be preempted
+    if (++spins < LOG_ORDER_SPINS) {
+      PAUSE();
+    } else {
+      sched_yield();
+    }
+  }
+}
+
+void LOG_GROUP_stats(long long *groups, long long *txs)
+{
+  *groups = nb_groups;
+  *txs = nb_grouped_txs;
+}
+
+// ################ implementation local functions
+
+static void combine(ts_s ts)
+{
+  ts_s frontier = LOG_ORDER_IDLE;
+  int group[nb_reqs];
+  int i, j, nb_group = 0, nb_lines = 0;
+
+  // gives the others some time to post
+  while (rdtscp() - ts < LOG_GROUP_WINDOW) PAUSE();
+
+  // a thread that posts later has its slot at or below its ts
+  for (i = 0; i < nb_reqs; ++i) {
+    if (reqs[i].ts == 0) {
+      ts_s slot = NH_active_ts[i];
+      if (slot < frontier) frontier = slot;
+    }
+  }
+
+  for (i = 0; i < nb_reqs; ++i) {
+    ts_s posted = reqs[i].ts;
+    if (posted != 0 && posted < frontier) {
+      group[nb_group++] = i;
+    }
+  }
+
+  if (nb_group == 0) {
+    return; // a TX that did not post is before all of them
+  }
+
+  // the markers of the group, one flush per line and a single fence
+  for (i = 0; i < nb_group; ++i) {
+    for (j = 0; j < i; ++j) {
+      if (reqs[group[j]].marker_line == reqs[group[i]].marker_line) break;
+    }
+    if (j == i) nb_lines++;
+  }
+  SPIN_PER_WRITE(nb_lines);
+  __sync_synchronize();
+
+  for (i = 0; i < nb_group; ++i) {
+    reqs[group[i]].ts = 0;
+    reqs[group[i]].is_durable = 1;
+  }
+  nb_groups++;
+  nb_grouped_txs += nb_group;
+}
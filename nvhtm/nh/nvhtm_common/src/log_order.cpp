@@ -0,0 +1,91 @@
+#include "log.h"
+#include "log_order.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <sched.h>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif /* __AVX2__ */
+
+// ################ variables
+
+static int nb_slots; // multiple of LOG_ORDER_GROUP
+
+// ################ implementation header
+
+void LOG_ORDER_init(int nb_threads)
+{
+  int i;
+
+  nb_slots = (nb_threads + LOG_ORDER_GROUP - 1) & ~(LOG_ORDER_GROUP - 1);
+  if (posix_memalign((void**) &NH_active_ts, CACHE_LINE_SIZE,
+      nb_slots * sizeof (ts_s)) != 0) {
+    perror("posix_memalign");
+    exit(EXIT_FAILURE);
+  }
+
+  for (i = 0; i < nb_slots; ++i) {
+    NH_active_ts[i] = LOG_ORDER_IDLE;
+  }
+}
+
+ts_s LOG_ORDER_min()
+{
+  ts_s res = LOG_ORDER_IDLE;
+  int i;
+
+  #ifdef __AVX2__
+  __m256i min4 = _mm256_set1_epi64x(LOG_ORDER_IDLE);
+  ts_s mins[4] __attribute__((aligned(32)));
+
+  for (i = 0; i < nb_slots; i += 4) {
+    __m256i slots = _mm256_load_si256((__m256i*) &(NH_active_ts[i]));
+    min4 = _mm256_blendv_epi8(min4, slots, _mm256_cmpgt_epi64(min4, slots));
+  }
+  _mm256_store_si256((__m256i*) mins, min4);
+  for (i = 0; i < 4; ++i) {
+    if (mins[i] < res) res = mins[i];
+  }
+  #else /* !__AVX2__ */
+  for (i = 0; i < nb_slots; ++i) {
+    ts_s slot = NH_active_ts[i];
+    if (slot < res) res = slot;
+  }
+  #endif /* __AVX2__ */
+
+  return res;
+}
+
+void LOG_ORDER_wait(ts_s ts)
+{
+  int frontier[nb_slots];
+  int i, nb_frontier = 0, spins = 0;
+
+  if (LOG_ORDER_min() >= ts) {
+    return; // nothing in flight before ts
+  }
+
+  for (i = 0; i < nb_slots; ++i) {
+    if (NH_active_ts[i] < ts) {
+      frontier[nb_frontier++] = i;
+    }
+  }
+
+  // the other slots never go below ts
+  while (nb_frontier > 0) {
+    for (i = 0; i < nb_frontier;) {
+      if (NH_active_ts[frontier[i]] >= ts) {
+        frontier[i] = frontier[--nb_frontier];
+      } else {
+        ++i;
+      }
+    }
+    if (++spins < LOG_ORDER_SPINS) {
+      PAUSE();
+    } else {
+      sched_yield();
+    }
+  }
+}
@@ -0,0 +1,267 @@
+#include "log.h"
+#include "log_recover.h"
+
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <thread>
+#include <pthread.h>
+
+using namespace std;
+
+// ################ types
+
+typedef struct rec_tx_ {
+  ts_s ts;
+  int tid;
+  int begin; // first write
+  int end;   // the commit marker (not included)
+} rec_tx_s;
+
+// orders the heads of the logs in the merge (smallest TS on top)
+struct rec_tx_cmp {
+  bool operator()(const rec_tx_s &a, const rec_tx_s &b) const {
+    return a.ts > b.ts;
+  }
+};
+
+// ################ variables
+
+static int nb_workers;
+static pthread_barrier_t rec_barrier;
+
+static vector<rec_tx_s> *txs_per_log; // committed TXs of each log
+static int *committed_end;            // after the last commit marker
+static vector<rec_tx_s> merged_txs;   // all TXs sorted by TS
+static vector<size_t> chunk_begin;    // split of merged_txs per worker
+
+// buckets[from][to] has the writes of the chunk of "from" that belong to
+// the cache lines of "to", in TS order
+static vector<NVLogEntry_s> **buckets;
+static long long *replayed_bytes;
+
+// ################ local functions
+
+#define REC_CL_HASH(addr) ({ \
+  uintptr_t cl = ((uintptr_t)(addr)) >> 6; \
+  (int)((cl ^ (cl >> 17)) % (uintptr_t)nb_workers); \
+})
+
+static void scan_logs(int wid);
+static void merge_logs();
+static void shuffle_writes(int wid);
+static void apply_writes(int wid);
+static void truncate_logs(int wid);
+static void *recover_worker(void *arg);
+
+// ################ implementation header
+
+long long LOG_recover(int workers)
+{
+  vector<thread> threads;
+  long long res = 0;
+  int i;
+
+  if (NH_global_logs == NULL || TM_nb_threads == 0) {
+    return 0;
+  }
+
+  nb_workers = workers < 1 ? 1 : workers;
+
+  LOG_AUX_chkp_regions_update();
+
+  txs_per_log = new vector<rec_tx_s>[TM_nb_threads];
+  committed_end = new int[TM_nb_threads];
+  replayed_bytes = new long long[nb_workers];
+  buckets = new vector<NVLogEntry_s>*[nb_workers];
+  for (i = 0; i < nb_workers; ++i) {
+    buckets[i] = new vector<NVLogEntry_s>[nb_workers];
+    replayed_bytes[i] = 0;
+  }
+
+  pthread_barrier_init(&rec_barrier, NULL, nb_workers);
+  for (i = 1; i < nb_workers; ++i) {
+    threads.push_back(thread(recover_worker, (void*)(intptr_t)i));
+  }
+  recover_worker((void*)0);
+  for (i = 0; i < (int)threads.size(); ++i) {
+    threads[i].join();
+  }
+  pthread_barrier_destroy(&rec_barrier);
+
+  for (i = 0; i < nb_workers; ++i) {
+    res += replayed_bytes[i];
+    delete [] buckets[i];
+  }
+  delete [] buckets;
+  delete [] replayed_bytes;
+  delete [] committed_end;
+  delete [] txs_per_log;
+  merged_txs.clear();
+  chunk_begin.clear();
+
+  return res;
+}
+
+// ################ implementation local functions
+
+static void *recover_worker(void *arg)
+{
+  int wid = (int)(intptr_t) arg;
+
+  LOG_local_state.size_of_log = NH_global_logs[0]->size_of_log;
+
+  scan_logs(wid);
+  pthread_barrier_wait(&rec_barrier);
+
+  if (wid == 0) merge_logs();
+  pthread_barrier_wait(&rec_barrier);
+
+  shuffle_writes(wid);
+  pthread_barrier_wait(&rec_barrier);
+
+  apply_writes(wid);
+  pthread_barrier_wait(&rec_barrier);
+
+  truncate_logs(wid);
+
+  return NULL;
+}
+
+// each worker finds the committed TXs of the logs i, i+W, i+2W, ...
+static void scan_logs(int wid)
+{
+  int i;
+
+  for (i = wid; i < TM_nb_threads; i += nb_workers) {
+    NVLog_s *log = NH_global_logs[i];
+    int pos = log->start, end = log->end, begin = pos;
+
+    committed_end[i] = begin;
+
+    while (pos != end) {
+      ts_s ts = entry_is_ts(log->ptr[pos]);
+      if (ts) {
+        rec_tx_s tx;
+        tx.ts = ts;
+        tx.tid = i;
+        tx.begin = begin;
+        tx.end = pos;
+        txs_per_log[i].push_back(tx);
+        begin = ptr_mod_log(pos, 1);
+        committed_end[i] = begin;
+      }
+      pos = ptr_mod_log(pos, 1);
+    }
+    // entries after committed_end[i] did not commit
+  }
+}
+
+// k-way merge, the TSs within each log are already sorted
+static void merge_logs()
+{
+  priority_queue<rec_tx_s, vector<rec_tx_s>, rec_tx_cmp> heads;
+  vector<size_t> next(TM_nb_threads, 0);
+  size_t nb_entries = 0, per_worker, acc = 0;
+  int i;
+
+  for (i = 0; i < TM_nb_threads; ++i) {
+    if (!txs_per_log[i].empty()) {
+      heads.push(txs_per_log[i][0]);
+      next[i] = 1;
+    }
+  }
+
+  while (!heads.empty()) {
+    rec_tx_s tx = heads.top();
+    heads.pop();
+    merged_txs.push_back(tx);
+    nb_entries += distance_ptr(tx.begin, tx.end);
+    if (next[tx.tid] < txs_per_log[tx.tid].size()) {
+      heads.push(txs_per_log[tx.tid][next[tx.tid]++]);
+    }
+  }
+
+  // split in chunks of (about) the same number of entries
+  per_worker = nb_entries / nb_workers + 1;
+  chunk_begin.push_back(0);
+  for (i = 0; i < (int)merged_txs.size(); ++i) {
+    acc += distance_ptr(merged_txs[i].begin, merged_txs[i].end);
+    if (acc >= per_worker && (int)chunk_begin.size() < nb_workers) {
+      chunk_begin.push_back(i + 1);
+      acc = 0;
+    }
+  }
+  while ((int)chunk_begin.size() <= nb_workers) {
+    chunk_begin.push_back(merged_txs.size());
+  }
+}
+
+// splits the writes of this worker's chunk by the owner of the cache line
+static void shuffle_writes(int wid)
+{
+  size_t i;
+
+  for (i = chunk_begin[wid]; i < chunk_begin[wid + 1]; ++i) {
+    rec_tx_s *tx = &(merged_txs[i]);
+    NVLog_s *log = NH_global_logs[tx->tid];
+    GRANULE_TYPE *base = NULL;
+    int pos, j;
+
+    // commit marker included
+    replayed_bytes[wid] += (distance_ptr(tx->begin, tx->end) + 1)
+      * sizeof(NVLogEntry_s);
+
+    for (pos = tx->begin; pos != tx->end; pos = ptr_mod_log(pos, 1)) {
+      NVLogEntry_s entry = log->ptr[pos], writes[2];
+      if (entry_is_update(entry)) {
+        int nb_writes = LOG_decode(entry, &base, writes);
+        for (j = 0; j < nb_writes; ++j) {
+          buckets[wid][REC_CL_HASH(writes[j].addr)].push_back(writes[j]);
+        }
+      }
+    }
+  }
+}
+
+// applies the cache lines owned by this worker, chunks are in TS order
+static void apply_writes(int wid)
+{
+  vector<uintptr_t> to_flush;
+  size_t j;
+  int i;
+
+  for (i = 0; i < nb_workers; ++i) {
+    vector<NVLogEntry_s> &bucket = buckets[i][wid];
+    for (j = 0; j < bucket.size(); ++j) {
+      GRANULE_TYPE *addr = LOG_AUX_chkp_addr(bucket[j].addr);
+      *addr = bucket[j].value;
+      to_flush.push_back(((uintptr_t)addr >> 6) << 6);
+    }
+    vector<NVLogEntry_s>().swap(bucket);
+  }
+
+  // each dirty line is flushed once
+  sort(to_flush.begin(), to_flush.end());
+  to_flush.erase(unique(to_flush.begin(), to_flush.end()), to_flush.end());
+  for (j = 0; j < to_flush.size(); ++j) {
+    MN_flush((void*)to_flush[j], CACHE_LINE_SIZE, 1);
+  }
+  MN_drain();
+}
+
+// the checkpoint is durable, the logs can be emptied
+static void truncate_logs(int wid)
+{
+  int i;
+
+  for (i = wid; i < TM_nb_threads; i += nb_workers) {
+    NVLog_s *log = NH_global_logs[i];
+    log->start_tx = -1;
+    log->end_last_tx = -1;
+    log->start = committed_end[i];
+    log->end = committed_end[i];
+    MN_flush(&(log->start), CACHE_LINE_SIZE, 1);
+  }
+  MN_drain();
+}
@@ -22,6 +22,7 @@ sorter_s *sorter;
 static void sort_one();
 
 static bool in_between(int start, int b, int end);
+static NVLogMarker_s *next_marker(int idx, NVLog_s *log);
 static void next_tx(int sorter_id, NVLog_s *log);
 
 // ############################ header implementation
@@ -148,7 +149,7 @@ static void sort_one() {
 		loc.ptr = update->pos_base;
 		loc.ts = update->ts;
 
-		while(!(did_produce = cp_produce(NULL, &loc))) {
+		while(!(did_produce = cp_produce(cp_instance, &loc))) {
 			this_thread::yield();
 		}
 		// printf("[SORTER]: ||| produce: %5i\n", update->pos_base);
@@ -181,22 +182,28 @@ static bool in_between(int start, int b, int end)
 	return res;
 }
 
-static ts_s next_ts(int idx, NVLog_s *log)
+// first commit marker at or after idx (from the index, the log is not read)
+static NVLogMarker_s *next_marker(int idx, NVLog_s *log)
 {
-	int log_start, log_end;
-	ts_s ts_val;
-	log_end = log->end;
-	log_start = log->start;
+	int tid = log->tid;
+	long long mk_end = LOG_AUX_markers_end(tid), first, last, k;
+	int log_start = log->start, log_end = log->end;
 
-	while (idx != log_end) { // This is a TX nuke! abort lots of TXs
-		ts_val = entry_is_ts(log->ptr[idx]);
-		if (ts_val) {
-			return ts_val;
-		}
-		idx = ptr_mod(idx, 1, LOG_local_state.size_of_log);
+	first = LOG_AUX_marker_first(tid, mk_end, log_start, log_end);
+	if (first == -1) {
+		return NULL;
 	}
+	last = LOG_AUX_marker_last(tid, mk_end, log_start, log_end);
+	k = LOG_AUX_marker_find(tid, first, last, log_start, idx);
 
-	return 0;
+	return k > last ? NULL : LOG_AUX_marker(tid, k);
+}
+
+static ts_s next_ts(int idx, NVLog_s *log)
+{
+	NVLogMarker_s *marker = next_marker(idx, log);
+
+	return marker == NULL ? 0 : marker->ts;
 }
 
 static void next_tx(int sorter_id, NVLog_s *log)
@@ -217,15 +224,9 @@ static void next_tx(int sorter_id, NVLog_s *log)
 		}
 	}
 
-	i = pos;
-	while (i != log_end) { // This is a TX nuke! abort lots of TXs
-		ts_val = entry_is_ts(log->ptr[i]);
-		if (ts_val) {
-			i = ptr_mod_log(i, 1);
-			break;
-		}
-		i = ptr_mod_log(i, 1);
-	}
+	// skips the TX at pos
+	NVLogMarker_s *marker = next_marker(pos, log);
+	i = marker == NULL ? log_end : ptr_mod_log(marker->pos, 1);
 
 	ts_val = next_ts(i, log);
 	if (ts_val != 0) {
@@ -1,6 +1,9 @@
 #include "nvhtm_helper.h"
 #include "log.h"
 #include "log_sorter.h"
+#include "alias_table.h"
+#include "snapshot.h"
+#include "pool_alloc.h"
 #include "tm.h"
 #include "nh.h"
 #include "utils.h"
@@ -21,7 +24,6 @@
 #include <algorithm>
 #include <climits>
 #include <utility>
-#include <bitset>
 
 #include <sys/time.h> // POSIX only
 
@@ -110,12 +112,12 @@ static CL_ALIGN int nb_thrs;
 static CL_ALIGN int set_threads;
 // compute checkpoint addresses with this
 
-static CL_ALIGN mutex malloc_mtx;
 static CL_ALIGN ts_s count_val_wait[MAX_NB_THREADS];
 
 static int manager_mutex = 0;
 volatile int *NH_checkpointer_state; // extern
 sem_t *NH_chkp_sem; // extern
+volatile int NH_sw_in_log; // extern
 static int exit_success = 0;
 
 static int is_exit;
@@ -139,14 +141,12 @@ static __thread CL_ALIGN vector<NVMHTM_mem_s*> *tmp_allocs; // transactional all
 static __thread CL_ALIGN vector<void*> *tmp_frees;
 static __thread CL_ALIGN char pad1[CACHE_LINE_SIZE];
 static __thread CL_ALIGN char pad2[CACHE_LINE_SIZE];
-static __thread CL_ALIGN void *malloc_ptr;
 static __thread CL_ALIGN int retries_counter = 0;
+static __thread ts_s sw_ts; // of the software commit, taken in begin
 // ################ functions
 // vector<map<void*, NVMHTM_mem_s*>> allocs; // extern
 
-static void dangerous_threads(int id, bitset<MAX_NB_THREADS> & threads);
-
-static void NVMHTM_validate(int, bitset<MAX_NB_THREADS> & threads);
+static void NVMHTM_validate(int id, ts_s ts);
 
 // create a delete_thr, and handle logs
 static void fork_manager(void);
@@ -176,24 +176,28 @@ void* NVMHTM_alloc(const char *file_name, size_t size, int vol_pool)
     tmp_frees = new vector<void*>();
   }
 
-  // instance
-  // sprintf(state_file, "%s" S_INSTANCE_EXT, file_name);
-  // instance = (NVMHTM_mem_s*) ALLOC_MEM(state_file, sizeof (NVMHTM_mem_s));
-  instance = (NVMHTM_mem_s*) ALLOC_MEM(file_name, sizeof (NVMHTM_mem_s));
+  // instance (the pool and the checkpoint go in different files, if the
+  // files are mapped they are reattached at the same address)
+  sprintf(state_file, "%s" S_INSTANCE_EXT, file_name);
+  instance = (NVMHTM_mem_s*) ALLOC_MEM(state_file, sizeof (NVMHTM_mem_s));
 
   // mem_pool also adds the extra id
   ALLOC_WITH_INSTANCE(instance, pool, file_name, size);
 
+  if (!ALLOC_IS_REATTACHED(instance) || !ALLOC_IS_REATTACHED(pool)
+      || instance->ptr != pool) {
+    instance->last_alloc = pool;
+    instance->chkp_counter = 0;
+  }
   instance->size = size;
   instance->ptr = pool;
-  instance->last_alloc = pool;
+  instance->heap = NULL;
   // strcpy(instance->file_name, file_name);
 
 #ifdef DO_CHECKPOINT
-  // sprintf(chkp_file, "%s" CHECKPOINT_EXT, file_name,
-  // (int) (instance->chkp_counter));
-  // instance->chkp.ptr = ALLOC_MEM(chkp_file, size);
-  instance->chkp.ptr = ALLOC_MEM(file_name, size);
+  sprintf(chkp_file, "%s" CHECKPOINT_EXT, file_name,
+    (int) (instance->chkp_counter));
+  instance->chkp.ptr = ALLOC_MEM(chkp_file, size);
   instance->chkp.size = size;
   instance->chkp.delta_to_pool =
     CALC_DELTA(instance->chkp.ptr, instance->ptr);
@@ -207,72 +211,53 @@ void* NVMHTM_alloc(const char *file_name, size_t size, int vol_pool)
 
   if (!in_htm) {
     NVMHTM_apply_allocs();
-    /*__sync_synchronize();*/
+    NH_PA_attach(instance); // else on the first NVMHTM_malloc
   }
+  mtx.lock(); // the checkpointer translates through the instances
+  instances[pool] = instance;
+  mtx.unlock();
+  /*__sync_synchronize();*/
 
   return pool;
 }
 
-// TODO: free and thread safe track of freed segments
-
+// inside a transaction (see pool_alloc.h), else in one of its own
 void* NVMHTM_malloc(void *pool, size_t size)
 {
   NVMHTM_mem_s *instance = INSTANCE_FROM_POOL(pool);
-  char *ptr;
   void *res;
-  intptr_t diff_ptrs, size_per_thrs, beg_seg;
-  int tid = TM_tid_var;
-
-  // TODO: threads are allocating in different areas!
-  // may overlap
 
-  int in_htm = HTM_test();
-
-  if (!in_htm) {
-    malloc_mtx.lock();
+  if (instance == NULL) {
+    return NULL;
   }
 
-  if (malloc_ptr != NULL) {
-    ptr = (char*) malloc_ptr;
-  }
-  else {
-    ptr = (char*) instance->last_alloc;
+  if (HTM_SGL_in_tx()) {
+    return NH_PA_malloc(instance, size);
   }
 
-  res = ptr;
+  NH_begin();
+  res = NH_PA_malloc(instance, size);
+  NH_commit();
 
-  diff_ptrs = ptr - (char*) instance->ptr;
-  size_per_thrs = instance->size / set_threads;
-  beg_seg = (tid + 1) * size_per_thrs;
-
-  // TODO: move this to asserts?
-  if (diff_ptrs + size > instance->size) {
-    // out of memory
-    fprintf(stderr, "OUT OF MEMORY!\n");
-    fflush(stderr);
-    res = NULL;
-  }
-  else if (diff_ptrs > beg_seg) {
-    fprintf(stderr, "Thread memory allocation overlap!\n");
-    fflush(stderr);
-    res = NULL;
-  }
+  return res;
+}
 
-  ptr += size;
+void NVMHTM_pfree(void *pool, void *ptr)
+{
+  NVMHTM_mem_s *instance = INSTANCE_FROM_POOL(pool);
 
-  // TODO: put a #ifdef or so
-  if (malloc_ptr != NULL) {
-    malloc_ptr = (void*) ptr;
-  }
-  else {
-    instance->last_alloc = ptr;
+  if (instance == NULL) {
+    return;
   }
 
-  if (!in_htm) {
-    malloc_mtx.unlock();
+  if (HTM_SGL_in_tx()) {
+    NH_PA_free(instance, ptr);
+    return;
   }
 
-  return res;
+  NH_begin();
+  NH_PA_free(instance, ptr);
+  NH_commit();
 }
 
 void NVMHTM_apply_allocs()
@@ -364,23 +349,15 @@ void NVMHTM_thr_init(void *pool)
   // gather an id, from 0 to nb_thrs to the current thread
 
   LOG_thr_init(my_tid);
+  #ifdef SOFTWARE_TRANSLATION
+  NH_ST_thr_init(my_tid);
+  #endif /* SOFTWARE_TRANSLATION */
 
   if (tmp_allocs == NULL) {
     tmp_allocs = new vector<NVMHTM_mem_s*>();
     tmp_frees = new vector<void*>();
   }
 
-  if (pool != NULL) {
-    // use a huge pool from which allocate memory
-
-    NVMHTM_mem_s *instance = INSTANCE_FROM_POOL(pool);
-    int block_size = instance->size / set_threads;
-
-    // if there are mallocs before this is called
-    block_size -= (char*) instance->ptr - (char*) instance->last_alloc;
-    malloc_ptr = (char*) instance->last_alloc + my_tid * block_size;
-  }
-  
   NH_time_blocked = 0;
   NH_count_blocks = 0;
 
@@ -400,6 +377,9 @@ void NVMHTM_init_thrs(int nb_threads)
   static bool is_started = false;
   set_threads = nb_threads;
   LOG_init(nb_threads, 0);
+  #ifdef SOFTWARE_TRANSLATION
+  NH_ST_init(nb_threads);
+  #endif /* SOFTWARE_TRANSLATION */
 
   is_exit = 0;
 
@@ -450,9 +430,9 @@ void NVMHTM_init_thrs(int nb_threads)
   if (!is_started) {
     is_started = true;
     #if DO_CHECKPOINT == 1
-    launch_thread_at(MAX_PHYS_THRS - 1, manage_checkpoint);
+    launch_thread_at(CHKP_MANAGER_CPU, manage_checkpoint);
     #if SORT_ALG == 4
-    launch_thread_at(MAX_PHYS_THRS - 2, LOG_SOR_main_thread);
+    launch_thread_at(CHKP_SORTER_CPU, LOG_SOR_main_thread);
     #endif /* Sorting thread */
     #else
     exit_success = 1; // TODO: put this global
@@ -478,6 +458,8 @@ void NVMHTM_zero_pool(void *pool)
   #ifdef DO_CHECKPOINT
   memset(instance->chkp.ptr, 0, instance->chkp.size);
   #endif
+  NH_PA_detach(instance); // the free lists are in the pool
+  NH_PA_attach(instance);
 }
 
 int NVMHTM_has_writes(int tid)
@@ -512,6 +494,13 @@ void NVMHTM_shutdown()
   / (double) CPU_MAX_FREQ / 1000.0D) / (double) TM_nb_threads / time_taken);
   printf("--- Nb. checkpoints %lli\n", NH_nb_checkpoints);
   printf("--- Time blocked %e ms!\n", (double) time_chkp_total / ((double) CPU_MAX_FREQ));
+  #ifdef LOG_GROUP_COMMIT
+  long long nb_groups, nb_grouped_txs;
+
+  LOG_GROUP_stats(&nb_groups, &nb_grouped_txs);
+  printf("--- Nb. group commits %lli (%f TXs per group)\n", nb_groups,
+    nb_groups > 0 ? (double) nb_grouped_txs / (double) nb_groups : 0.0);
+  #endif /* LOG_GROUP_COMMIT */
 }
 
 void NVMHTM_write_ts(int id, ts_s ts)
@@ -524,24 +513,26 @@ void NVMHTM_commit(int id, ts_s ts, int nb_writes)
   // printf("commit %llu\n", ts);
   /*if (nb_writes == 0) return; // done */ // this is check in the AFTER_TRANSACTION
 
-  bitset<MAX_NB_THREADS> threads_set;
-
-  #if VALIDATION == 3
-  int nb_threads = TM_get_nb_threads();
-  intptr_t all_dang = (1 << nb_threads) - 1;
-  threads_set << all_dang; // assume all dangerous initially
-  dangerous_threads(id, threads_set);
-  #endif
-
   // flush entries before write TS (does not need memory barrier)
+  LOG_NT_drain();
   SPIN_PER_WRITE(MAX(nb_writes * sizeof(NVLogEntry_s) / CACHE_LINE_SIZE, 1));
   // int log_before = ptr_mod_log(NH_global_logs[id]->end, -nb_writes);
   // MN_flush(&(NH_global_logs[id]->ptr[log_before]),
   //   nb_writes * sizeof(NVLogEntry_s), 0
   // );
 
+  #ifdef LOG_GROUP_COMMIT
+  if (nb_writes <= LOG_GROUP_MAX_WRITES) {
+    // log->end is not moved yet, the LOG_TS is durable with the group
+    NVMHTM_write_ts(id, ts);
+    LOG_GROUP_commit(id, ts);
+    __sync_synchronize();
+    return;
+  }
+  #endif /* LOG_GROUP_COMMIT */
+
   #ifndef DISABLE_VALIDATION
-  NVMHTM_validate(id, threads_set);
+  NVMHTM_validate(id, ts);
   #endif
 
   // good place for a memory barrier
@@ -560,6 +551,50 @@ void NVMHTM_commit(int id, ts_s ts, int nb_writes)
   __sync_synchronize();
 }
 
+void NVMHTM_sw_begin()
+{
+  LOG_before_TX();
+
+  // the STM commit lock is held, then the ts follows the order of the STM
+  sw_ts = rdtscp();
+  LOG_ORDER_set(TM_tid_var, sw_ts);
+  __sync_synchronize();
+}
+
+void NVMHTM_sw_write(void *addr, void *val)
+{
+  LOG_nb_writes++;
+  LOG_push_addr(TM_tid_var, (GRANULE_TYPE*) addr, (GRANULE_TYPE) val);
+}
+
+void NVMHTM_sw_commit()
+{
+  int nb_writes = LOG_nb_writes;
+  ts_s ts = sw_ts;
+
+  if (nb_writes == 0) {
+    LOG_ORDER_idle(TM_tid_var);
+    return;
+  }
+
+  // HW transactions that started before this one may be committed (before
+  // the switch to SW) with a smaller ts, wait until their marker is public
+  LOG_ORDER_wait(ts);
+
+  LOG_NT_drain();
+  SPIN_PER_WRITE(MAX(nb_writes * sizeof(NVLogEntry_s) / CACHE_LINE_SIZE, 1));
+  NVMHTM_write_ts(TM_tid_var, ts);
+  SPIN_PER_WRITE(1);
+  LOG_after_TX();
+  LOG_ORDER_idle(TM_tid_var);
+}
+
+void NVMHTM_sw_abort()
+{
+  // log->end did not move, the next LOG_before_TX drops the entries
+  LOG_ORDER_idle(TM_tid_var);
+}
+
 void NVMHTM_free(void *ptr)
 {
   // TODO: unmap memory, deal with stuff stored
@@ -586,6 +621,7 @@ void NVMHTM_free(void *ptr)
     instances.erase(instance->ptr);
     // mtx.unlock();
 
+    NH_PA_detach(instance);
     FREE_MEM(instance->ptr, instance->size);
     FREE_MEM(instance->chkp.ptr, instance->size);
     FREE_MEM(instance, sizeof (NVMHTM_mem_s));
@@ -635,9 +671,28 @@ void NVMHTM_reduce_logs()
   LOG_checkpoint_apply_one(); // TODO: just one?
 }
 
+void NVMHTM_recover()
+{
+  long long bytes;
+  ts_s ts1, ts2;
+
+  ts1 = rdtscp();
+  bytes = LOG_recover(MAX_PHYS_THRS);
+  ts2 = rdtscp();
+
+  printf("--- Recovered %lli bytes of log in %f ms\n", bytes,
+    (double)(ts2 - ts1) / (double) CPU_MAX_FREQ);
+}
+
+void NVMHTM_set_checkpointer_threads(int nb_threads)
+{
+  // only the backward checkpoint (SORT_ALG == 5) is sharded
+  LOG_checkpoint_backward_set_threads(nb_threads);
+}
+
 #if VALIDATION == 2
 
-void NVMHTM_validate(int id, bitset<MAX_NB_THREADS>&)
+void NVMHTM_validate(int id, ts_s)
 {
   int my_global = TM_get_global_counter(id); // TODO: Removing the MEMFENCE blocks the program
   while (global_flushed_ts < my_global - 1) {
@@ -646,22 +701,19 @@ void NVMHTM_validate(int id, bitset<MAX_NB_THREADS>&)
 }
 #elif VALIDATION == 3
 
-static void NVMHTM_validate(int id, bitset<MAX_NB_THREADS>& threads_set)
+static void NVMHTM_validate(int id, ts_s ts)
 {
-  int i, nb_threads = TM_get_nb_threads();
   ts_s ts1_wait_log_time = rdtscp();
 
-  do {
-    dangerous_threads(id, threads_set);
-  }
-  while (threads_set.any());
+  // only the transactions that may commit before ts (see log_order.h)
+  LOG_ORDER_wait(ts);
   NH_time_validate += rdtscp() - ts1_wait_log_time;
 }
 #else /* VALIDATION is not 2 and not 3 */
 
 // old implementation
 
-void NVMHTM_validate(int id, bitset<MAX_NB_THREADS>&)
+void NVMHTM_validate(int id, ts_s)
 {
   int i;
 
@@ -733,28 +785,6 @@ void NVHTM_req_clear_log(/* int block */)
   __sync_synchronize();
 }
 
-static void dangerous_threads(int id, bitset<MAX_NB_THREADS> & threads_set)
-{
-  int i;
-
-  for (i = 0; i < TM_get_nb_threads(); ++i) {
-
-    if (!threads_set.test(i)) {
-      continue; // not dangerous
-    }
-
-    int local_counter = TM_get_local_counter(i);
-    if (i != id && (local_counter & 1)) {
-      int other_global = TM_get_global_counter(i);
-      int my_global = TM_get_global_counter(id);
-      if (other_global < my_global || NH_before_ts[i] > my_global) {
-        // the other has a smaller TS or started after
-        threads_set[i] = 1;
-      }
-    }
-  }
-}
-
 static void fork_manager()
 {
   #if DO_CHECKPOINT == 5
@@ -767,11 +797,7 @@ static void fork_manager()
     LOG_init(TM_nb_threads, 1); // reattach
     // printf("Maximum supported CPUs: %i\n", MAX_PHYS_THRS);
 
-    if (MAX_PHYS_THRS == 72) {
-      set_affinity_at(53); // last hyperthread of first socket
-    } else {
-      set_affinity_at(MAX_PHYS_THRS - 1);
-    }
+    set_affinity_at(CHKP_MANAGER_CPU);
 
     /*
     struct sigaction sa_sigsegv;
@@ -797,11 +823,7 @@ static void fork_manager()
 
     // sort the logs for faster checkpoint (TODO:)
     #if SORT_ALG == 4
-    if (MAX_PHYS_THRS == 56) {
-      launch_thread_at(26, LOG_SOR_main_thread);
-    } else {
-      launch_thread_at(MAX_PHYS_THRS - 2, LOG_SOR_main_thread);
-    }
+    launch_thread_at(CHKP_SORTER_CPU, LOG_SOR_main_thread);
     #endif /* Sorting thread */
     server(NULL);
   }
@@ -914,6 +936,10 @@ static int loop_checkpoint_manager()
 
 time_chkp_1 = rdtscp();
 
+#ifdef LOG_ADAPTIVE
+LOG_CTRL_update();
+#endif /* LOG_ADAPTIVE */
+
 __sync_synchronize();
 
 //    printf("APPLY_LOG: ");
@@ -959,6 +985,8 @@ if (LOG_is_logged_tx()) {
         break; // no more transactions
       }
     }
+    #elif SORT_ALG == 5 && defined(CHKP_SNAPSHOT)
+    chkp_return_value = NH_SNP_checkpoint();
     #elif SORT_ALG == 5
     chkp_return_value = LOG_checkpoint_backward();
     #endif
@@ -982,6 +1010,9 @@ if (LOG_is_logged_tx()) {
 
   //NH_nb_checkpoints++; -> this is happening in the log function
     time_chkp_total += time_chkp_2 - time_chkp_1;
+#ifdef LOG_ADAPTIVE
+    LOG_CTRL_round(time_chkp_2 - time_chkp_1);
+#endif /* LOG_ADAPTIVE */
  
   //if (NH_nb_checkpoints > 1)
     *NH_time_checkpoints_average = time_chkp_total / NH_nb_checkpoints;
@@ -1027,6 +1058,11 @@ static void segint_sigaction(int signal, siginfo_t *si, void *context)
   (double) NH_manager_order_logs / (double) CPU_MAX_FREQ);
   ptr += sprintf(ptr, "[logger] NB_spins=%lli NB_writes=%lli TIME_spins=%fms\n",
   MN_count_spins, MN_count_writes, (double)MN_time_spins / (double)CPU_MAX_FREQ);
+#ifdef LOG_ADAPTIVE
+  ptr += sprintf(ptr, "[FORKED_MANAGER] Log trigger %i apply %i too_empty %i wait_distance %i\n",
+  NH_global_ctrl->trigger, NH_global_ctrl->apply, NH_global_ctrl->too_empty,
+  NH_global_ctrl->wait_distance);
+#endif /* LOG_ADAPTIVE */
   printf("%s", buffer);
 
   aux_thread_stats_to_gnuplot_file((char*) STATS_FILE ".aux_thr");
@@ -0,0 +1,234 @@
+#include "pool_alloc.h"
+#include "nh.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// ################ defines
+
+#define PA_MAGIC    0x4e48504f4f4cULL
+#define PA_USED     1
+#define PA_HDR_SIZE 16 // keeps the payload 16B aligned
+
+#define PA_HDR(block)     ((GRANULE_TYPE*) (block))
+#define PA_PAYLOAD(block) ((char*) (block) + PA_HDR_SIZE)
+#define PA_BLOCK(ptr)     ((char*) (ptr) - PA_HDR_SIZE)
+#define PA_NEXT(block)    ((GRANULE_TYPE*) PA_PAYLOAD(block)) // free list
+
+#define PA_BLOCK_SIZE(k) ((size_t) 1 << (k))
+#define PA_SLAB_SIZE(k) \
+  (PA_BLOCK_SIZE(k) > NH_PA_SLAB_SIZE ? PA_BLOCK_SIZE(k) : NH_PA_SLAB_SIZE)
+
+// ################ types
+
+// persistent, in the first line of the heap
+typedef struct pa_heap_ {
+  GRANULE_TYPE magic, top;
+} pa_heap_s;
+
+typedef struct pa_class_ {
+  char *free; // blocks freed by the thread
+  char *next, *end; // rest of the last slab carved
+} pa_class_s;
+
+typedef struct pa_thr_ {
+  pa_class_s classes[NH_PA_NB_CLASSES];
+} __attribute__((aligned(CACHE_LINE_SIZE))) pa_thr_s;
+
+typedef struct pa_pool_ {
+  pa_heap_s *heap;
+  char *begin, *end;
+  pa_thr_s thrs[MAX_NB_THREADS];
+} pa_pool_s;
+
+// ################ local functions
+
+static int class_of(size_t size);
+static char *carve(pa_pool_s *pa_pool, int k);
+static void rebuild(pa_pool_s *pa_pool);
+
+// ################ implementation header
+
+void NH_PA_attach(NVMHTM_mem_s *instance)
+{
+  uintptr_t heap = ((uintptr_t) instance->last_alloc + CACHE_LINE_SIZE - 1)
+    & ~((uintptr_t) CACHE_LINE_SIZE - 1);
+  pa_pool_s *pa_pool;
+
+  if (posix_memalign((void**) &pa_pool, CACHE_LINE_SIZE,
+      sizeof (pa_pool_s)) != 0) {
+    perror("posix_memalign");
+    exit(EXIT_FAILURE);
+  }
+  memset(pa_pool, 0, sizeof (pa_pool_s));
+
+  pa_pool->heap = (pa_heap_s*) heap;
+  pa_pool->begin = (char*) heap + CACHE_LINE_SIZE;
+  pa_pool->end = (char*) instance->ptr + instance->size;
+
+  if (pa_pool->begin < pa_pool->end && pa_pool->heap->magic == PA_MAGIC) {
+    rebuild(pa_pool); // reattached
+  }
+
+  if (!__sync_bool_compare_and_swap(&(instance->heap), NULL, pa_pool)) {
+    free(pa_pool); // attached by another thread
+  }
+}
+
+void NH_PA_detach(NVMHTM_mem_s *instance)
+{
+  free(instance->heap);
+  instance->heap = NULL;
+}
+
+void *NH_PA_malloc(NVMHTM_mem_s *instance, size_t size)
+{
+  pa_pool_s *pa_pool = (pa_pool_s*) instance->heap;
+  pa_class_s *pa_class;
+  char *block;
+  int k = class_of(size);
+
+  if (k == -1) {
+    return NULL;
+  }
+
+  if (pa_pool == NULL) {
+    // the pool was allocated inside a transaction
+    NH_PA_attach(instance);
+    pa_pool = (pa_pool_s*) instance->heap;
+  }
+
+  pa_class = &(pa_pool->thrs[TM_tid_var].classes[k]);
+  // volatile, but undone with the transaction (the emulated HTM only undoes
+  // the words passed to htm_write)
+  htm_write(&(pa_class->free));
+  htm_write(&(pa_class->next));
+  htm_write(&(pa_class->end));
+
+  if (pa_class->free != NULL) {
+    block = pa_class->free;
+    pa_class->free = (char*) NH_read(PA_NEXT(block));
+  }
+  else if (pa_class->next < pa_class->end) {
+    block = pa_class->next;
+    pa_class->next += PA_BLOCK_SIZE(k);
+  }
+  else {
+    block = carve(pa_pool, k);
+    if (block == NULL) {
+      fprintf(stderr, "OUT OF MEMORY!\n");
+      fflush(stderr);
+      return NULL;
+    }
+    pa_class->next = block + PA_BLOCK_SIZE(k);
+    pa_class->end = block + PA_SLAB_SIZE(k);
+  }
+
+  NH_write(PA_HDR(block), (GRANULE_TYPE) (k << 1 | PA_USED));
+
+  return PA_PAYLOAD(block);
+}
+
+void NH_PA_free(NVMHTM_mem_s *instance, void *ptr)
+{
+  pa_pool_s *pa_pool = (pa_pool_s*) instance->heap;
+  char *block = PA_BLOCK(ptr);
+  GRANULE_TYPE hdr;
+  pa_class_s *pa_class;
+  int k;
+
+  if (ptr == NULL) {
+    return;
+  }
+
+  if (pa_pool == NULL) {
+    NH_PA_attach(instance);
+    pa_pool = (pa_pool_s*) instance->heap;
+  }
+
+  hdr = NH_read(PA_HDR(block));
+  k = (int) (hdr >> 1);
+  assert((hdr & PA_USED) && k >= NH_PA_MIN_CLASS && k < NH_PA_NB_CLASSES);
+
+  NH_write(PA_HDR(block), (GRANULE_TYPE) (k << 1));
+
+  pa_class = &(pa_pool->thrs[TM_tid_var].classes[k]);
+  htm_write(&(pa_class->free));
+  NH_write(PA_NEXT(block), (GRANULE_TYPE) pa_class->free);
+  pa_class->free = block;
+}
+
+// ################ implementation local functions
+
+static int class_of(size_t size)
+{
+  int k = NH_PA_MIN_CLASS;
+
+  while (k < NH_PA_NB_CLASSES && PA_BLOCK_SIZE(k) < size + PA_HDR_SIZE) {
+    ++k;
+  }
+
+  return k < NH_PA_NB_CLASSES ? k : -1;
+}
+
+// new slab of class k from the top, the transaction conflicts here
+static char *carve(pa_pool_s *pa_pool, int k)
+{
+  pa_heap_s *heap = pa_pool->heap;
+  char *top;
+
+  if (pa_pool->begin >= pa_pool->end) {
+    return NULL;
+  }
+
+  if (NH_read(&(heap->magic)) != PA_MAGIC) {
+    NH_write(&(heap->magic), (GRANULE_TYPE) PA_MAGIC);
+    NH_write(&(heap->top), (GRANULE_TYPE) pa_pool->begin);
+  }
+
+  top = (char*) NH_read(&(heap->top));
+  if ((size_t) (pa_pool->end - top) < PA_SLAB_SIZE(k)) {
+    return NULL;
+  }
+
+  NH_write(&(heap->top), (GRANULE_TYPE) (top + PA_SLAB_SIZE(k)));
+  // rebuild reads the class of the slab here
+  NH_write(PA_HDR(top), (GRANULE_TYPE) (k << 1));
+
+  return top;
+}
+
+// the free blocks of each slab go to the thread slab % TM_nb_threads, the
+// links are written before the pool is published and need no log
+static void rebuild(pa_pool_s *pa_pool)
+{
+  int nb_threads = TM_nb_threads > 0 ? TM_nb_threads : 1;
+  char *slab = pa_pool->begin, *top = (char*) pa_pool->heap->top;
+  long long nb_slabs = 0;
+
+  while (slab < top) {
+    int k = (int) (*PA_HDR(slab) >> 1);
+    pa_class_s *pa_class;
+    char *block;
+
+    if (k < NH_PA_MIN_CLASS || k >= NH_PA_NB_CLASSES) {
+      // the rest of the heap is not reused
+      fprintf(stderr, "[pool_alloc] invalid slab at %p\n", slab);
+      break;
+    }
+
+    pa_class = &(pa_pool->thrs[nb_slabs % nb_threads].classes[k]);
+    for (block = slab; block < slab + PA_SLAB_SIZE(k);
+        block += PA_BLOCK_SIZE(k)) {
+      if (!(*PA_HDR(block) & PA_USED)) {
+        *PA_NEXT(block) = (GRANULE_TYPE) pa_class->free;
+        pa_class->free = block;
+      }
+    }
+
+    slab += PA_SLAB_SIZE(k);
+    nb_slabs++;
+  }
+}
@@ -0,0 +1,328 @@
+#ifdef CHKP_SNAPSHOT
+
+#include "log.h"
+#include "snapshot.h"
+
+#include "rdtsc.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
+#include <linux/userfaultfd.h>
+
+// ################ defines
+
+// Linux 6.7, for older headers
+#ifndef UFFD_FEATURE_WP_UNPOPULATED
+#define UFFD_FEATURE_WP_UNPOPULATED (1 << 13)
+#endif
+#ifndef UFFD_FEATURE_WP_ASYNC
+#define UFFD_FEATURE_WP_ASYNC (1 << 15)
+#endif
+#ifndef PAGEMAP_SCAN
+#define PAGE_IS_WRITTEN       (1 << 1)
+#define PM_SCAN_WP_MATCHING   (1 << 0)
+#define PM_SCAN_CHECK_WPASYNC (1 << 1)
+struct page_region {
+  __u64 start, end, categories;
+};
+struct pm_scan_arg {
+  __u64 size, flags, start, end, walk_end, vec, vec_len, max_pages;
+  __u64 category_inverted, category_mask, category_anyof_mask, return_mask;
+};
+#define PAGEMAP_SCAN _IOWR('f', 16, struct pm_scan_arg)
+#endif /* PAGEMAP_SCAN */
+
+#define SNP_NB_REGIONS 512 // written ranges per PAGEMAP_SCAN
+
+using namespace std;
+
+// ################ types
+
+typedef struct snp_pool_ {
+  NVMHTM_mem_s *instance;
+  int is_tracked; // registered in the userfaultfd
+} snp_pool_s;
+
+// range of a pool copied in the round
+typedef struct snp_copy_ {
+  void *pool;
+  size_t offset, size;
+} snp_copy_s;
+
+// ################ variables
+
+extern CL_ALIGN map<void*, NVMHTM_mem_s*> instances; // from nvhtm_helper.cpp
+extern mutex mtx; // from nvhtm_helper.cpp (protects instances)
+
+static int uffd = -2; // -2 not opened yet, -1 no tracking
+static int pagemap_fd = -1;
+static uintptr_t page_size;
+static map<void*, snp_pool_s> pools; // the pools seen in a round
+static vector<snp_copy_s> copies; // kept for the next round if discarded
+static vector<char> buffer;
+static vector<struct page_region> regions;
+
+// ################ local functions
+
+static void snp_init();
+static int track(NVMHTM_mem_s *instance);
+static void stage(NVMHTM_mem_s *instance, size_t offset, size_t size);
+static void stage_written(NVMHTM_mem_s *instance, snp_pool_s *snp_pool);
+static int logs_over(int distance);
+static void truncate_logs(ts_s ts);
+
+// ################ implementation header
+
+int NH_SNP_checkpoint()
+{
+  map<void*, NVMHTM_mem_s*>::iterator it;
+  map<void*, snp_pool_s>::iterator p_it;
+  vector<snp_copy_s> pending;
+  size_t i, at;
+  ts_s ts;
+
+  if (LOG_local_state.size_of_log == 0) LOG_local_state.size_of_log = NH_global_logs[0]->size_of_log;
+  if (uffd == -2) snp_init();
+
+  // same trigger as the backward checkpoint
+  if (*NH_checkpointer_state != 2 && !logs_over(APPLY_BACKWARD_VAL)) {
+    *NH_checkpointer_state = 0;
+    __sync_synchronize();
+    return 1; // try again later
+  }
+
+  // the SGL transaction may be waiting for log space
+  if (!__sync_bool_compare_and_swap(&HTM_SGL_var, 0, 1)) {
+    return LOG_checkpoint_backward();
+  }
+  // the HTM transactions that commit with a smaller ts are visible
+  ts = rdtscp();
+
+  pending.swap(copies);
+  buffer.clear();
+
+  mtx.lock();
+  for (p_it = pools.begin(); p_it != pools.end();) {
+    it = instances.find(p_it->first);
+    if (it == instances.end() || it->second != p_it->second.instance) {
+      pools.erase(p_it++); // freed
+    } else {
+      ++p_it;
+    }
+  }
+  for (it = instances.begin(); it != instances.end(); ++it) {
+    NVMHTM_mem_s *instance = it->second;
+
+    if (instance->chkp.ptr == NULL) continue;
+
+    p_it = pools.find(instance->ptr);
+    if (p_it == pools.end()) {
+      snp_pool_s snp_pool = { instance, track(instance) };
+      pools[instance->ptr] = snp_pool;
+      stage(instance, 0, instance->size);
+    } else {
+      stage_written(instance, &(p_it->second));
+    }
+  }
+  for (i = 0; i < pending.size(); ++i) {
+    p_it = pools.find(pending[i].pool);
+    if (p_it != pools.end()) {
+      stage(p_it->second.instance, pending[i].offset, pending[i].size);
+    }
+  }
+  mtx.unlock();
+
+  HTM_SGL_var = 0;
+  __sync_synchronize();
+
+  // the copy holds values of the TXs before ts, wait for their markers
+  while (LOG_ORDER_min() < ts) {
+    if (logs_over(TOO_FULL)) {
+      // a writer may wait for log space (and the SGL may be taken)
+      return LOG_checkpoint_backward();
+    }
+    PAUSE();
+  }
+
+  NH_nb_checkpoints++;
+
+  for (i = 0, at = 0; i < copies.size(); ++i) {
+    snp_copy_s *copy = &(copies[i]);
+    char *image = (char*) pools[copy->pool].instance->chkp.ptr + copy->offset;
+
+    memcpy(image, &(buffer[at]), copy->size);
+    MN_flush(image, copy->size, 1);
+    at += copy->size;
+  }
+  MN_drain();
+  copies.clear();
+
+  // the logs can only be truncated after the images are durable
+  truncate_logs(ts);
+
+  *NH_checkpointer_state = 0;
+  __sync_synchronize();
+  return 0;
+}
+
+// ################ implementation local functions
+
+static void snp_init()
+{
+  struct uffdio_api api;
+
+  page_size = sysconf(_SC_PAGESIZE);
+  regions.resize(SNP_NB_REGIONS);
+
+  uffd = syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK);
+  pagemap_fd = open("/proc/self/pagemap", O_RDONLY);
+  if (uffd >= 0 && pagemap_fd >= 0) {
+    memset(&api, 0, sizeof (api));
+    api.api = UFFD_API;
+    // the kernel resolves the faults, no handler thread
+    api.features = UFFD_FEATURE_WP_ASYNC | UFFD_FEATURE_WP_UNPOPULATED;
+    if (ioctl(uffd, UFFDIO_API, &api) == 0) {
+      return;
+    }
+  }
+
+  fprintf(stderr, "[snapshot] no write-protect tracking, copying the pools\n");
+  if (uffd >= 0) close(uffd);
+  uffd = -1;
+}
+
+static int track(NVMHTM_mem_s *instance)
+{
+  uintptr_t begin = (uintptr_t) instance->ptr & ~(page_size - 1);
+  uintptr_t end = ((uintptr_t) instance->ptr + instance->size + page_size - 1)
+    & ~(page_size - 1);
+  struct uffdio_register reg;
+  struct uffdio_writeprotect wp;
+
+  if (uffd < 0) {
+    return 0;
+  }
+
+  memset(&reg, 0, sizeof (reg));
+  reg.range.start = begin;
+  reg.range.len = end - begin;
+  reg.mode = UFFDIO_REGISTER_MODE_WP;
+  if (ioctl(uffd, UFFDIO_REGISTER, &reg) != 0) {
+    return 0;
+  }
+
+  memset(&wp, 0, sizeof (wp));
+  wp.range = reg.range;
+  wp.mode = UFFDIO_WRITEPROTECT_MODE_WP;
+  if (ioctl(uffd, UFFDIO_WRITEPROTECT, &wp) != 0) {
+    ioctl(uffd, UFFDIO_UNREGISTER, &(reg.range));
+    return 0;
+  }
+
+  return 1;
+}
+
+static void stage(NVMHTM_mem_s *instance, size_t offset, size_t size)
+{
+  snp_copy_s copy = { instance->ptr, offset, size };
+  char *src = (char*) instance->ptr + offset;
+
+  buffer.insert(buffer.end(), src, src + size);
+  copies.push_back(copy);
+}
+
+// the pages written since the last round, protects them again
+static void stage_written(NVMHTM_mem_s *instance, snp_pool_s *snp_pool)
+{
+  uintptr_t pool = (uintptr_t) instance->ptr, pool_end = pool + instance->size;
+  struct pm_scan_arg arg;
+  long i, nb_regions;
+
+  if (!snp_pool->is_tracked) {
+    stage(instance, 0, instance->size);
+    return;
+  }
+
+  memset(&arg, 0, sizeof (arg));
+  arg.size = sizeof (arg);
+  arg.flags = PM_SCAN_WP_MATCHING | PM_SCAN_CHECK_WPASYNC;
+  arg.start = pool & ~(page_size - 1);
+  arg.end = (pool_end + page_size - 1) & ~(page_size - 1);
+  arg.vec = (uintptr_t) &(regions[0]);
+  arg.vec_len = regions.size();
+  arg.category_mask = PAGE_IS_WRITTEN;
+  arg.return_mask = PAGE_IS_WRITTEN;
+
+  do {
+    nb_regions = ioctl(pagemap_fd, PAGEMAP_SCAN, &arg);
+    if (nb_regions < 0) {
+      perror("PAGEMAP_SCAN");
+      snp_pool->is_tracked = 0;
+      stage(instance, 0, instance->size);
+      return;
+    }
+    for (i = 0; i < nb_regions; ++i) {
+      // the first and last pages may be shared with other data
+      uintptr_t begin = max((uintptr_t) regions[i].start, pool);
+      uintptr_t end = min((uintptr_t) regions[i].end, pool_end);
+
+      if (begin < end) {
+        stage(instance, begin - pool, end - begin);
+      }
+    }
+    arg.start = arg.walk_end; // vec was full
+  } while (arg.walk_end < arg.end);
+}
+
+static int logs_over(int distance)
+{
+  int i;
+
+  for (i = 0; i < TM_nb_threads; ++i) {
+    NVLog_s *log = NH_global_logs[i];
+
+    if (distance_ptr(log->start, log->end) > distance) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+// drops the TXs with a smaller ts, they are in the images
+static void truncate_logs(ts_s ts)
+{
+  int i;
+
+  for (i = 0; i < TM_nb_threads; ++i) {
+    NVLog_s *log = NH_global_logs[i];
+    long long mk_end = LOG_AUX_markers_end(i);
+    int start = log->start, end = log->end, pos = start;
+    long long k, first, last;
+
+    first = LOG_AUX_marker_first(i, mk_end, start, end);
+    last = LOG_AUX_marker_last(i, mk_end, start, end);
+    if (first == -1) continue;
+
+    for (k = first; k <= last; ++k) {
+      NVLogMarker_s *marker = LOG_AUX_marker(i, k);
+
+      if (marker->ts >= ts) break;
+      pos = ptr_mod_log(marker->pos, 1);
+    }
+
+    MN_write(&(log->start), &pos, sizeof(int), 0);
+  }
+}
+
+#endif /* CHKP_SNAPSHOT */
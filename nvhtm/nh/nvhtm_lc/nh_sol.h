@@ -40,6 +40,7 @@ extern "C"
 #define NH_write(addr, val) ({ \
   GRANULE_TYPE buf = val; \
   NH_before_write(addr, val); \
+  htm_write(addr); \
   memcpy(addr, &(buf), sizeof(GRANULE_TYPE)); /* *((GRANULE_TYPE*)addr) = val; */ \
   NH_after_write(addr, val); \
   val; \
@@ -36,21 +36,26 @@ extern "C"
   int nb_writes = LOG_count_writes(tid); \
   if (nb_writes) { \
     htm_tx_val_counters[tid].global_counter = ts_var; \
+    LOG_ORDER_set(tid, ts_var); \
     __sync_synchronize(); \
     NVMHTM_commit(tid, ts_var, nb_writes); \
   } \
   /*printf("nb_writes=%i\n", nb_writes);*/ \
   CHECK_AND_REQUEST(tid); \
-  TM_inc_local_counter(tid); \
   if (nb_writes) { \
     LOG_after_TX(); \
   } \
+  /* even after the marker is public */ \
+  LOG_ORDER_idle(tid); \
+  TM_inc_local_counter(tid); \
 })
 
 #undef AFTER_ABORT
 #define AFTER_ABORT(tid, budget, status) \
   /* NH_tx_time += rdtscp() - TM_ts1; */ \
+  LOG_ORDER_idle(tid); /* may wait for log */ \
   CHECK_LOG_ABORT(tid, status); \
+  NH_ST_AFTER_ABORT(budget, status); \
   LOG_get_ts_before_tx(tid); \
   __sync_synchronize(); \
   ts_var = rdtscp(); \
@@ -70,35 +75,28 @@ extern "C"
 #define NH_write(addr, val) ({ \
   GRANULE_TYPE buf = val; \
   NH_before_write(addr, val); \
+  htm_write(addr); \
   memcpy(addr, &(buf), sizeof(GRANULE_TYPE)); /* *((GRANULE_TYPE*)addr) = val; */ \
   NH_after_write(addr, val); \
   val; \
 })
+#define NH_ST_AFTER_ABORT(budget, status) /* empty */
 #endif /* SOFTWARE_TRANSLATION */
 
 #ifdef SOFTWARE_TRANSLATION
 
-// TODO: check with paolo if he wants to show this ---
-
-typedef struct NH_ST_alias_entry_ {
-  // on write fill the entry in the alias table
-  // on read check if the entry is in the alias table, if yes read else go to address directly
-  void *addr;
-  uintptr_t val;
-  uintptr_t ts;
-} NH_ST_alias_entry_s;
+// the log keeps addr, the transactions use the shadow (see alias_table.h)
+#include "alias_table.h"
 
-extern NH_ST_alias_entry_s *NH_alias_table;
-
-// TODO: grab base pointer
-#define NH_translate(addr) ({ \
-  \
-})
+#define NH_translate(addr) \
+  ((__typeof__(addr)) NH_ST_read_addr((void*) (addr)))
 
 #define NH_write(addr, val) ({ \
   GRANULE_TYPE buf = val; \
+  void *shadow = NH_ST_write_addr((void*) (addr)); \
   NH_before_write(addr, val); \
-  memcpy(addr, &(buf), sizeof(GRANULE_TYPE)); /* *((GRANULE_TYPE*)addr) = val; */ \
+  htm_write(shadow); \
+  memcpy(shadow, &(buf), sizeof(GRANULE_TYPE)); \
   NH_after_write(addr, val); \
   val; \
 })
@@ -106,7 +104,8 @@ extern NH_ST_alias_entry_s *NH_alias_table;
 #undef NH_read
 #define NH_read(addr) ({ \
   NH_before_read(addr); \
-  (__typeof__(*addr))*(addr); \
+  htm_read(NH_translate(addr)); \
+  (__typeof__(*addr))*(NH_translate(addr)); \
 })
 #endif /* SOFTWARE_TRANSLATION */
 
@@ -125,6 +125,8 @@ void* NVMHTM_malloc(void *pool, size_t size)
     return NULL; // TODO: PHTM
 }
 
+void NVMHTM_pfree(void *pool, void *ptr) { /* empty */ }
+
 void NVMHTM_apply_allocs() {
 	// TODO: no strange allocs in PHTM
 }
@@ -192,6 +194,10 @@ void NVMHTM_checkpoint(int tid, void *pool) { /* empty */ }
 
 void NVMHTM_reduce_logs() { /* empty */ }
 
+void NVMHTM_recover() { /* empty */ }
+
+void NVMHTM_set_checkpointer_threads(int nb_threads) { /* empty */ }
+
 void NVMHTM_validate(int id, bitset<MAX_NB_THREADS>&) { /* empty */ }
 
 void NVMHTM_crash()
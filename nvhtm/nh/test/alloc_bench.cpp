@@ -0,0 +1,172 @@
+#include "rdtsc.h"
+#include "nh.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+/*
+ * Reuse of the pool allocator (pool_alloc.h). Each thread runs ROUNDS
+ * rounds, a round allocates BLOCKS blocks of random sizes up to SIZE bytes
+ * from the pool (NVMHTM_malloc), tags them and then frees them
+ * (NVMHTM_pfree). The sizes repeat each round, then the blocks of a round
+ * must be the ones of the first round: the pool does not grow after it.
+ *
+ * ERRORS counts the blocks not reused (or not allocated) and the tags
+ * overwritten, i.e., blocks given to two threads at once.
+ */
+
+using namespace std;
+
+int nb_threads = 4, nb_rounds = 100, nb_blocks = 1024, max_size = 256,
+    pool_pages = 8192;
+char *gnuplot_file;
+
+static void *pool;
+static volatile int start_flag;
+
+#define RAND_R_FNC(seed) ({ \
+    unsigned long next = seed; \
+    next *= 1103515245; \
+    next += 12345; \
+    seed = next; \
+    (next / 65536); \
+})
+
+static void worker(long long *errors)
+{
+    unsigned long seed;
+    vector<GRANULE_TYPE*> blocks(nb_blocks), first(nb_blocks), sorted;
+    int tid, r, i;
+
+    NVHTM_thr_init();
+    tid = TM_tid_var;
+
+    while (!start_flag) PAUSE();
+
+    for (r = 0; r < nb_rounds; ++r) {
+        seed = (unsigned long) (tid + 1);
+
+        for (i = 0; i < nb_blocks; ++i) {
+            size_t size = sizeof(GRANULE_TYPE)
+                + RAND_R_FNC(seed) % (max_size - sizeof(GRANULE_TYPE) + 1);
+            blocks[i] = (GRANULE_TYPE*) NVMHTM_malloc(pool, size);
+            if (blocks[i] != NULL) {
+                *blocks[i] = (GRANULE_TYPE) (tid * nb_blocks + i);
+            }
+        }
+
+        for (i = 0; i < nb_blocks; ++i) {
+            if (blocks[i] == NULL) {
+                (*errors)++;
+            }
+            else if (*blocks[i] != (GRANULE_TYPE) (tid * nb_blocks + i)) {
+                (*errors)++;
+            }
+        }
+
+        sorted = blocks;
+        sort(sorted.begin(), sorted.end());
+        if (r == 0) {
+            first = sorted;
+        }
+        else {
+            for (i = 0; i < nb_blocks; ++i) {
+                if (sorted[i] != first[i]) (*errors)++;
+            }
+        }
+
+        for (i = 0; i < nb_blocks; ++i) {
+            NVMHTM_pfree(pool, blocks[i]);
+        }
+    }
+
+    NVHTM_thr_exit();
+}
+
+int main(int argc, char **argv)
+{
+    int i = 1, t;
+    vector<long long> errors;
+    vector<thread> thrs;
+    long long total = 0;
+    TIMER_T ts1, ts2;
+    double time_taken, throughput;
+
+    while (i < argc) {
+        if (strcmp(argv[i], "THREADS") == 0) {
+            nb_threads = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "ROUNDS") == 0) {
+            nb_rounds = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "BLOCKS") == 0) {
+            nb_blocks = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "SIZE") == 0) {
+            max_size = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "POOL_PAGES") == 0) {
+            pool_pages = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "GNUPLOT_FILE") == 0) {
+            gnuplot_file = strdup(argv[i + 1]);
+        }
+        i += 2;
+    }
+
+    printf(" Start alloc bench ====== \n");
+    printf("        THREADS: %i\n", nb_threads);
+    printf("         ROUNDS: %i\n", nb_rounds);
+    printf("         BLOCKS: %i\n", nb_blocks);
+    printf("           SIZE: %i\n", max_size);
+    printf("     POOL_PAGES: %i\n", pool_pages);
+    printf(" ======================== \n");
+
+    NVHTM_init(nb_threads);
+
+    pool = NVHTM_malloc((size_t) pool_pages * 4096);
+    // one line per thread
+    errors.resize(nb_threads * (CACHE_LINE_SIZE / sizeof (long long)));
+
+    for (t = 0; t < nb_threads; ++t) {
+        thrs.push_back(thread(worker,
+            &(errors[t * (CACHE_LINE_SIZE / sizeof (long long))])));
+    }
+    __sync_synchronize();
+    TIMER_READ(ts1);
+    start_flag = 1;
+    for (t = 0; t < nb_threads; ++t) {
+        thrs[t].join();
+        total += errors[t * (CACHE_LINE_SIZE / sizeof (long long))];
+    }
+    TIMER_READ(ts2);
+    time_taken = TIMER_DIFF_SECONDS(ts1, ts2);
+    // a malloc and a pfree each
+    throughput = (double) nb_threads * nb_rounds * nb_blocks / time_taken;
+
+    NVHTM_shutdown();
+
+    printf("#%s\t%s\t%s\t%s\t%s\t%s\n", "THREADS", "BLOCKS", "SIZE", "TIME",
+        "THROUGHPUT", "ERRORS");
+    printf("%i\t%i\t%i\t%f\t%f\t%lli\n", nb_threads, nb_blocks, max_size,
+        time_taken, throughput, total);
+
+    if (gnuplot_file != NULL) {
+        FILE *gp_fp = fopen(gnuplot_file, "a");
+        if (ftell(gp_fp) < 8) {
+            fprintf(gp_fp, "#\t%s\t%s\t%s\t%s\t%s\n", "THREADS", "BLOCKS",
+                "SIZE", "TIME", "THROUGHPUT");
+        }
+        fprintf(gp_fp, "\t%i\t%i\t%i\t%f\t%f\n", nb_threads, nb_blocks,
+            max_size, time_taken, throughput);
+        fclose(gp_fp);
+    }
+
+    return total ? EXIT_FAILURE : EXIT_SUCCESS;
+}
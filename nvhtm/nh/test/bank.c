@@ -258,6 +258,7 @@ int main(int argc, char **argv)
     int i = 1;
     int reboot = 0;
     int args_threads[MAX_NB_THREADS];
+    int chkp_threads = 0;
 
     while (i < argc) {
         if (strcmp(argv[i], "REBOOT") == 0) {
@@ -292,6 +293,9 @@ int main(int argc, char **argv)
         }
 		else if (strcmp(argv[i], "SEQ") == 0) {
             seq = atoi(argv[i + 1]);
+        }
+		else if (strcmp(argv[i], "CHKP_THREADS") == 0) {
+            chkp_threads = atoi(argv[i + 1]);
         }
         i += 2;
     }
@@ -311,10 +315,15 @@ int main(int argc, char **argv)
     printf(" TXs PER THREAD: %i\n", transactions);
     printf(" TRANSFER_LIMIT: %i\n", transfer_limit);
     printf("     SEQUENTIAL: %i\n", seq);
+    printf("   CHKP_THREADS: %i\n", chkp_threads);
     printf(" ======================== \n");
 
 	// NH_free(NH_alloc(64)); // TEST
 	
+    if (chkp_threads > 0) {
+        // before the init (the checkpointer may be forked there)
+        NVHTM_set_checkpointer_threads(chkp_threads);
+    }
     NVHTM_init(threads);
 	
 	// NH_free(NH_alloc(64)); // TEST
@@ -0,0 +1,195 @@
+#include "utils.h"
+#include "cl_table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Coalescing of the checkpoint writes: the unordered_map + bit map used
+ * before against cl_table. Each sample dedups ENTRIES word writes (the log
+ * walked backward) and lists the dirty lines, as in one checkpoint.
+ *
+ * Patterns:
+ *   SEQ  - streaming, consecutive words
+ *   RAND - uniform over LINES lines
+ *   HOT  - 90% of the writes in 1% of the lines
+ *   SAME - a few words of the same line
+ */
+
+using namespace std;
+
+int nb_entries = 1000000, samples = 10;
+long long nb_lines = 1024 * 1024;
+char *gnuplot_file;
+
+enum { SEQ = 0, RAND, HOT, SAME, NB_PATTERNS };
+static const char *pattern_names[] = { "SEQ", "RAND", "HOT", "SAME" };
+
+static uint64_t *heap;
+static uint64_t **addrs;
+
+static unsigned long next_rand(unsigned long *seed)
+{
+    *seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *seed >> 17;
+}
+
+static void gen_addrs(int pattern)
+{
+    unsigned long seed = 12345;
+    long long nb_words = nb_lines * 8, hot = nb_words / 100 + 8;
+    int i;
+
+    for (i = 0; i < nb_entries; ++i) {
+        long long w = 0;
+        switch (pattern) {
+            case SEQ:
+                w = i % nb_words;
+                break;
+            case RAND:
+                w = next_rand(&seed) % nb_words;
+                break;
+            case HOT:
+                w = next_rand(&seed) % 10 ? next_rand(&seed) % hot
+                    : next_rand(&seed) % nb_words;
+                break;
+            case SAME:
+                w = next_rand(&seed) % 4;
+                break;
+        }
+        addrs[i] = &(heap[w]);
+    }
+}
+
+static long long run_map()
+{
+    unordered_map<uint64_t*, char> writes_map;
+    vector<uint64_t*> writes_list;
+    long long nb_new = 0;
+    int i;
+
+    writes_map.reserve(nb_entries);
+    writes_list.reserve(nb_entries);
+
+    for (i = nb_entries - 1; i >= 0; --i) {
+        uint64_t *cl_addr = (uint64_t*) (((uintptr_t) addrs[i] >> 6) << 6);
+        char bit_map = 1 << (((uintptr_t) addrs[i] & 0x38) >> 3);
+        auto it = writes_map.find(cl_addr);
+        if (it == writes_map.end()) {
+            writes_map.insert(make_pair(cl_addr, bit_map));
+            writes_list.push_back(cl_addr);
+            nb_new++;
+        } else if (!(it->second & bit_map)) {
+            it->second |= bit_map;
+            nb_new++;
+        }
+    }
+
+    return nb_new + writes_list.size();
+}
+
+static long long run_table(cl_table_s *t)
+{
+    long long nb_new = 0;
+    int i;
+
+    cl_table_clear(t, nb_entries);
+
+    for (i = nb_entries - 1; i >= 0; --i) {
+        nb_new += cl_table_add_word(t, addrs[i]);
+    }
+
+    return nb_new + t->nb_lines;
+}
+
+int main(int argc, char **argv)
+{
+    int i = 1, p, s;
+    cl_table_s *table;
+    TIMER_T ts1, ts2;
+
+    while (i < argc) {
+        if (strcmp(argv[i], "ENTRIES") == 0) {
+            nb_entries = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "LINES") == 0) {
+            nb_lines = atoll(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "SAMPLES") == 0) {
+            samples = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "GNUPLOT_FILE") == 0) {
+            gnuplot_file = strdup(argv[i + 1]);
+        }
+        i += 2;
+    }
+
+    printf(" Start cl_table bench === \n");
+    printf("        ENTRIES: %i\n", nb_entries);
+    printf("          LINES: %lli\n", nb_lines);
+    printf("        SAMPLES: %i\n", samples);
+    printf(" ======================== \n");
+
+    if (posix_memalign((void**) &heap, 64, nb_lines * 64) != 0) {
+        perror("posix_memalign");
+        return EXIT_FAILURE;
+    }
+    addrs = (uint64_t**) malloc(nb_entries * sizeof (uint64_t*));
+    table = cl_table_init(nb_entries);
+
+    printf("#%s\t%s\t%s\t%s\t%s\n", "PATTERN", "ENTRIES", "MAP_M_S",
+        "TABLE_M_S", "SPEEDUP");
+
+    for (p = 0; p < NB_PATTERNS; ++p) {
+        double time_map = 0, time_table = 0, map_ms, table_ms;
+        long long res_map = 0, res_table = 0;
+
+        gen_addrs(p);
+
+        for (s = 0; s < samples; ++s) {
+            TIMER_READ(ts1);
+            res_map = run_map();
+            TIMER_READ(ts2);
+            time_map += TIMER_DIFF_SECONDS(ts1, ts2);
+
+            TIMER_READ(ts1);
+            res_table = run_table(table);
+            TIMER_READ(ts2);
+            time_table += TIMER_DIFF_SECONDS(ts1, ts2);
+        }
+
+        if (res_map != res_table) {
+            fprintf(stderr, "%s: map found %lli, table found %lli\n",
+                pattern_names[p], res_map, res_table);
+            return EXIT_FAILURE;
+        }
+
+        map_ms = (double) nb_entries * samples / time_map / 1e6;
+        table_ms = (double) nb_entries * samples / time_table / 1e6;
+
+        printf("%s\t%i\t%f\t%f\t%f\n", pattern_names[p], nb_entries,
+            map_ms, table_ms, table_ms / map_ms);
+
+        if (gnuplot_file != NULL) {
+            FILE *gp_fp = fopen(gnuplot_file, "a");
+            if (ftell(gp_fp) < 8) {
+                fprintf(gp_fp, "#\t%s\t%s\t%s\t%s\n", "PATTERN", "ENTRIES",
+                    "MAP_M_S", "TABLE_M_S");
+            }
+            fprintf(gp_fp, "\t%s\t%i\t%f\t%f\n", pattern_names[p],
+                nb_entries, map_ms, table_ms);
+            fclose(gp_fp);
+        }
+    }
+
+    cl_table_destroy(table);
+    free(addrs);
+    free(heap);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,191 @@
+#include "rdtsc.h"
+#include "arch.h"
+#include "log_order.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <thread>
+#include <vector>
+
+/*
+ * Latency of the commit-order validation (PC solution) against the number
+ * of threads. Each thread runs TXS writers of WORK cycles and then waits
+ * for the transactions that may commit with a smaller ts, as
+ * NVMHTM_validate does.
+ *
+ * Validations:
+ *   SCAN  - every thread's counters (one line each) and ts before, polled
+ *           until none is below the ts (as the dangerous_threads loop)
+ *   ORDER - the packed frontier of log_order.h
+ */
+
+using namespace std;
+
+int nb_threads = 4, nb_txs = 100000, work = 1000, samples = 5;
+char *gnuplot_file;
+
+enum { SCAN = 0, ORDER, NB_VALIDATIONS };
+static const char *validation_names[] = { "SCAN", "ORDER" };
+
+typedef struct scan_counters_ {
+    volatile ts_s local_counter, global_counter;
+} __attribute__((aligned(CACHE_LINE_SIZE))) scan_counters_s;
+
+static scan_counters_s *counters;
+static volatile ts_s *before_ts;
+static volatile int start_flag;
+
+static ts_s scan_slot(int i)
+{
+    ts_s local = counters[i].local_counter, ts;
+
+    if (!(local & 1)) {
+        return LOG_ORDER_IDLE;
+    }
+    ts = counters[i].global_counter; // commit ts, 0 while running
+    return ts > before_ts[i] ? ts : before_ts[i];
+}
+
+static void scan_wait(ts_s ts)
+{
+    int i, any;
+
+    do {
+        any = 0;
+        for (i = 0; i < nb_threads; ++i) {
+            if (scan_slot(i) < ts) {
+                any = 1;
+            }
+        }
+        if (any) PAUSE();
+    } while (any);
+}
+
+static void worker(int tid, int validation, ts_s *wait_time)
+{
+    ts_s ts, ts1;
+    int i;
+
+    while (!start_flag) PAUSE();
+
+    for (i = 0; i < nb_txs; ++i) {
+        ts = rdtscp();
+        if (validation == SCAN) {
+            counters[tid].global_counter = 0;
+            before_ts[tid] = ts;
+            counters[tid].local_counter++;
+        } else {
+            LOG_ORDER_set(tid, ts);
+        }
+
+        while (rdtscp() - ts < (ts_s) work) PAUSE(); // the HTM body
+
+        ts = rdtscp();
+        ts1 = ts;
+        if (validation == SCAN) {
+            counters[tid].global_counter = ts;
+            __sync_synchronize();
+            scan_wait(ts);
+            *wait_time += rdtscp() - ts1;
+            counters[tid].local_counter++;
+        } else {
+            LOG_ORDER_set(tid, ts);
+            __sync_synchronize();
+            LOG_ORDER_wait(ts);
+            *wait_time += rdtscp() - ts1;
+            LOG_ORDER_idle(tid);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int i = 1, v, s, t;
+    vector<ts_s> wait_times;
+
+    while (i < argc) {
+        if (strcmp(argv[i], "THREADS") == 0) {
+            nb_threads = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "TXS") == 0) {
+            nb_txs = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "WORK") == 0) {
+            work = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "SAMPLES") == 0) {
+            samples = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "GNUPLOT_FILE") == 0) {
+            gnuplot_file = strdup(argv[i + 1]);
+        }
+        i += 2;
+    }
+
+    printf(" Start commit bench ===== \n");
+    printf("        THREADS: %i\n", nb_threads);
+    printf("            TXS: %i\n", nb_txs);
+    printf("           WORK: %i\n", work);
+    printf("        SAMPLES: %i\n", samples);
+    printf(" ======================== \n");
+
+    if (posix_memalign((void**) &counters, CACHE_LINE_SIZE,
+            nb_threads * sizeof (scan_counters_s)) != 0
+        || posix_memalign((void**) &before_ts, CACHE_LINE_SIZE,
+            nb_threads * sizeof (ts_s)) != 0) {
+        perror("posix_memalign");
+        return EXIT_FAILURE;
+    }
+    memset((void*) counters, 0, nb_threads * sizeof (scan_counters_s));
+    memset((void*) before_ts, 0, nb_threads * sizeof (ts_s));
+    LOG_ORDER_init(nb_threads);
+    wait_times.resize(nb_threads * (CACHE_LINE_SIZE / sizeof (ts_s)));
+
+    printf("#%s\t%s\t%s\n", "VALIDATION", "THREADS", "WAIT_CYCLES");
+
+    for (v = 0; v < NB_VALIDATIONS; ++v) {
+        double cycles = 0;
+
+        for (s = 0; s < samples; ++s) {
+            vector<thread> thrs;
+            ts_s total = 0;
+
+            fill(wait_times.begin(), wait_times.end(), 0);
+            start_flag = 0;
+            for (t = 0; t < nb_threads; ++t) {
+                // one line per thread
+                thrs.push_back(thread(worker, t, v,
+                    &(wait_times[t * (CACHE_LINE_SIZE / sizeof (ts_s))])));
+            }
+            __sync_synchronize();
+            start_flag = 1;
+            for (t = 0; t < nb_threads; ++t) {
+                thrs[t].join();
+                total += wait_times[t * (CACHE_LINE_SIZE / sizeof (ts_s))];
+            }
+            cycles += (double) total / ((double) nb_threads * nb_txs);
+        }
+        cycles /= samples;
+
+        printf("%s\t%i\t%f\n", validation_names[v], nb_threads, cycles);
+
+        if (gnuplot_file != NULL) {
+            FILE *gp_fp = fopen(gnuplot_file, "a");
+            if (ftell(gp_fp) < 8) {
+                fprintf(gp_fp, "#\t%s\t%s\t%s\n", "VALIDATION", "THREADS",
+                    "WAIT_CYCLES");
+            }
+            fprintf(gp_fp, "\t%s\t%i\t%f\n", validation_names[v],
+                nb_threads, cycles);
+            fclose(gp_fp);
+        }
+    }
+
+    free((void*) counters);
+    free((void*) before_ts);
+
+    return EXIT_SUCCESS;
+}
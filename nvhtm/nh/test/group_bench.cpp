@@ -0,0 +1,152 @@
+#include "rdtsc.h"
+#include "nh.h"
+#include "log_group.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <thread>
+#include <vector>
+
+/*
+ * Throughput of the small writers of the PC solution, with the group commit
+ * of the markers (GROUP_COMMIT=1) or without it. Each thread runs TXS
+ * transactions that add 1 to WRITES random words of a pool of WORDS words
+ * (shared by the threads). After the run the words must add up to
+ * THREADS x TXS x WRITES, ERRORS is the difference.
+ */
+
+using namespace std;
+
+int nb_threads = 4, nb_txs = 100000, nb_writes = 2, nb_words = 65536;
+char *gnuplot_file;
+
+static GRANULE_TYPE *pool;
+static volatile int start_flag;
+
+#define RAND_R_FNC(seed) ({ \
+    unsigned long next = seed; \
+    next *= 1103515245; \
+    next += 12345; \
+    seed = next; \
+    (next / 65536); \
+})
+
+static void worker()
+{
+    unsigned long seed;
+    vector<long> idx(nb_writes);
+    int tid, i, j;
+
+    NVHTM_thr_init();
+    tid = TM_tid_var;
+    seed = (unsigned long) (tid + 1);
+
+    while (!start_flag) PAUSE();
+
+    for (i = 0; i < nb_txs; ++i) {
+        // outside the transaction, the body is retried on abort
+        for (j = 0; j < nb_writes; ++j) {
+            idx[j] = RAND_R_FNC(seed) % nb_words;
+        }
+
+        NH_begin();
+        for (j = 0; j < nb_writes; ++j) {
+            GRANULE_TYPE val = NH_read(&(pool[idx[j]]));
+            NH_write(&(pool[idx[j]]), val + 1);
+        }
+        NH_commit();
+    }
+
+    NVHTM_thr_exit();
+}
+
+int main(int argc, char **argv)
+{
+    int i = 1, t;
+    long long errors, total = 0, nb_groups = 0, nb_grouped_txs = 0;
+    vector<thread> thrs;
+    TIMER_T ts1, ts2;
+    double time_taken, throughput, group_size;
+
+    while (i < argc) {
+        if (strcmp(argv[i], "THREADS") == 0) {
+            nb_threads = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "TXS") == 0) {
+            nb_txs = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "WRITES") == 0) {
+            nb_writes = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "WORDS") == 0) {
+            nb_words = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "GNUPLOT_FILE") == 0) {
+            gnuplot_file = strdup(argv[i + 1]);
+        }
+        i += 2;
+    }
+
+    printf(" Start group bench ====== \n");
+    printf("        THREADS: %i\n", nb_threads);
+    printf("            TXS: %i\n", nb_txs);
+    printf("         WRITES: %i\n", nb_writes);
+    printf("          WORDS: %i\n", nb_words);
+    #ifdef LOG_GROUP_COMMIT
+    printf("   GROUP_COMMIT: 1\n");
+    #else /* !LOG_GROUP_COMMIT */
+    printf("   GROUP_COMMIT: 0\n");
+    #endif /* LOG_GROUP_COMMIT */
+    printf(" ======================== \n");
+
+    NVHTM_init(nb_threads);
+
+    pool = (GRANULE_TYPE*) NVHTM_malloc(nb_words * sizeof(GRANULE_TYPE));
+    memset(pool, 0, nb_words * sizeof(GRANULE_TYPE));
+
+    for (t = 0; t < nb_threads; ++t) {
+        thrs.push_back(thread(worker));
+    }
+    __sync_synchronize();
+    TIMER_READ(ts1);
+    start_flag = 1;
+    for (t = 0; t < nb_threads; ++t) {
+        thrs[t].join();
+    }
+    TIMER_READ(ts2);
+    time_taken = TIMER_DIFF_SECONDS(ts1, ts2);
+    throughput = (double) nb_threads * nb_txs / time_taken;
+
+    #ifdef LOG_GROUP_COMMIT
+    LOG_GROUP_stats(&nb_groups, &nb_grouped_txs);
+    #endif /* LOG_GROUP_COMMIT */
+    group_size = nb_groups > 0 ? (double) nb_grouped_txs / nb_groups : 0;
+
+    NVHTM_shutdown();
+
+    for (i = 0; i < nb_words; ++i) {
+        total += pool[i];
+    }
+    errors = (long long) nb_threads * nb_txs * nb_writes - total;
+
+    printf("#%s\t%s\t%s\t%s\t%s\t%s\n", "THREADS", "WRITES", "TIME",
+        "THROUGHPUT", "GROUP_SIZE", "ERRORS");
+    printf("%i\t%i\t%f\t%f\t%f\t%lli\n", nb_threads, nb_writes, time_taken,
+        throughput, group_size, errors);
+
+    if (gnuplot_file != NULL) {
+        FILE *gp_fp = fopen(gnuplot_file, "a");
+        if (ftell(gp_fp) < 8) {
+            fprintf(gp_fp, "#\t%s\t%s\t%s\t%s\t%s\n", "THREADS", "WRITES",
+                "TIME", "THROUGHPUT", "GROUP_SIZE");
+        }
+        fprintf(gp_fp, "\t%i\t%i\t%f\t%f\t%f\n", nb_threads, nb_writes,
+            time_taken, throughput, group_size);
+        fclose(gp_fp);
+    }
+
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
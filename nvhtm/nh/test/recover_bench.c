@@ -0,0 +1,176 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif /* _GNU_SOURCE */
+
+#include "rdtsc.h"
+#include "nvhtm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Fills the per-thread logs with committed transactions (as if the
+ * application crashed with full logs) and measures the throughput of
+ * LOG_recover() in GB/s of log replayed.
+ */
+
+int nb_logs = 4, nb_workers = 1, tx_size = 8, samples = 5;
+long long log_bytes = 16 * 1024 * 1024, heap_lines = 1024 * 1024;
+char *gnuplot_file;
+
+GRANULE_TYPE *heap, *expected;
+ts_s global_ts;
+
+#define RAND_R_FNC_aux(seed) ({ \
+    register unsigned long next = seed; \
+    register unsigned long result; \
+    next *= 1103515245; \
+    next += 12345; \
+    result = (unsigned long) (next / 65536) % 2048; \
+    next *= 1103515245; \
+    next += 12345; \
+    result <<= 10; \
+    result ^= (unsigned long) (next / 65536) % 1024; \
+    next *= 1103515245; \
+    next += 12345; \
+    result <<= 10; \
+    result ^= (unsigned long) (next / 65536) % 1024; \
+    seed = next; \
+    result; \
+})
+
+static void push_entry(NVLog_s *log, GRANULE_TYPE *addr, GRANULE_TYPE value)
+{
+    log->ptr[log->end].addr = addr;
+    log->ptr[log->end].value = value;
+    log->end = (log->end + 1) & (log->size_of_log - 1);
+}
+
+// round-robin over the logs, one transaction at a time
+static void fill_logs()
+{
+    unsigned long seed = 12345;
+    long long nb_words = heap_lines * CACHE_LINE_SIZE / sizeof(GRANULE_TYPE);
+    int i, j, is_full = 0;
+
+    for (i = 0; i < nb_logs; ++i) {
+        NH_global_logs[i]->start = NH_global_logs[i]->end = 0;
+    }
+
+    while (!is_full) {
+        for (i = 0; i < nb_logs; ++i) {
+            NVLog_s *log = NH_global_logs[i];
+            int used = (log->end - log->start) & (log->size_of_log - 1);
+
+            if (used + tx_size + 1 >= log->size_of_log) {
+                is_full = 1;
+                break;
+            }
+            global_ts++;
+            for (j = 0; j < tx_size; ++j) {
+                long long w = RAND_R_FNC_aux(seed) % nb_words;
+                GRANULE_TYPE val = (GRANULE_TYPE) RAND_R_FNC_aux(seed);
+                push_entry(log, &(heap[w]), val);
+                expected[w] = val;
+            }
+            push_entry(log, (GRANULE_TYPE*) LOG_TS, global_ts);
+        }
+    }
+
+    // a crashed transaction without commit marker must not be replayed
+    push_entry(NH_global_logs[0], &(heap[0]), ~expected[0]);
+}
+
+int main(int argc, char **argv)
+{
+    int i = 1, s, errors;
+    long long nb_words, replayed = 0;
+    double time_taken = 0, gbs;
+    TIMER_T ts1, ts2;
+    void *log_pool;
+
+    while (i < argc) {
+        if (strcmp(argv[i], "LOGS") == 0) {
+            nb_logs = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "WORKERS") == 0) {
+            nb_workers = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "LOG_BYTES") == 0) {
+            log_bytes = atoll(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "TX_SIZE") == 0) {
+            tx_size = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "HEAP_LINES") == 0) {
+            heap_lines = atoll(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "SAMPLES") == 0) {
+            samples = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "GNUPLOT_FILE") == 0) {
+            gnuplot_file = strdup(argv[i + 1]);
+        }
+        i += 2;
+    }
+
+    printf(" Start recovery bench === \n");
+    printf("           LOGS: %i\n", nb_logs);
+    printf("        WORKERS: %i\n", nb_workers);
+    printf("      LOG_BYTES: %lli\n", log_bytes);
+    printf("        TX_SIZE: %i\n", tx_size);
+    printf("     HEAP_LINES: %lli\n", heap_lines);
+    printf(" ======================== \n");
+
+    nb_words = heap_lines * CACHE_LINE_SIZE / sizeof(GRANULE_TYPE);
+    heap = (GRANULE_TYPE*) malloc(nb_words * sizeof(GRANULE_TYPE));
+    expected = (GRANULE_TYPE*) malloc(nb_words * sizeof(GRANULE_TYPE));
+    memset(heap, 0, nb_words * sizeof(GRANULE_TYPE));
+    memset(expected, 0, nb_words * sizeof(GRANULE_TYPE));
+
+    TM_nb_threads = nb_logs;
+    NH_global_logs = (NVLog_s**) malloc(nb_logs * sizeof(NVLog_s*));
+    log_pool = malloc(log_bytes * nb_logs);
+    for (i = 0; i < nb_logs; ++i) {
+        NH_global_logs[i] = LOG_init_1thread((char*)log_pool + i * log_bytes,
+            log_bytes);
+    }
+
+    for (s = 0; s < samples; ++s) {
+        fill_logs();
+        TIMER_READ(ts1);
+        replayed += LOG_recover(nb_workers);
+        TIMER_READ(ts2);
+        time_taken += TIMER_DIFF_SECONDS(ts1, ts2);
+    }
+
+    errors = 0;
+    for (i = 0; i < nb_words; ++i) {
+        if (heap[i] != expected[i]) errors++;
+    }
+
+    gbs = (double) replayed / time_taken / 1e9;
+
+    printf("#%s\t%s\t%s\t%s\t%s\t%s\n", "LOGS", "WORKERS", "LOG_BYTES",
+        "TIME", "GB_S", "ERRORS");
+    printf("%i\t%i\t%lli\t%e\t%f\t%i\n", nb_logs, nb_workers, log_bytes,
+        time_taken / samples, gbs, errors);
+
+    if (gnuplot_file != NULL) {
+        FILE *gp_fp = fopen(gnuplot_file, "a");
+        if (ftell(gp_fp) < 8) {
+            fprintf(gp_fp, "#\t%s\t%s\t%s\t%s\t%s\n", "LOGS", "WORKERS",
+                "LOG_BYTES", "TIME", "GB_S");
+        }
+        fprintf(gp_fp, "\t%i\t%i\t%lli\t%e\t%f\n", nb_logs, nb_workers,
+            log_bytes, time_taken / samples, gbs);
+        fclose(gp_fp);
+    }
+
+    free(log_pool);
+    free(heap);
+    free(expected);
+
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,18 @@
+#!/bin/bash
+
+SAMPLES=5
+
+# run from the nh folder
+make clean && make SOLUTION=4 DO_CHECKPOINT=1 alloc_bench
+for i in `seq $SAMPLES`
+do
+	for s in 64 256 4096
+	do
+		for t in 1 2 4 8 14 28
+		do
+			ipcrm -M 0x00054321 # kills the shared memory log segment
+			./alloc_bench THREADS $t SIZE $s POOL_PAGES 65536 \
+				GNUPLOT_FILE alloc_"$s".txt >/dev/null
+		done
+	done
+done
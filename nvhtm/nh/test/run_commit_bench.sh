@@ -0,0 +1,13 @@
+#!/bin/bash
+
+SAMPLES=5
+
+# run from the nh folder after: make SOLUTION=4 commit_bench
+for w in 100 1000 10000
+do
+	for t in 1 2 4 8 14 28 56
+	do
+		./commit_bench THREADS $t WORK $w SAMPLES $SAMPLES \
+			GNUPLOT_FILE commit_"$w".txt >/dev/null
+	done
+done
@@ -0,0 +1,21 @@
+#!/bin/bash
+
+SAMPLES=5
+
+# run from the nh folder
+for g in 0 1
+do
+	make clean && make SOLUTION=4 DO_CHECKPOINT=1 GROUP_COMMIT=$g group_bench
+	for i in `seq $SAMPLES`
+	do
+		for w in 1 2 8 32
+		do
+			for t in 1 2 4 8 14 28
+			do
+				ipcrm -M 0x00054321 # kills the shared memory log segment
+				./group_bench THREADS $t WRITES $w \
+					GNUPLOT_FILE group_G"$g"_"$w".txt >/dev/null
+			done
+		done
+	done
+done
@@ -0,0 +1,13 @@
+#!/bin/bash
+
+SAMPLES=5
+
+# run from the nh folder after: make recover_bench
+for l in 1048576 4194304 16777216 67108864
+do
+	for w in 1 2 4 8 16 32
+	do
+		./recover_bench LOGS 32 WORKERS $w LOG_BYTES $l SAMPLES $SAMPLES \
+			GNUPLOT_FILE recover_"$l".txt >/dev/null
+	done
+done
@@ -0,0 +1,21 @@
+#!/bin/bash
+
+SAMPLES=5
+
+# run from the nh folder
+for s in 0 1
+do
+	make clean && make SOLUTION=4 DO_CHECKPOINT=1 REAL_CHKP=1 CHKP_SNAPSHOT=$s \
+		snapshot_bench
+	for i in `seq $SAMPLES`
+	do
+		for p in 256 4096 65536
+		do
+			for t in 1 2 4 8 14 28
+			do
+				./snapshot_bench THREADS $t POOL_PAGES $p \
+					GNUPLOT_FILE snapshot_S"$s"_"$p".txt >/dev/null
+			done
+		done
+	done
+done
@@ -0,0 +1,18 @@
+#!/bin/bash
+
+SAMPLES=5
+
+# run from the nh folder
+for s in 0 1
+do
+	make clean && make SOLUTION=4 DO_CHECKPOINT=1 SOFT_TRANSLATION=$s \
+		translation_bench
+	for w in 1 8 32
+	do
+		for t in 1 2 4 8 14 28
+		do
+			./translation_bench THREADS $t WRITES $w SAMPLES $SAMPLES \
+				GNUPLOT_FILE translation_ST"$s"_"$w".txt >/dev/null
+		done
+	done
+done
@@ -0,0 +1,156 @@
+#include "rdtsc.h"
+#include "nh.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <thread>
+#include <vector>
+
+/*
+ * Round trip of the checkpoint (REAL_CHKP=1 SOLUTION=4 DO_CHECKPOINT=1), with
+ * the snapshot rounds (CHKP_SNAPSHOT=1) or the backward apply of the logs.
+ * Each thread writes WRITES random words of a pool of POOL_PAGES pages in
+ * TXS transactions, while the checkpointer runs. After the run the logs left
+ * are replayed into the image (NVHTM_recover), it must then be equal to the
+ * pool: ERRORS counts the words that differ.
+ */
+
+using namespace std;
+
+int nb_threads = 4, nb_txs = 100000, nb_writes = 8, pool_pages = 1024;
+char *gnuplot_file;
+
+static GRANULE_TYPE *pool;
+static long long nb_words;
+static volatile int start_flag;
+
+#define RAND_R_FNC(seed) ({ \
+    unsigned long next = seed; \
+    next *= 1103515245; \
+    next += 12345; \
+    seed = next; \
+    (next / 65536); \
+})
+
+static void worker()
+{
+    unsigned long seed;
+    vector<long long> idx(nb_writes);
+    vector<GRANULE_TYPE> val(nb_writes);
+    int tid, i, j;
+
+    NVHTM_thr_init();
+    tid = TM_tid_var;
+    seed = (unsigned long) (tid + 1);
+
+    while (!start_flag) PAUSE();
+
+    for (i = 0; i < nb_txs; ++i) {
+        // outside the transaction, the body is retried on abort
+        for (j = 0; j < nb_writes; ++j) {
+            idx[j] = RAND_R_FNC(seed) % nb_words;
+            val[j] = (GRANULE_TYPE) RAND_R_FNC(seed);
+        }
+
+        NH_begin();
+        for (j = 0; j < nb_writes; ++j) {
+            NH_write(&(pool[idx[j]]), val[j]);
+        }
+        NH_commit();
+    }
+
+    NVHTM_thr_exit();
+}
+
+int main(int argc, char **argv)
+{
+    int i = 1, t, errors = 0;
+    long long k, nb_chkps;
+    NVMHTM_mem_s *instance;
+    GRANULE_TYPE *image;
+    vector<thread> thrs;
+    TIMER_T ts1, ts2;
+    double time_taken;
+
+    while (i < argc) {
+        if (strcmp(argv[i], "THREADS") == 0) {
+            nb_threads = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "TXS") == 0) {
+            nb_txs = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "WRITES") == 0) {
+            nb_writes = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "POOL_PAGES") == 0) {
+            pool_pages = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "GNUPLOT_FILE") == 0) {
+            gnuplot_file = strdup(argv[i + 1]);
+        }
+        i += 2;
+    }
+
+    printf(" Start snapshot bench === \n");
+    printf("        THREADS: %i\n", nb_threads);
+    printf("            TXS: %i\n", nb_txs);
+    printf("         WRITES: %i\n", nb_writes);
+    printf("     POOL_PAGES: %i\n", pool_pages);
+    #ifdef CHKP_SNAPSHOT
+    printf("       SNAPSHOT: 1\n");
+    #else /* !CHKP_SNAPSHOT */
+    printf("       SNAPSHOT: 0\n");
+    #endif /* CHKP_SNAPSHOT */
+    printf(" ======================== \n");
+
+    NVHTM_init(nb_threads);
+
+    nb_words = (long long) pool_pages * 4096 / sizeof(GRANULE_TYPE);
+    pool = (GRANULE_TYPE*) NVHTM_malloc(nb_words * sizeof(GRANULE_TYPE));
+    memset(pool, 0, nb_words * sizeof(GRANULE_TYPE));
+    NVHTM_cpy_to_checkpoint(pool);
+
+    for (t = 0; t < nb_threads; ++t) {
+        thrs.push_back(thread(worker));
+    }
+    __sync_synchronize();
+    TIMER_READ(ts1);
+    start_flag = 1;
+    for (t = 0; t < nb_threads; ++t) {
+        thrs[t].join();
+    }
+    TIMER_READ(ts2);
+    time_taken = TIMER_DIFF_SECONDS(ts1, ts2);
+
+    // stops the checkpointer
+    NVHTM_shutdown();
+    nb_chkps = NH_nb_checkpoints;
+
+    NVHTM_recover();
+    instance = NVMHTM_get_instance(pool);
+    image = (GRANULE_TYPE*) instance->chkp.ptr;
+    for (k = 0; k < nb_words; ++k) {
+        if (image[k] != pool[k]) errors++;
+    }
+
+    printf("#%s\t%s\t%s\t%s\t%s\t%s\n", "THREADS", "WRITES", "POOL_PAGES",
+        "TIME", "CHECKPOINTS", "ERRORS");
+    printf("%i\t%i\t%i\t%f\t%lli\t%i\n", nb_threads, nb_writes, pool_pages,
+        time_taken, nb_chkps, errors);
+
+    if (gnuplot_file != NULL) {
+        FILE *gp_fp = fopen(gnuplot_file, "a");
+        if (ftell(gp_fp) < 8) {
+            fprintf(gp_fp, "#\t%s\t%s\t%s\t%s\t%s\n", "THREADS", "WRITES",
+                "POOL_PAGES", "TIME", "CHECKPOINTS");
+        }
+        fprintf(gp_fp, "\t%i\t%i\t%i\t%f\t%lli\n", nb_threads, nb_writes,
+            pool_pages, time_taken, nb_chkps);
+        fclose(gp_fp);
+    }
+
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
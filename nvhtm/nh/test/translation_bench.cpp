@@ -0,0 +1,181 @@
+#include "rdtsc.h"
+#include "nh.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <thread>
+#include <vector>
+
+/*
+ * Cost of the software translation (SOFT_TRANSLATION=1) of the PC solution
+ * against the plain build. Each thread increments WRITES random words of its
+ * own slice of WORDS words (NH_read then NH_write) in TXS transactions.
+ *
+ * Checks, with SOFTWARE_TRANSLATION:
+ *   - the words read in and out of the transactions (NH_read and
+ *     NH_translate) have every committed increment (the shadow);
+ *   - the words of the pool have none, the transactions do not write it.
+ * Without it only the first check is done, on the pool.
+ */
+
+#ifndef NH_translate
+#define NH_translate(addr) (addr)
+#endif /* NH_translate */
+
+using namespace std;
+
+int nb_threads = 4, nb_txs = 100000, nb_writes = 8, nb_words = 4096,
+    samples = 5;
+char *gnuplot_file;
+
+static GRANULE_TYPE *pool;
+static GRANULE_TYPE *expected;
+static volatile int start_flag;
+
+#define RAND_R_FNC(seed) ({ \
+    unsigned long next = seed; \
+    next *= 1103515245; \
+    next += 12345; \
+    seed = next; \
+    (next / 65536) % 32768; \
+})
+
+// runs every sample: a new thread would take the tid, but not the shadow
+// pages, of an old one
+static void worker(ts_s *tx_cycles)
+{
+    unsigned long seed;
+    GRANULE_TYPE *slice, *exp_slice;
+    vector<int> idx(nb_writes);
+    ts_s ts;
+    int tid, i, j;
+
+    NVHTM_thr_init();
+    tid = TM_tid_var;
+    seed = (unsigned long) (tid + 1);
+    slice = &(pool[tid * nb_words]);
+    exp_slice = &(expected[tid * nb_words]);
+
+    while (!start_flag) PAUSE();
+
+    for (i = 0; i < nb_txs * samples; ++i) {
+        // outside the transaction, the body is retried on abort
+        for (j = 0; j < nb_writes; ++j) {
+            idx[j] = RAND_R_FNC(seed) % nb_words;
+        }
+
+        ts = rdtscp();
+        NH_begin();
+        for (j = 0; j < nb_writes; ++j) {
+            GRANULE_TYPE val = NH_read(&(slice[idx[j]]));
+            NH_write(&(slice[idx[j]]), val + 1);
+        }
+        NH_commit();
+        *tx_cycles += rdtscp() - ts;
+
+        for (j = 0; j < nb_writes; ++j) {
+            exp_slice[idx[j]]++;
+        }
+    }
+
+    NVHTM_thr_exit();
+}
+
+int main(int argc, char **argv)
+{
+    int i = 1, t, errors = 0;
+    long long nb_pool_words;
+    vector<ts_s> tx_cycles;
+    vector<thread> thrs;
+    ts_s total = 0;
+    double cycles;
+
+    while (i < argc) {
+        if (strcmp(argv[i], "THREADS") == 0) {
+            nb_threads = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "TXS") == 0) {
+            nb_txs = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "WRITES") == 0) {
+            nb_writes = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "WORDS") == 0) {
+            nb_words = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "SAMPLES") == 0) {
+            samples = atoi(argv[i + 1]);
+        }
+        else if (strcmp(argv[i], "GNUPLOT_FILE") == 0) {
+            gnuplot_file = strdup(argv[i + 1]);
+        }
+        i += 2;
+    }
+
+    printf(" Start translation bench  \n");
+    printf("        THREADS: %i\n", nb_threads);
+    printf("            TXS: %i\n", nb_txs);
+    printf("         WRITES: %i\n", nb_writes);
+    printf("          WORDS: %i\n", nb_words);
+    printf("        SAMPLES: %i\n", samples);
+    #ifdef SOFTWARE_TRANSLATION
+    printf("    TRANSLATION: 1\n");
+    #else /* !SOFTWARE_TRANSLATION */
+    printf("    TRANSLATION: 0\n");
+    #endif /* SOFTWARE_TRANSLATION */
+    printf(" ======================== \n");
+
+    NVHTM_init(nb_threads);
+
+    nb_pool_words = (long long) nb_threads * nb_words;
+    pool = (GRANULE_TYPE*) NVHTM_malloc(nb_pool_words * sizeof(GRANULE_TYPE));
+    expected = (GRANULE_TYPE*) malloc(nb_pool_words * sizeof(GRANULE_TYPE));
+    memset(pool, 0, nb_pool_words * sizeof(GRANULE_TYPE));
+    memset(expected, 0, nb_pool_words * sizeof(GRANULE_TYPE));
+    // one line per thread
+    tx_cycles.resize(nb_threads * (CACHE_LINE_SIZE / sizeof (ts_s)));
+
+    for (t = 0; t < nb_threads; ++t) {
+        thrs.push_back(thread(worker,
+            &(tx_cycles[t * (CACHE_LINE_SIZE / sizeof (ts_s))])));
+    }
+    __sync_synchronize();
+    start_flag = 1;
+    for (t = 0; t < nb_threads; ++t) {
+        thrs[t].join();
+        total += tx_cycles[t * (CACHE_LINE_SIZE / sizeof (ts_s))];
+    }
+    cycles = (double) total / ((double) nb_threads * nb_txs * samples);
+
+    for (i = 0; i < nb_pool_words; ++i) {
+        if (*NH_translate(&(pool[i])) != expected[i]) errors++;
+        #ifdef SOFTWARE_TRANSLATION
+        if (pool[i] != 0) errors++;
+        #endif /* SOFTWARE_TRANSLATION */
+    }
+
+    NVHTM_shutdown();
+
+    printf("#%s\t%s\t%s\t%s\t%s\n", "THREADS", "WRITES", "WORDS",
+        "TX_CYCLES", "ERRORS");
+    printf("%i\t%i\t%i\t%f\t%i\n", nb_threads, nb_writes, nb_words, cycles,
+        errors);
+
+    if (gnuplot_file != NULL) {
+        FILE *gp_fp = fopen(gnuplot_file, "a");
+        if (ftell(gp_fp) < 8) {
+            fprintf(gp_fp, "#\t%s\t%s\t%s\t%s\n", "THREADS", "WRITES",
+                "WORDS", "TX_CYCLES");
+        }
+        fprintf(gp_fp, "\t%i\t%i\t%i\t%f\n", nb_threads, nb_writes, nb_words,
+            cycles);
+        fclose(gp_fp);
+    }
+
+    free(expected);
+
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
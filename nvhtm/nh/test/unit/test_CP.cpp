@@ -0,0 +1,119 @@
+#include "test_CP.h"
+#include "cp.h"
+
+#include <thread>
+#include <vector>
+
+CPPUNIT_TEST_SUITE_REGISTRATION(test_CP);
+
+#define NB_ITEMS 64
+
+static cp_s *cp;
+
+test_CP::test_CP()
+{
+}
+
+test_CP::~test_CP()
+{
+}
+
+void test_CP::setUp()
+{
+    cp = cp_init(NB_ITEMS, sizeof (long));
+}
+
+void test_CP::tearDown()
+{
+    cp_destroy(cp);
+}
+
+void test_CP::testFullEmpty()
+{
+    long i, item;
+
+    CPPUNIT_ASSERT(!cp_consume(cp, &item));
+
+    // wraps a few times (the last slot of the buffer is used)
+    for (int round = 0; round < 3; ++round) {
+        for (i = 0; i < NB_ITEMS; ++i) {
+            CPPUNIT_ASSERT(cp_produce(cp, &i));
+        }
+        CPPUNIT_ASSERT(!cp_produce(cp, &i));
+        CPPUNIT_ASSERT_EQUAL(NB_ITEMS, cp_count_items(cp));
+
+        for (i = 0; i < NB_ITEMS; ++i) {
+            CPPUNIT_ASSERT(cp_consume(cp, &item));
+            CPPUNIT_ASSERT_EQUAL(i, item);
+        }
+        CPPUNIT_ASSERT(!cp_consume(cp, &item));
+    }
+}
+
+void test_CP::testBatch()
+{
+    long items[NB_ITEMS + 8], res[NB_ITEMS + 8], i;
+
+    for (i = 0; i < NB_ITEMS + 8; ++i) items[i] = i;
+
+    CPPUNIT_ASSERT_EQUAL(10, cp_produce_batch(cp, items, 10));
+    CPPUNIT_ASSERT_EQUAL(NB_ITEMS - 10,
+        cp_produce_batch(cp, items + 10, NB_ITEMS + 8));
+    CPPUNIT_ASSERT_EQUAL(0, cp_produce_batch(cp, items, 1));
+
+    CPPUNIT_ASSERT_EQUAL(3, cp_consume_batch(cp, res, 3));
+    CPPUNIT_ASSERT(cp_consume(cp, &res[3]));
+    CPPUNIT_ASSERT_EQUAL(NB_ITEMS - 4,
+        cp_consume_batch(cp, res + 4, NB_ITEMS + 8));
+    CPPUNIT_ASSERT_EQUAL(0, cp_consume_batch(cp, res, 1));
+
+    for (i = 0; i < NB_ITEMS; ++i) {
+        CPPUNIT_ASSERT_EQUAL(i, res[i]);
+    }
+}
+
+void test_CP::testConcurrent()
+{
+    const int nb_producers = 2, nb_consumers = 2, nb_per_producer = 100000;
+    std::vector<std::thread> threads;
+    long sums[nb_consumers] = { 0 }, total = 0;
+    volatile long nb_consumed = 0;
+
+    for (int p = 0; p < nb_producers; ++p) {
+        threads.push_back(std::thread([=]() {
+            long batch[5];
+            long i = 1;
+            while (i <= nb_per_producer) {
+                int nb = 0, done = 0;
+                while (nb < 5 && i + nb <= nb_per_producer) {
+                    batch[nb] = i + nb;
+                    nb++;
+                }
+                while (done < nb) {
+                    done += p % 2 ? cp_produce_batch(cp, batch + done, nb - done)
+                        : cp_produce(cp, batch + done);
+                }
+                i += nb;
+            }
+        }));
+    }
+
+    for (int c = 0; c < nb_consumers; ++c) {
+        threads.push_back(std::thread([=, &sums, &nb_consumed]() {
+            long batch[3];
+            while (nb_consumed < nb_producers * nb_per_producer) {
+                int nb = c % 2 ? cp_consume_batch(cp, batch, 3)
+                    : cp_consume(cp, batch);
+                for (int i = 0; i < nb; ++i) sums[c] += batch[i];
+                __sync_add_and_fetch(&nb_consumed, nb);
+            }
+        }));
+    }
+
+    for (auto &t : threads) t.join();
+
+    for (int c = 0; c < nb_consumers; ++c) total += sums[c];
+    CPPUNIT_ASSERT_EQUAL((long) nb_producers * nb_per_producer
+        * (nb_per_producer + 1) / 2, total);
+    CPPUNIT_ASSERT_EQUAL(0, cp_count_items(cp));
+}
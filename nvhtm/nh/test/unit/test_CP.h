@@ -0,0 +1,25 @@
+#ifndef TEST_CP_H
+#define TEST_CP_H
+
+#include <cppunit/extensions/HelperMacros.h>
+
+class test_CP : public CPPUNIT_NS::TestFixture {
+    CPPUNIT_TEST_SUITE(test_CP);
+    CPPUNIT_TEST(testFullEmpty);
+    CPPUNIT_TEST(testBatch);
+    CPPUNIT_TEST(testConcurrent);
+    CPPUNIT_TEST_SUITE_END();
+
+public:
+    test_CP();
+    virtual ~test_CP();
+    void setUp();
+    void tearDown();
+
+private:
+    void testFullEmpty();
+    void testBatch();
+    void testConcurrent();
+};
+
+#endif /* TEST_CP_H */
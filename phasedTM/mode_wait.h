@@ -0,0 +1,150 @@
+#ifndef _MODE_WAIT_H
+#define _MODE_WAIT_H
+
+/* Waits for the mode transitions: the end of GLOCK and the checkpointing flag
+ * (hw_sw_wait_chk_flag) of the HW <-> SW transitions.
+ *
+ * With MODE_FUTEX_WAIT a waiter spins MODE_WAIT_SPINS times, then sleeps in a
+ * futex. Futex words are 32 bits and modeIndicator is 64, so each key has a
+ * sequence that changeMode/unlockMode bump after the transition, then wake
+ * the sleepers (if any). The waiter reads the sequence before it checks its
+ * condition: a transition in between makes FUTEX_WAIT return at once.
+ * Without it the waits yield, as before.
+ *
+ * WAIT_PROFILING reports a histogram (log2 of ns) of the waits of each key.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#ifdef MODE_FUTEX_WAIT
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#ifdef WAIT_PROFILING
+#include <time.h>
+#endif
+
+#ifndef MODE_WAIT_SPINS
+#define MODE_WAIT_SPINS 2000 // before sleeping
+#endif
+
+#define WAIT_HIST_BUCKETS 32
+
+enum { WAIT_GLOCK = 0, WAIT_TO_SW = 1, WAIT_TO_HW = 2, WAIT_KINDS = 3 };
+
+typedef struct _mode_wait_t {
+	volatile uint32_t seq;
+	volatile uint32_t nb_sleepers;
+} mode_wait_t;
+
+// modeIndicator leaves GLOCK
+static mode_wait_t glockWait __ALIGN__ __attribute__((unused)) = { 0, 0 };
+// hw_sw_wait_chk_flag
+static mode_wait_t chkFlagWait __ALIGN__ __attribute__((unused)) = { 0, 0 };
+
+#ifdef WAIT_PROFILING
+static const char *waitNames[WAIT_KINDS] = { "glock", "hw_sw_chk", "sw_hw_chk" };
+static volatile uint64_t waitHist[WAIT_KINDS][WAIT_HIST_BUCKETS] __ALIGN__;
+static volatile uint64_t waitTotal[WAIT_KINDS] __ALIGN__;
+
+static inline
+uint64_t
+waitTime(){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec*1000000000UL + (uint64_t)t.tv_nsec;
+}
+
+static inline
+void
+waitProfilingCollect(int kind, uint64_t ns){
+	int b = ns ? 64 - __builtin_clzl(ns) : 0;
+	if (b >= WAIT_HIST_BUCKETS) b = WAIT_HIST_BUCKETS - 1;
+	atomic_fetch_add(&waitHist[kind][b], 1);
+	atomic_fetch_add(&waitTotal[kind], ns);
+}
+
+static inline
+void
+waitProfilingReport(){
+	int k, b;
+	for (k = 0; k < WAIT_KINDS; k++) {
+		uint64_t n = 0;
+		for (b = 0; b < WAIT_HIST_BUCKETS; b++) n += waitHist[k][b];
+		printf("wait %s: %lu waits, %lu ns/wait\n", waitNames[k], n,
+		       n ? waitTotal[k] / n : 0);
+		if (n == 0) continue;
+		for (b = 0; b < WAIT_HIST_BUCKETS; b++) {
+			if (waitHist[k][b] == 0) continue;
+			printf("  < 2^%-2d ns: %lu\n", b, waitHist[k][b]);
+		}
+	}
+}
+#else
+#define waitTime() 0
+#define waitProfilingCollect(k,ns);  /* nothing */
+#define waitProfilingReport();       /* nothing */
+#endif /* WAIT_PROFILING */
+
+#ifdef MODE_FUTEX_WAIT
+static inline
+void
+cpuRelax(){
+#if defined(__x86_64__)
+	__builtin_ia32_pause();
+#else
+	__asm__ volatile ("" ::: "memory");
+#endif
+}
+
+static inline
+void
+modeFutexSleep(mode_wait_t *w, uint32_t seq){
+	atomic_fetch_add(&w->nb_sleepers, 1);
+	syscall(SYS_futex, &w->seq, FUTEX_WAIT_PRIVATE, seq, NULL, NULL, 0);
+	atomic_fetch_add(&w->nb_sleepers, -1);
+}
+
+// after the transition is visible
+static inline
+void
+modeWake(mode_wait_t *w){
+	atomic_fetch_add(&w->seq, 1);
+	if (atomic_load(&w->nb_sleepers) != 0) {
+		syscall(SYS_futex, &w->seq, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL, NULL, 0);
+	}
+}
+
+#define modeWaitLoop(w, cond) do { \
+	uint32_t __spins = 0; \
+	while (1) { \
+		uint32_t __seq = atomic_load(&(w)->seq); \
+		if (!(cond)) break; \
+		if (__spins < MODE_WAIT_SPINS) { \
+			__spins++; \
+			cpuRelax(); \
+		} else { \
+			modeFutexSleep(w, __seq); \
+		} \
+	} \
+} while (0)
+#else
+#define modeWake(w);  /* nothing */
+#define modeWaitLoop(w, cond) while (cond) pthread_yield()
+#endif /* MODE_FUTEX_WAIT */
+
+// waits while cond holds, cond is rechecked after each transition of w
+#define modeWaitWhile(kind, w, cond) do { \
+	if (cond) { \
+		uint64_t __wt0 __attribute__((unused)) = waitTime(); \
+		modeWaitLoop(w, cond); \
+		waitProfilingCollect(kind, waitTime() - __wt0); \
+	} \
+} while (0)
+
+#endif /* _MODE_WAIT_H */
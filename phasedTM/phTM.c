@@ -11,6 +11,15 @@
 
 #define HTM_MAX_RETRIES 9
 
+// after an abort (htm_retries already counts it), the HTM gives up. Once
+// per abort: the adaptive policy learns from each call
+#ifdef ADAPTIVE_RETRIES
+#define RETRIES_SPENT() \
+	(!HTM_RP_abort(htm_retry_cause(abort_reason), htm_retry_persistent(abort_reason)))
+#else
+#define RETRIES_SPENT() (htm_retries >= HTM_MAX_RETRIES)
+#endif /* ADAPTIVE_RETRIES */
+
 #define MIN_STAG_RETRIES_AFTER_SW 10
 #define SAMPLING_RATE             1000
 #define WRITESET_THRESHOLD        0.15
@@ -94,8 +103,10 @@ static uint64_t sw_last_time_cycles __ALIGN__ = 0;
 
 static uint32_t total_threads __ALIGN__ = 0;
 
-#define WAIT_CHECKPOINTING while (atomic_load(&hw_sw_wait_chk_flag) != 0) pthread_yield();
-#define WAIT_TO_REENTER_HW while (atomic_load(&hw_sw_wait_chk_flag) == 0) pthread_yield();
+#define WAIT_CHECKPOINTING \
+	modeWaitWhile(WAIT_TO_SW, &chkFlagWait, atomic_load(&hw_sw_wait_chk_flag) != 0);
+#define WAIT_TO_REENTER_HW \
+	modeWaitWhile(WAIT_TO_HW, &chkFlagWait, atomic_load(&hw_sw_wait_chk_flag) == 0);
 #endif /* USE_NVM_HEURISTIC */
 __thread uint32_t abort_rate __ALIGN__ = 0;
 __thread uint64_t num_htm_runs __ALIGN__ = 0;
@@ -107,6 +118,52 @@ __thread uint64_t t0 __ALIGN__ = 0;
 __thread uint64_t sum_cycles __ALIGN__ = 0;
 #define TX_CYCLES_THRESHOLD (30000) // HTM-friendly apps in STAMP have tx with 20k cycles or less
 
+#ifdef PER_BLOCK_MODE
+/* Each atomic block (static id given by the glue) has its own statistics and
+ * route. When a block does not fit in HTM only that block goes to SW, the
+ * others keep running in HW. Both run at the same time as in Hybrid NOrec:
+ * HW transactions subscribe to the seqlock of the STM and bump it on commit
+ * while a block runs in SW, so the SW transactions revalidate.
+ */
+#if DESIGN != OPTIMIZED
+#error "PER_BLOCK_MODE requires DESIGN=OPTIMIZED"
+#endif
+#define PHTM_MAX_BLOCKS   64
+#define BLOCK_SW_RUNS     100  // SW commits of a block before it is reevaluated
+#define MAX_BLOCK_SW_RUNS 1000
+
+typedef struct _block_stats_t {
+	uint64_t hw_commits;
+	uint64_t hw_aborts;
+	uint64_t hw_capacity;
+	uint64_t hw_conflict;
+	uint64_t hw_cycles;
+	uint64_t sw_commits;
+	uint64_t sw_cycles;
+	uint64_t sw_writes;
+	uint64_t to_sw;
+	// current SW sample
+	uint64_t sw_runs;
+	uint64_t max_sw_runs;
+	uint64_t sample_cycles;
+	uint64_t sample_writes;
+	float last_write_rate;
+	uint64_t hw_mean_cycles; // when it was routed to SW
+} block_stats_t;
+
+static volatile uint8_t blockRoute[PHTM_MAX_BLOCKS] __ALIGN__;
+static volatile uintptr_t *seqlock __ALIGN__ = NULL;
+static volatile uint64_t swBlockCount __ALIGN__ = 0;
+static block_stats_t blockTotals[PHTM_MAX_BLOCKS] __ALIGN__;
+static pthread_mutex_t blockTotalsLock = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread block_stats_t blockStats[PHTM_MAX_BLOCKS] __ALIGN__;
+static __thread long curBlock __ALIGN__ = 0;
+static __thread bool blockTx __ALIGN__ = false;
+static __thread uint64_t blockT0 __ALIGN__ = 0;
+static __thread uint64_t blockWrites __ALIGN__ = 0;
+#endif /* PER_BLOCK_MODE */
+
 #if defined(__powerpc__) || defined(__ppc__) || defined(__PPC__)
 static inline uint64_t getCycles()
 {
@@ -137,6 +194,7 @@ static inline uint64_t getCycles()
 
 #include <utils.h>
 #include <phase_profiling.h>
+#include <mode_wait.h>
 
 #ifdef USE_ABORT_LOG_CHECK
 #ifndef EXPLICIT_NVM_CONFLIC
@@ -148,6 +206,130 @@ static inline uint64_t getCycles()
 #include "../nvhtm/nh/common/utils.h"  // phasedTM already includes its own version of 'utils.h'
 #endif
 
+#ifdef PER_BLOCK_MODE
+/* On NV-HTM a HW transaction holds a commit-order slot (log_order.h) from
+ * before htm_begin, and a SW block commit (NVMHTM_sw_commit) waits for the
+ * slots below its ts. A thread that waits for a SW block (the seqlock, or
+ * GLOCK and swBlockCount) leaves its slot idle and takes it again before
+ * htm_begin, else both wait for each other. Weak: libnh may not be linked.
+ */
+extern void LOG_get_ts_before_tx(int tid) __attribute__((weak));
+extern void LOG_idle_tx(int tid) __attribute__((weak));
+#define BLOCK_IDLE() ({ if (LOG_idle_tx) LOG_idle_tx(__tx_tid); })
+#define BLOCK_RESTAMP() ({ \
+	if (LOG_get_ts_before_tx) LOG_get_ts_before_tx(__tx_tid); \
+})
+
+static inline
+bool
+seqlockIsBusy(){
+	return seqlock != NULL && (*seqlock & 1);
+}
+
+// a SW block is writing back, HW transactions would abort
+static inline
+void
+waitSeqlock(){
+	if (!seqlockIsBusy()) return;
+	BLOCK_IDLE();
+	while (seqlockIsBusy()) {
+		pthread_yield();
+	}
+}
+
+// HW -> SW of the running block only, false if HW and SW cannot run together
+static inline
+bool
+routeBlockToSW(uint64_t mean_cycles){
+	block_stats_t *b = &blockStats[curBlock];
+
+	if (seqlock == NULL) return false;
+
+	b->hw_mean_cycles = b->hw_commits ? b->hw_cycles / b->hw_commits : mean_cycles;
+	b->sw_runs = 0;
+	b->sample_cycles = 0;
+	b->sample_writes = 0;
+	b->last_write_rate = 0;
+	if (b->max_sw_runs == 0) b->max_sw_runs = BLOCK_SW_RUNS;
+	b->to_sw++;
+	blockRoute[curBlock] = SW;
+	return true;
+}
+
+static inline
+void
+enterBlockTx(){
+	while (true) {
+		atomicInc(&swBlockCount);
+		if (!isModeGLOCK()) break;
+		// the lock holder runs without HTM, wait until it is done
+		atomicDec(&swBlockCount);
+		modeWaitWhile(WAIT_GLOCK, &glockWait, isModeGLOCK());
+	}
+	blockT0 = getCycles();
+}
+
+// SW -> HW if HW was faster or the write set shrank (as in STM_PostCommit_Tx)
+static inline
+void
+leaveBlockTx(){
+	block_stats_t *b = &blockStats[curBlock];
+	uint64_t cycles = getCycles() - blockT0;
+
+	atomicDec(&swBlockCount);
+	blockTx = false;
+
+	b->sw_commits++;
+	b->sw_cycles += cycles;
+	b->sw_writes += blockWrites;
+	b->sample_cycles += cycles;
+	b->sample_writes += blockWrites;
+	if (++b->sw_runs < b->max_sw_runs) return;
+
+	uint64_t mean_cycles = b->sample_cycles / b->sw_runs;
+	float write_rate = (float)b->sample_writes / (float)b->sw_runs;
+	uint64_t hw_mean = b->hw_mean_cycles;
+	if (hw_mean == 0 && b->hw_commits != 0) hw_mean = b->hw_cycles / b->hw_commits;
+
+	bool back = (hw_mean != 0 && hw_mean <= mean_cycles)
+	            || mean_cycles < TX_CYCLES_THRESHOLD;
+	// a smaller write set may fit in HTM again
+	if (b->last_write_rate > 0
+	    && (b->last_write_rate - write_rate)/b->last_write_rate >= WRITESET_THRESHOLD)
+		back = true;
+	if (write_rate > b->last_write_rate) b->last_write_rate = write_rate;
+
+	b->sw_runs = 0;
+	b->sample_cycles = 0;
+	b->sample_writes = 0;
+	if (back) {
+		b->last_write_rate = 0;
+		b->max_sw_runs = BLOCK_SW_RUNS;
+		blockRoute[curBlock] = HW;
+	} else if (b->max_sw_runs < MAX_BLOCK_SW_RUNS) {
+		b->max_sw_runs = 2*b->max_sw_runs;
+	}
+}
+
+static inline
+void
+blockStatsReport(){
+	long i;
+	printf("block: hw_commits hw_aborts capacity conflict hw_cycles/tx"
+	       " sw_commits sw_cycles/tx sw_writes/tx to_sw\n");
+	for (i = 0; i < PHTM_MAX_BLOCKS; i++) {
+		block_stats_t *b = &blockTotals[i];
+		if (b->hw_commits + b->hw_aborts + b->sw_commits == 0) continue;
+		printf("%5ld: %lu %lu %lu %lu %lu %lu %lu %.1f %lu\n", i,
+		       b->hw_commits, b->hw_aborts, b->hw_capacity, b->hw_conflict,
+		       b->hw_commits ? b->hw_cycles / b->hw_commits : 0, b->sw_commits,
+		       b->sw_commits ? b->sw_cycles / b->sw_commits : 0,
+		       b->sw_commits ? (double)b->sw_writes / b->sw_commits : 0.0,
+		       b->to_sw);
+	}
+}
+#endif /* PER_BLOCK_MODE */
+
 int
 changeMode(uint64_t newMode, transition_cause cause) {
 	
@@ -170,7 +352,8 @@ changeMode(uint64_t newMode, transition_cause cause) {
 				indicator = atomicReadModeIndicator();
 				expected = setMode(indicator, HW);
 				new = setMode(indicator, SW);
-				success = boolCAS(&(modeIndicator.value), &(expected.value), new.value);
+				// an emulated HW transaction still running commits first
+				success = htm_exclusive(boolCAS(&(modeIndicator.value), &(expected.value), new.value));
 			} while (!success && (indicator.mode != SW));
 			if(success){
 
@@ -186,19 +369,25 @@ changeMode(uint64_t newMode, transition_cause cause) {
 #include <semaphore.h>
         extern volatile int *NH_checkpointer_state;
         extern sem_t *NH_chkp_sem;
+        extern volatile int NH_sw_in_log;
         
-        // force checkpointing state (note: we are the only one writing 2 to
-        // it)
-        atomic_store(NH_checkpointer_state, 2);
-
-        // wake up the checkphandler
-        sem_post(NH_chkp_sem);
-        
-        // wait for it to finish
-        while (atomic_load(NH_checkpointer_state) != 0) _mm_pause();
+        // the SW commits go to the same logs (ordered after the HW commits
+        // still in flight), the checkpointer keeps draining them
+        if (!atomic_load(&NH_sw_in_log)) {
+          // force checkpointing state (note: we are the only one writing 2 to
+          // it)
+          atomic_store(NH_checkpointer_state, 2);
+
+          // wake up the checkphandler
+          sem_post(NH_chkp_sem);
+          
+          // wait for it to finish
+          while (atomic_load(NH_checkpointer_state) != 0) _mm_pause();
+        }
 
         // logs are drained, start SW mode
         atomic_store(&hw_sw_wait_chk_flag, 0);
+        modeWake(&chkFlagWait);
 #endif
 				updateTransitionProfilingData(SW, cause);
 #if DESIGN == OPTIMIZED
@@ -230,6 +419,7 @@ changeMode(uint64_t newMode, transition_cause cause) {
 				updateTransitionProfilingData(HW, cause);
 #ifdef USE_NVM_HEURISTIC
         atomic_store(&hw_sw_wait_chk_flag, 1); // reentering HW from SW
+        modeWake(&chkFlagWait);
 
         /* TODO
          * Is it possible for this transaction to start in HW mode and change
@@ -256,7 +446,7 @@ changeMode(uint64_t newMode, transition_cause cause) {
 				if ( indicator.mode == GLOCK) return -1;
 				expected = setMode(NULL_INDICATOR, HW);
 				new = setMode(NULL_INDICATOR, GLOCK);
-				success = boolCAS(&(modeIndicator.value), &(expected.value), new.value);
+				success = htm_exclusive(boolCAS(&(modeIndicator.value), &(expected.value), new.value));
 			} while (!success);
 			updateTransitionProfilingData(GLOCK, cause);
 			break;
@@ -276,8 +466,9 @@ unlockMode(){
 	do {
 		modeIndicator_t expected = setMode(NULL_INDICATOR, GLOCK);
 		modeIndicator_t new = setMode(NULL_INDICATOR, HW);
-		success = boolCAS(&(modeIndicator.value), &(expected.value), new.value);
+		success = htm_exclusive(boolCAS(&(modeIndicator.value), &(expected.value), new.value));
 	} while (!success);
+	modeWake(&glockWait);
 	updateTransitionProfilingData(HW, 0);
 }
 #endif /* DESIGN == OPTIMIZED */
@@ -289,10 +480,16 @@ HTM_Start_Tx() {
 	
 	htm_retries = 0;
 	abort_reason = 0;
+#ifdef ADAPTIVE_RETRIES
+	HTM_RP_begin(__builtin_return_address(0)); // the atomic block
+#endif /* ADAPTIVE_RETRIES */
 #if DESIGN == OPTIMIZED
 	isCapacityAbortPersistent = 0;
 	t0 = getCycles();
 #endif /* DESIGN == OPTIMIZED */
+#ifdef PER_BLOCK_MODE
+	blockT0 = t0;
+#endif
     
 #ifdef USE_NVM_HEURISTIC
   if (switched_to_sw == 1) {
@@ -305,9 +502,18 @@ HTM_Start_Tx() {
 #endif
 
 	while (true) {
+#ifdef PER_BLOCK_MODE
+		waitSeqlock();
+		BLOCK_RESTAMP();
+#endif
 		uint32_t status = htm_begin();
 		if (htm_has_started(status)) {
+#ifdef PER_BLOCK_MODE
+			// subscribe to the seqlock: a SW block commit aborts this tx
+			if (modeIndicator.value == 0 && !seqlockIsBusy()) {
+#else
 			if (modeIndicator.value == 0) {
+#endif
 				return false;
 			} else {
 				htm_abort();
@@ -329,7 +535,7 @@ HTM_Start_Tx() {
       uint64_t startser = getCycles();
 #endif
 #endif
-			while( isModeGLOCK() ) pthread_yield();
+			modeWaitWhile(WAIT_GLOCK, &glockWait, isModeGLOCK());
 #if defined(USE_NVM_HEURISTIC) || defined(STAGNATION_PROFILING)
 	    /*
        * If we simply reset the time here we will not take into account the
@@ -354,6 +560,13 @@ HTM_Start_Tx() {
 #endif /* DESIGN == OPTIMIZED */
 		abort_reason = htm_abort_reason(status);
 		__inc_abort_counter(__tx_tid, abort_reason);
+#ifdef PER_BLOCK_MODE
+		blockStats[curBlock].hw_aborts++;
+		if (abort_reason & ABORT_CAPACITY) blockStats[curBlock].hw_capacity++;
+		if (abort_reason & ABORT_TX_CONFLICT) blockStats[curBlock].hw_conflict++;
+		// not running, until the restamp before the next htm_begin
+		BLOCK_IDLE();
+#endif
 		
 #ifndef DISABLE_PHASE_TRANSITIONS
 		modeIndicator_t indicator = atomicReadModeIndicator();
@@ -364,12 +577,13 @@ HTM_Start_Tx() {
 
 #if DESIGN == PROTOTYPE
 		htm_retries++;
-		if ( htm_retries >= HTM_MAX_RETRIES ) {
+		if ( RETRIES_SPENT() ) {
 			changeMode(SW, TCAPACITY);
 			return true;
 		}
 #else  /* DESIGN == OPTIMIZED */
 		htm_retries++;
+		bool retriesSpent = RETRIES_SPENT(); // the checks below only read it
 #ifndef DISABLE_PHASE_TRANSITIONS
 		isCapacityAbortPersistent = (abort_reason & ABORT_CAPACITY)
 		                 && (previous_abort_reason == abort_reason);
@@ -438,6 +652,14 @@ HTM_Start_Tx() {
 				 (isCapacityAbortPersistent
 					&& (abort_rate >= ABORT_RATE_THRESHOLD)) ) {
 
+#ifdef PER_BLOCK_MODE
+			// only this block goes to SW, the others keep running in HW
+			if (routeBlockToSW(mean_cycles)) {
+				previous_abort_reason = 0;
+				return true;
+			}
+#endif
+
 #ifdef USE_NVM_HEURISTIC      
 #ifdef USE_SERIAL_OPTIMIZATION
       float serial_percentage;
@@ -530,10 +752,10 @@ HTM_Start_Tx() {
       changeMode(SW, TEXPLICIT);
       return true;
 #endif
-    } else if (htm_retries >= HTM_MAX_RETRIES) {
+    } else if (retriesSpent) {
 #endif // !DISABLE_PHASE_TRANSITIONS
 #ifdef DISABLE_PHASE_TRANSITIONS
-    if (htm_retries >= HTM_MAX_RETRIES) {
+    if (retriesSpent) {
 #endif
 			int status = changeMode(GLOCK, TCAPACITY);
 			if(status == 0){
@@ -546,6 +768,11 @@ HTM_Start_Tx() {
 					// I own the lock, so return and
 					// execute in mutual exclusion
 					htm_global_lock_is_mine = true;
+#ifdef PER_BLOCK_MODE
+					// SW blocks do not see the writes of the lock holder
+					while (atomicRead(&swBlockCount) != 0) pthread_yield();
+					BLOCK_RESTAMP();
+#endif
 					t0 = getCycles();
 					return false;
 				} else {
@@ -556,7 +783,7 @@ HTM_Start_Tx() {
           uint64_t startser = getCycles();
 #endif
 #endif
-					while( isModeGLOCK() ) pthread_yield();
+					modeWaitWhile(WAIT_GLOCK, &glockWait, isModeGLOCK());
 #if defined(USE_NVM_HEURISTIC) || defined(STAGNATION_PROFILING)
         /*
          * If we simply reset the time here we will not take into account the
@@ -586,6 +813,9 @@ HTM_Commit_Tx() {
 
 #if	DESIGN == PROTOTYPE
 	htm_end();
+#ifdef ADAPTIVE_RETRIES
+	HTM_RP_commit();
+#endif /* ADAPTIVE_RETRIES */
 	__inc_commit_counter(__tx_tid);
 #else  /* DESIGN == OPTIMIZED */
 	if (htm_global_lock_is_mine){
@@ -642,7 +872,14 @@ HTM_Commit_Tx() {
 #endif
 
 	} else {
+#ifdef PER_BLOCK_MODE
+		// read in the tx: a SW block starting now aborts it
+		if (swBlockCount != 0) *seqlock += 2;
+#endif
 		htm_end();
+#ifdef ADAPTIVE_RETRIES
+		HTM_RP_commit();
+#endif /* ADAPTIVE_RETRIES */
 #if defined(USE_NVM_HEURISTIC) || defined(STAGNATION_PROFILING)
     hw_committed_cycles += (getCycles() - t0);
     hw_committed_txs++;
@@ -726,6 +963,10 @@ HTM_Commit_Tx() {
   abort_rate = (abort_rate * 75) / 100;
 #endif /* DESIGN == OPTIMIZED */
 
+#ifdef PER_BLOCK_MODE
+	blockStats[curBlock].hw_commits++;
+	blockStats[curBlock].hw_cycles += getCycles() - blockT0;
+#endif
 }
 
 
@@ -737,6 +978,14 @@ STM_PreStart_Tx(bool restarted) {
 	modeIndicator_t new = { .value = 0 };
 	bool success;
 
+#ifdef PER_BLOCK_MODE
+	if (blockTx) {
+		// a SW block in HW mode, not deferred/undeferred
+		if (!restarted) enterBlockTx();
+		return false;
+	}
+#endif
+
 	if (!deferredTx) {
 		do {
 			indicator = atomicReadModeIndicator();
@@ -820,9 +1069,23 @@ STM_PreStart_Tx(bool restarted) {
 }
 
 
+void
+STM_PreCommit_Tx(uint64_t nb_writes) {
+#ifdef PER_BLOCK_MODE
+	blockWrites = nb_writes;
+#endif
+}
+
+
 void
 STM_PostCommit_Tx() {
 	
+#ifdef PER_BLOCK_MODE
+	if (blockTx) {
+		leaveBlockTx();
+		return;
+	}
+#endif
 
 #if DESIGN == OPTIMIZED
 	if (deferredTx) {
@@ -1024,6 +1287,32 @@ going_back_to_hw:
   }
 }
 
+uint64_t
+getBlockMode(long block){
+	uint64_t mode = getMode();
+#ifdef PER_BLOCK_MODE
+	curBlock = block % PHTM_MAX_BLOCKS;
+	blockTx = mode == HW && blockRoute[curBlock] == SW;
+	if (blockTx) return SW;
+#endif
+	return mode;
+}
+
+uint64_t
+getTxMode(){
+#ifdef PER_BLOCK_MODE
+	if (blockTx) return SW;
+#endif
+	return getMode();
+}
+
+void
+phTM_set_seqlock(volatile uintptr_t *lock){
+#ifdef PER_BLOCK_MODE
+	seqlock = lock;
+#endif
+}
+
 void
 phTM_init(long nThreads){
 	printf("DESIGN: %s\n", (DESIGN == PROTOTYPE) ? "PROTOTYPE" : "OPTIMIZED");
@@ -1073,6 +1362,22 @@ phTM_thread_init(long tid){
 void
 phTM_thread_exit(void){
 	phase_profiling_stop();
+#ifdef PER_BLOCK_MODE
+	long i;
+	pthread_mutex_lock(&blockTotalsLock);
+	for (i = 0; i < PHTM_MAX_BLOCKS; i++) {
+		blockTotals[i].hw_commits  += blockStats[i].hw_commits;
+		blockTotals[i].hw_aborts   += blockStats[i].hw_aborts;
+		blockTotals[i].hw_capacity += blockStats[i].hw_capacity;
+		blockTotals[i].hw_conflict += blockStats[i].hw_conflict;
+		blockTotals[i].hw_cycles   += blockStats[i].hw_cycles;
+		blockTotals[i].sw_commits  += blockStats[i].sw_commits;
+		blockTotals[i].sw_cycles   += blockStats[i].sw_cycles;
+		blockTotals[i].sw_writes   += blockStats[i].sw_writes;
+		blockTotals[i].to_sw       += blockStats[i].to_sw;
+	}
+	pthread_mutex_unlock(&blockTotalsLock);
+#endif
 #if DESIGN == OPTIMIZED
 	if (deferredTx) {
 #ifdef PRINTF_DEBUG        
@@ -1100,6 +1405,10 @@ phTM_term(long nThreads, long nTxs, uint64_t **stmCommits, uint64_t **stmAborts)
 #endif
 	phase_profiling_report();
 	stag_profiling_report();
+	waitProfilingReport();
+#ifdef PER_BLOCK_MODE
+	blockStatsReport();
+#endif
 }
 
 
@@ -15,6 +15,15 @@ enum { HW = 0, SW = 1, GLOCK = 2 };
 uint64_t
 getMode();
 
+/* mode to run the atomic block (static id) in, a block can run in SW while
+ * the others run in HW (PER_BLOCK_MODE) */
+uint64_t
+getBlockMode(long block);
+
+/* mode of the transaction being executed */
+uint64_t
+getTxMode();
+
 bool
 HTM_Start_Tx();
 
@@ -24,9 +33,17 @@ HTM_Commit_Tx();
 bool
 STM_PreStart_Tx(bool restarted);
 
+void
+STM_PreCommit_Tx(uint64_t nb_writes);
+
 void
 STM_PostCommit_Tx();
 
+/* the commit seqlock of the STM, HW transactions subscribe to it while a
+ * block runs in SW */
+void
+phTM_set_seqlock(volatile uintptr_t *lock);
+
 void
 phTM_init(long nThreads);
 
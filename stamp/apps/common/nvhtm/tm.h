@@ -293,11 +293,21 @@ extern void increaseThroughputSamplesSize(double **ptr, uint64_t *oldLength, uin
 #define TM_MALLOC(size)               NH_alloc(size)
 #define TM_FREE(ptr)                  NH_free(ptr)
 
+#ifndef SOFTWARE_TRANSLATION
 #define NVM_HW_READ_BARRIER(var) \
 	({ \
+	  htm_read(&(var)); \
 	  NH_before_read((&var)); \
 	  var; \
 	})
+#else /* SOFTWARE_TRANSLATION */
+#define NVM_HW_READ_BARRIER(var) \
+	({ \
+	  htm_read(NH_translate(&var)); \
+	  NH_before_read((&var)); \
+	  *NH_translate(&var); \
+	})
+#endif /* SOFTWARE_TRANSLATION */
 
 #define TM_SHARED_READ(var)        \
 	NVM_HW_READ_BARRIER(var)
@@ -306,13 +316,27 @@ extern void increaseThroughputSamplesSize(double **ptr, uint64_t *oldLength, uin
 #define TM_SHARED_READ_F(var)      \
 	NVM_HW_READ_BARRIER(var)
 
+#ifndef SOFTWARE_TRANSLATION
 #define NVM_HW_WRITE_BARRIER(var, val) \
 	({ \
+	  htm_write(&(var)); \
 	  NH_before_write((&var), val); \
 	  var = val; \
 	  NH_after_write((&var), val); \
 	  var; \
 	})
+#else /* SOFTWARE_TRANSLATION */
+#define NVM_HW_WRITE_BARRIER(var, val) \
+	({ \
+	  __typeof__(&var) __shadow = \
+	    (__typeof__(&var)) NH_ST_write_addr((void*) (&var)); \
+	  htm_write(__shadow); \
+	  NH_before_write((&var), val); \
+	  *__shadow = val; \
+	  NH_after_write((&var), val); \
+	  *__shadow; \
+	})
+#endif /* SOFTWARE_TRANSLATION */
 
 #define TM_SHARED_WRITE(var, val)   \
 	NVM_HW_WRITE_BARRIER(var,val)
@@ -299,6 +299,7 @@ extern void increaseThroughputSamplesSize(double **ptr, uint64_t *oldLength, uin
 
 #define NVM_HW_READ_BARRIER(var) \
 	({ \
+	  htm_read(&(var)); \
 	  NH_before_read((&var)); \
 	  var; \
 	})
@@ -312,6 +313,7 @@ extern void increaseThroughputSamplesSize(double **ptr, uint64_t *oldLength, uin
 
 #define NVM_HW_WRITE_BARRIER(var, val) \
 	({ \
+	  htm_write(&(var)); \
 	  NH_before_write((&var), val); \
 	  var = val; \
 	  NH_after_write((&var), val); \
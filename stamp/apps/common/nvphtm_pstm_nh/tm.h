@@ -182,26 +182,21 @@ typedef union { stm_word_t w; float f;} floatconv_t;
 
 #include <nh.h>
 #include <min_nvm.h>
+#include <stm/PersistentLog.hpp>
 
 /**
- *  Persistency delay emulation macros 
+ *  NOrec (PERSISTENT_TM) writes the write set and the commit marker to its
+ *  persistent redo log when it commits, there is nothing to do per write.
+ *  The log is the one of NV-HTM: the HW and SW commits share the logs and
+ *  the checkpointer.
  */
-#define PSTM_COMMIT_MARKER \
-	MN_count_writes++;       \
-  MN_count_writes++;       \
-  SPIN_PER_WRITE(1);       \
-  SPIN_PER_WRITE(1);
-
-// TODO: is crashing in TPC-C
-#define PSTM_LOG_ENTRY(addr, val) \
-	{ \
-		/*int log_buf = (int)val;*/ \
-		MN_count_writes += 2; \
-		/*memcpy(PSTM_log + PSTM_log_ptr, &log_buf, sizeof(int));*/ \
-		SPIN_PER_WRITE(1); \
-		/*PSTM_log_ptr += sizeof(int); \
-		if (PSTM_log_ptr >= PSTM_LOG_SIZE - sizeof(int)) PSTM_log_ptr = 0;*/\
-	}
+#define PSTM_COMMIT_MARKER            /* nothing */
+#define PSTM_LOG_ENTRY(addr, val)     /* nothing */
+#define PSTM_LOG_INIT() ({ \
+	stm::plog_set_external(NVMHTM_sw_begin, NVMHTM_sw_write, NVMHTM_sw_commit, \
+		NVMHTM_sw_abort); \
+	NH_sw_in_log = 1; \
+})
 
 //extern int *NH_checkpointer_state;
 extern sem_t *NH_chkp_sem;
@@ -299,7 +294,9 @@ extern void increaseThroughputSamplesSize(double **ptr, uint64_t *oldLength, uin
 
 #define TM_STARTUP(numThread)					msrInitialize();       \
 																			stm::sys_init(NULL);   \
+																			phTM_set_seqlock(stm::get_seqlock()); \
 																			NVHTM_init(numThread); \
+																			PSTM_LOG_INIT();       \
 																			NVHTM_start_stats();   \
 																			MN_learn_nb_nops();    \
 																			phTM_init(numThread);  \
@@ -384,7 +381,7 @@ extern void increaseThroughputSamplesSize(double **ptr, uint64_t *oldLength, uin
 
 #define IF_HTM_MODE							GET_TX_ID(); \
                                 while(1){ \
-																	uint64_t mode = getMode(); \
+																	uint64_t mode = getBlockMode(__COUNTER__); \
 																	if (mode == HW || mode == GLOCK){
 #define START_HTM_MODE 							bool modeChanged = HTM_Start_Tx(); \
 																		if (!modeChanged) {
@@ -398,7 +395,8 @@ extern void increaseThroughputSamplesSize(double **ptr, uint64_t *oldLength, uin
 																		bool modeChanged = STM_PreStart_Tx(restarted); \
 																		if (!modeChanged){ \
 																			STM_START(abort_flags);
-#define COMMIT_STM_MODE								STM_COMMIT; \
+#define COMMIT_STM_MODE								STM_PreCommit_Tx(tx->writes.size()); \
+																			STM_COMMIT; \
 																			STM_PostCommit_Tx(); \
 																			break; \
 																		} \
@@ -425,7 +423,9 @@ extern void increaseThroughputSamplesSize(double **ptr, uint64_t *oldLength, uin
 
 #define TM_STARTUP(numThread)					msrInitialize();       \
 																			stm::sys_init(NULL);   \
+																			phTM_set_seqlock(stm::get_seqlock()); \
 																			NVHTM_init(numThread); \
+																			PSTM_LOG_INIT();       \
 																			NVHTM_start_stats();   \
 																			MN_learn_nb_nops();    \
 																			ALLOCA_COMMITS_ABORTS_VARIABLES(numThread); \
@@ -457,10 +457,12 @@ extern void increaseThroughputSamplesSize(double **ptr, uint64_t *oldLength, uin
 
 #define IF_HTM_MODE							GET_TX_ID(); \
                                 while(1){ \
-																	uint64_t mode = getMode(); \
+																	uint64_t mode = getBlockMode(__COUNTER__); \
 																	if (mode == HW || mode == GLOCK){
 #define START_HTM_MODE 							BEFORE_TRANSACTION(__tid__, 0 /* unused */); \
                                     bool modeChanged = HTM_Start_Tx(); \
+                                    /* not in HW: no longer in flight */ \
+                                    if (modeChanged) { TM_inc_local_counter(__tid__); LOG_ORDER_idle(__tid__); } \
 																		if (!modeChanged) {
 #define COMMIT_HTM_MODE								BEFORE_COMMIT(__tid__, 0 /* unused */, HTM_SUCCESS); \
                                       HTM_Commit_Tx(); \
@@ -475,7 +477,8 @@ extern void increaseThroughputSamplesSize(double **ptr, uint64_t *oldLength, uin
 																		bool modeChanged = STM_PreStart_Tx(restarted); \
 																		if (!modeChanged){ \
 																			STM_START(abort_flags);
-#define COMMIT_STM_MODE								STM_COMMIT; \
+#define COMMIT_STM_MODE								STM_PreCommit_Tx(tx->writes.size()); \
+																			STM_COMMIT; \
 																			STM_PostCommit_Tx(); \
 																			break; \
 																		} \
@@ -486,7 +489,7 @@ extern void increaseThroughputSamplesSize(double **ptr, uint64_t *oldLength, uin
 #define HW_TM_RESTART()         htm_abort()
 
 #define TM_RESTART()            { \
-																	uint64_t mode = getMode(); \
+																	uint64_t mode = getTxMode(); \
 																	if(mode == SW) stm::restart(); \
 																	else htm_abort(); \
 																}
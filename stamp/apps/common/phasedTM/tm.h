@@ -119,9 +119,9 @@ typedef union { stm_word_t w; float f;} floatconv_t;
 //#define TM_SHARED_READ_P(var)         stm_load((volatile stm_word_t *)(void *)&(var))
 //#define TM_SHARED_READ_F(var)         ({floatconv_t c; c.w = stm_load((volatile stm_word_t *)&(var)); c.f;})
 
-#define HW_TM_SHARED_READ(var)        (var)
-#define HW_TM_SHARED_READ_P(var)      (var)
-#define HW_TM_SHARED_READ_F(var)      (var)
+#define HW_TM_SHARED_READ(var)        ({ htm_read(&(var)); var; })
+#define HW_TM_SHARED_READ_P(var)      ({ htm_read(&(var)); var; })
+#define HW_TM_SHARED_READ_F(var)      ({ htm_read(&(var)); var; })
 
 #define TM_SHARED_WRITE(var, val)     stm_store((volatile stm_word_t *)(void *)&(var), (stm_word_t)val)
 #define TM_SHARED_WRITE_P(var, val)   stm_store_ptr((volatile void **)(void *)&(var), val)
@@ -129,9 +129,9 @@ typedef union { stm_word_t w; float f;} floatconv_t;
 //#define TM_SHARED_WRITE_P(var, val)   stm_store((volatile stm_word_t *)(void *)&(var), (stm_word_t)val)
 //#define TM_SHARED_WRITE_F(var, val)   ({floatconv_t c; c.f = val; stm_store((volatile stm_word_t *)&(var), c.w);})
 
-#define HW_TM_SHARED_WRITE(var, val)   ({var = val; var;})
-#define HW_TM_SHARED_WRITE_P(var, val) ({var = val; var;})
-#define HW_TM_SHARED_WRITE_F(var, val) ({var = val; var;})
+#define HW_TM_SHARED_WRITE(var, val)   ({ htm_write(&(var)); var = val; var; })
+#define HW_TM_SHARED_WRITE_P(var, val) ({ htm_write(&(var)); var = val; var; })
+#define HW_TM_SHARED_WRITE_F(var, val) ({ htm_write(&(var)); var = val; var; })
 
 #define HW_TM_LOCAL_WRITE(var, val)  	({var = val; var;})
 #define HW_TM_LOCAL_WRITE_P(var, val) ({var = val; var;})
@@ -271,6 +271,7 @@ extern void increaseThroughputSamplesSize(double **ptr, uint64_t *oldLength, uin
 
 #define TM_STARTUP(numThread)					msrInitialize();        \
 																			stm::sys_init(NULL); \
+																			phTM_set_seqlock(stm::get_seqlock()); \
 																			phTM_init(numThread); \
 																			{ \
 																				__throughputProfilingData = (throughputProfilingData_t*)calloc(numThread, \
@@ -347,7 +348,7 @@ extern void increaseThroughputSamplesSize(double **ptr, uint64_t *oldLength, uin
 
 #define IF_HTM_MODE							GET_TX_ID(); \
                                 while(1){ \
-																	uint64_t mode = getMode(); \
+																	uint64_t mode = getBlockMode(__COUNTER__); \
 																	if (mode == HW || mode == GLOCK){
 #define START_HTM_MODE 							bool modeChanged = HTM_Start_Tx(); \
 																		if (!modeChanged) {
@@ -361,7 +362,8 @@ extern void increaseThroughputSamplesSize(double **ptr, uint64_t *oldLength, uin
 																		bool modeChanged = STM_PreStart_Tx(restarted); \
 																		if (!modeChanged){ \
 																			STM_START(abort_flags);
-#define COMMIT_STM_MODE								STM_COMMIT; \
+#define COMMIT_STM_MODE								STM_PreCommit_Tx(tx->writes.size()); \
+																			STM_COMMIT; \
 																			STM_PostCommit_Tx(); \
 																			break; \
 																		} \
@@ -388,6 +390,7 @@ extern void increaseThroughputSamplesSize(double **ptr, uint64_t *oldLength, uin
 
 #define TM_STARTUP(numThread)					msrInitialize();        \
 																			stm::sys_init(NULL); \
+																			phTM_set_seqlock(stm::get_seqlock()); \
 																			ALLOCA_COMMITS_ABORTS_VARIABLES(numThread); \
 																			phTM_init(numThread)
 
@@ -413,7 +416,7 @@ extern void increaseThroughputSamplesSize(double **ptr, uint64_t *oldLength, uin
 
 #define IF_HTM_MODE							GET_TX_ID(); \
                                 while(1){ \
-																	uint64_t mode = getMode(); \
+																	uint64_t mode = getBlockMode(__COUNTER__); \
 																	if (mode == HW || mode == GLOCK){
 #define START_HTM_MODE 							bool modeChanged = HTM_Start_Tx(); \
 																		if (!modeChanged) {
@@ -427,7 +430,8 @@ extern void increaseThroughputSamplesSize(double **ptr, uint64_t *oldLength, uin
 																		bool modeChanged = STM_PreStart_Tx(restarted); \
 																		if (!modeChanged){ \
 																			STM_START(abort_flags);
-#define COMMIT_STM_MODE								STM_COMMIT; \
+#define COMMIT_STM_MODE								STM_PreCommit_Tx(tx->writes.size()); \
+																			STM_COMMIT; \
 																			STM_PostCommit_Tx(); \
 																			break; \
 																		} \
@@ -438,7 +442,7 @@ extern void increaseThroughputSamplesSize(double **ptr, uint64_t *oldLength, uin
 #define HW_TM_RESTART()         htm_abort()
 
 #define TM_RESTART()            { \
-																	uint64_t mode = getMode(); \
+																	uint64_t mode = getTxMode(); \
 																	if(mode == SW) stm::restart(); \
 																	else htm_abort(); \
 																}
@@ -451,17 +455,17 @@ extern void increaseThroughputSamplesSize(double **ptr, uint64_t *oldLength, uin
 #define TM_SHARED_READ_P(var)         TM_LOAD(&var)
 #define TM_SHARED_READ_F(var)         TM_LOAD(&var)
 
-#define HW_TM_SHARED_READ(var)        (var)
-#define HW_TM_SHARED_READ_P(var)      (var)
-#define HW_TM_SHARED_READ_F(var)      (var)
+#define HW_TM_SHARED_READ(var)        ({ htm_read(&(var)); var; })
+#define HW_TM_SHARED_READ_P(var)      ({ htm_read(&(var)); var; })
+#define HW_TM_SHARED_READ_F(var)      ({ htm_read(&(var)); var; })
 
 #define TM_SHARED_WRITE(var, val)     TM_STORE(&var, val)
 #define TM_SHARED_WRITE_P(var, val)   TM_STORE(&var, val)
 #define TM_SHARED_WRITE_F(var, val)   TM_STORE(&var, val)
 
-#define HW_TM_SHARED_WRITE(var, val)   ({var = val; var;})
-#define HW_TM_SHARED_WRITE_P(var, val) ({var = val; var;})
-#define HW_TM_SHARED_WRITE_F(var, val) ({var = val; var;})
+#define HW_TM_SHARED_WRITE(var, val)   ({ htm_write(&(var)); var = val; var; })
+#define HW_TM_SHARED_WRITE_P(var, val) ({ htm_write(&(var)); var = val; var; })
+#define HW_TM_SHARED_WRITE_F(var, val) ({ htm_write(&(var)); var = val; var; })
 
 #define HW_TM_LOCAL_WRITE(var, val)  	({var = val; var;})
 #define HW_TM_LOCAL_WRITE_P(var, val) ({var = val; var;})
@@ -51,30 +51,13 @@
 #include <min_nvm.h>
 
 /**
- *  Persistency delay emulation macros 
+ *  NOrec (PERSISTENT_TM) writes the write set and the commit marker to its
+ *  persistent redo log when it commits, there is nothing to do per write
  */
-#define PSTM_COMMIT_MARKER \
-	MN_count_writes++;       \
-  MN_count_writes++;       \
-  SPIN_PER_WRITE(1);       \
-  SPIN_PER_WRITE(1);
-
-// TODO: is crashing in TPC-C
-#define PSTM_LOG_ENTRY(addr, val) \
-	{ \
-		/*int log_buf = (int)val;*/ \
-		MN_count_writes += 2; \
-		/*memcpy(PSTM_log + PSTM_log_ptr, &log_buf, sizeof(int));*/ \
-		SPIN_PER_WRITE(1); \
-		/*PSTM_log_ptr += sizeof(int); \
-		if (PSTM_log_ptr >= PSTM_LOG_SIZE - sizeof(int)) PSTM_log_ptr = 0;*/\
-	}
+#define PSTM_COMMIT_MARKER            /* nothing */
+#define PSTM_LOG_ENTRY(addr, val)     /* nothing */
 
-#define STM_ON_ABORT() \
-	{ \
-		int abort_marker = 1, val_buf = 1; \
-		PSTM_LOG_ENTRY(&abort_marker, val_buf); \
-	}
+#define STM_ON_ABORT()                /* nothing */
 
 
 #if defined(COMMIT_RATE_PROFILING) || defined(RW_SET_PROFILING)
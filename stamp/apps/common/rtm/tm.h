@@ -263,7 +263,7 @@ extern void increaseThroughputSamplesSize(double **ptr, uint64_t *oldLength, uin
 
 #endif /* NO PROFILING */
 
-#define TM_RESTART()                  _xabort(0xab)
+#define TM_RESTART()                  htm_abort()
 #define TM_EARLY_RELEASE(var)         /* nothing */
 
 
@@ -275,13 +275,13 @@ extern void increaseThroughputSamplesSize(double **ptr, uint64_t *oldLength, uin
 #define TM_FREE(ptr)                  free(ptr)
 
 
-#define TM_SHARED_READ(var)           (var)
-#define TM_SHARED_READ_P(var)         (var)
-#define TM_SHARED_READ_F(var)         (var)
+#define TM_SHARED_READ(var)           ({ htm_read(&(var)); var; })
+#define TM_SHARED_READ_P(var)         ({ htm_read(&(var)); var; })
+#define TM_SHARED_READ_F(var)         ({ htm_read(&(var)); var; })
 
-#define TM_SHARED_WRITE(var, val)     var = val
-#define TM_SHARED_WRITE_P(var, val)   var = val
-#define TM_SHARED_WRITE_F(var, val)   var = val
+#define TM_SHARED_WRITE(var, val)     ({ htm_write(&(var)); var = val; })
+#define TM_SHARED_WRITE_P(var, val)   ({ htm_write(&(var)); var = val; })
+#define TM_SHARED_WRITE_F(var, val)   ({ htm_write(&(var)); var = val; })
 
 #define TM_LOCAL_WRITE(var, val)      var = val
 #define TM_LOCAL_WRITE_P(var, val)    var = val
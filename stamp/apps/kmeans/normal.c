@@ -225,7 +225,7 @@ work (void* argPtr)
 #ifdef HW_SW_PATHS
 	IF_HTM_MODE
 		START_HTM_MODE
-    	HW_TM_SHARED_WRITE_F(global_delta, TM_SHARED_READ_F(global_delta) + delta);
+    	HW_TM_SHARED_WRITE_F(global_delta, HW_TM_SHARED_READ_F(global_delta) + delta);
 		COMMIT_HTM_MODE
 	ELSE_STM_MODE
 		START_STM_MODE(RW)